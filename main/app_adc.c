@@ -1,54 +1,880 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "driver/gpio.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "app_adc.h"
 
 static bool sensor_adc_calibration_init(adc_unit_t unit, adc_channel_t channel, adc_atten_t atten, adc_cali_handle_t *out_handle);
 static void sensor_adc_calibration_deinit(adc_cali_handle_t handle);
+static void probes_power(bool on);
+static void probes_on(void);
+static esp_err_t monitor_start(void);
+static esp_err_t monitor_stop(void);
+static void monitor_release(void);
+static void monitor_resume(void);
+
+static uint8_t sweepFrame[SENSOR_SWEEP_FRAME_SIZE];
+static int8_t channelZone[SENSOR_ADC_CHANNELS]; // conversion channel to zone, -1 if unused
+static SemaphoreHandle_t sweepLock = NULL;
+static StaticSemaphore_t sweepLockBuffer;
+
+static SemaphoreHandle_t powerLock = NULL; // power state and monitor changes, never held across a wait
+static StaticSemaphore_t powerLockBuffer;
+static uint16_t settleMs = 0;
+static int powerUsers = 0;           // acquisitions between power-on and power-off, under powerLock
+static bool powerExclusive = false;  // a settle characterization switches the probes itself, under powerLock
+static int64_t poweredUs = 0;        // last switch-on edge, under powerLock
+static int64_t powerOnUs = 0;
+static uint32_t powerCycles = 0;
+static int64_t powerTotalUs = 0;
+static bool probesPowered = false; // under powerLock
+
+static adc_continuous_handle_t *monitorAdc = NULL;
+static adc_alarm_fn_t monitorAlarm = NULL;
+static volatile uint32_t monitorAlarms = 0;
+#if SENSOR_MONITOR_ZONES > 0
+static bool monitorRunning = false; // idle conversions between acquisitions, under powerLock
+static adc_monitor_handle_t monitors[SENSOR_MONITOR_ZONES];
+static int32_t monitorHigh[SENSOR_MONITOR_ZONES]; // raw, -1 when off
+static int32_t monitorLow[SENSOR_MONITOR_ZONES];
+static uint32_t monitorArmed = 0; // zones that may still raise an alarm, cleared by the interrupt
+static uint32_t monitorFired = 0; // zones that raised one since they were armed, set by the interrupt
+static portMUX_TYPE monitorLock = portMUX_INITIALIZER_UNLOCKED;
+static bool monitorWarned[SENSOR_MONITOR_ZONES]; // side each zone was armed for, under powerLock
+static int64_t monitorHoldUs[SENSOR_MONITOR_ZONES]; // an unconfirmed zone is not armed before it
+#endif
 
-static int adc_raw[2][10];
+static int sensorDryRaw[ZONE_COUNT] = {[0 ... ZONE_COUNT - 1] = 0};
+static int sensorWetRaw[ZONE_COUNT] = {[0 ... ZONE_COUNT - 1] = SENSOR_ADC_MAX_RAW};
+
+static int32_t filterState[ZONE_COUNT]; // estimate, Q8 raw
+static uint32_t filterVar[ZONE_COUNT];  // raw^2
+static int64_t filterTimeUs = 0;        // every zone is updated by the same pass
+
+#define BROKER_MAX_WAITERS 4
+
+static adc_reading_t lastReadings[ZONE_COUNT];
+static bool inFlight = false;
+static uint32_t pendingConsumers = 0;
+static uint32_t brokerRequests = 0;
+static uint32_t brokerAcquisitions = 0;
+static uint32_t brokerCoalesced = 0;
+static uint32_t brokerCached = 0;
+static TaskHandle_t brokerWaiters[BROKER_MAX_WAITERS]; // tasks blocked in adc_reading_wait, woken by the publish
+static portMUX_TYPE brokerLock = portMUX_INITIALIZER_UNLOCKED;
 
 static const char *TAG = "ASE-PROJECT-ADC";
 
 /*---------------------------------------------------------------
         ADC Initialization
 ---------------------------------------------------------------*/
-void adc_init(adc_oneshot_unit_handle_t *adc_handle, adc_cali_handle_t *adc_cali_handle, bool *do_calibration)
+void adc_init(adc_continuous_handle_t *adc_handle, adc_cali_handle_t *adc_cali_handle, bool *do_calibration)
 {
     //-------------ADC1 Init---------------//
-    adc_oneshot_unit_init_cfg_t init_config = {
-        .unit_id = ADC_UNIT_1,
-        .ulp_mode = ADC_ULP_MODE_DISABLE,
+    adc_continuous_handle_cfg_t handle_config = {
+        .max_store_buf_size = 4 * SENSOR_SWEEP_FRAME_SIZE,
+        .conv_frame_size = SENSOR_SWEEP_FRAME_SIZE,
     };
-    ESP_ERROR_CHECK(adc_oneshot_new_unit(&init_config, adc_handle));
+    ESP_ERROR_CHECK(adc_continuous_new_handle(&handle_config, adc_handle));
 
     //-------------ADC1 Calibration Init---------------//
     *adc_cali_handle = NULL;
-    *do_calibration = sensor_adc_calibration_init(ADC_UNIT_1, SENSOR_ADC1_CHAN0, SENSOR_ADC_ATTEN, adc_cali_handle);
+    *do_calibration = sensor_adc_calibration_init(SENSOR_ADC_UNIT, zoneTable->channel[0], SENSOR_ADC_ATTEN, adc_cali_handle);
 
     //-------------ADC1 Config---------------//
-    adc_oneshot_chan_cfg_t config = {
-        .bitwidth = ADC_BITWIDTH_DEFAULT,
-        .atten = SENSOR_ADC_ATTEN,
+    adc_digi_pattern_config_t pattern[ZONE_COUNT];
+
+    for (int channel = 0; channel < SENSOR_ADC_CHANNELS; channel++)
+        channelZone[channel] = -1;
+
+    /* one pattern entry per zone, the sweep converts them round robin */
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+    {
+        pattern[zone].atten = SENSOR_ADC_ATTEN;
+        pattern[zone].channel = zoneTable->channel[zone];
+        pattern[zone].unit = SENSOR_ADC_UNIT;
+        pattern[zone].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+
+        channelZone[zoneTable->channel[zone]] = zone;
+    }
+
+    adc_continuous_config_t config = {
+        .pattern_num = ZONE_COUNT,
+        .adc_pattern = pattern,
+        .sample_freq_hz = SENSOR_SWEEP_FREQ_HZ,
+        .conv_mode = ADC_CONV_SINGLE_UNIT_1,
+        .format = SENSOR_ADC_OUTPUT_TYPE,
     };
-    ESP_ERROR_CHECK(adc_oneshot_config_channel(*adc_handle, SENSOR_ADC1_CHAN0, &config));
+    ESP_ERROR_CHECK(adc_continuous_config(*adc_handle, &config));
+
+    sweepLock = xSemaphoreCreateMutexStatic(&sweepLockBuffer);
+    powerLock = xSemaphoreCreateMutexStatic(&powerLockBuffer);
+
+#if SENSOR_POWER_IO >= 0
+    gpio_config_t powerConfig = {
+        .pin_bit_mask = 1ULL << SENSOR_POWER_IO,
+        .mode = GPIO_MODE_OUTPUT,
+    };
+    ESP_ERROR_CHECK(gpio_config(&powerConfig));
+    gpio_set_level(SENSOR_POWER_IO, 0);
+#endif
+
+    adc_estimate_reset();
 }
 
-void adc_deinit(adc_oneshot_unit_handle_t *adc2_handle, adc_cali_handle_t *adc2_cali_handle, bool do_calibration)
+void adc_deinit(adc_continuous_handle_t *adc_handle, adc_cali_handle_t *adc_cali_handle, bool do_calibration)
 {
-    ESP_ERROR_CHECK(adc_oneshot_del_unit(*adc2_handle));
+    ESP_ERROR_CHECK(adc_continuous_deinit(*adc_handle));
     if (do_calibration)
     {
-        sensor_adc_calibration_deinit(*adc2_cali_handle);
+        sensor_adc_calibration_deinit(*adc_cali_handle);
+    }
+}
+
+/*---------------------------------------------------------------
+        Pattern Sweep
+---------------------------------------------------------------*/
+esp_err_t adc_sweep(adc_continuous_handle_t *adc_handle, int medians[ZONE_COUNT])
+{
+    int samples[ZONE_COUNT][FILTER_MEDIAN_N];
+    int counts[ZONE_COUNT] = {0};
+    int complete = 0;
+
+    /* the estimator and a console calibration may sweep at the same time */
+    xSemaphoreTake(sweepLock, portMAX_DELAY);
+
+    /* a monitor that failed to stop leaves the driver started, the caller keeps what it had */
+    esp_err_t err = adc_continuous_start(*adc_handle);
+    if (err != ESP_OK)
+    {
+        xSemaphoreGive(sweepLock);
+
+        ESP_LOGW(TAG, "sweep not started: %s", esp_err_to_name(err));
+        for (int zone = 0; zone < ZONE_COUNT; zone++)
+            medians[zone] = -1;
+        return err;
+    }
+
+    while (complete < ZONE_COUNT)
+    {
+        uint32_t length = 0;
+
+        if (adc_continuous_read(*adc_handle, sweepFrame, sizeof(sweepFrame), &length, SENSOR_SWEEP_TIMEOUT_MS) != ESP_OK)
+            break;
+
+        for (uint32_t i = 0; i + SOC_ADC_DIGI_RESULT_BYTES <= length; i += SOC_ADC_DIGI_RESULT_BYTES)
+        {
+            adc_digi_output_data_t *result = (adc_digi_output_data_t *)&sweepFrame[i];
+            int channel = SENSOR_ADC_GET_CHANNEL(result);
+            int zone = channel < SENSOR_ADC_CHANNELS ? channelZone[channel] : -1;
+            int raw = SENSOR_ADC_GET_DATA(result);
+            int j;
+
+            if (zone < 0 || counts[zone] == FILTER_MEDIAN_N)
+                continue;
+
+            /* insertion sort while collecting, N is tiny */
+            for (j = counts[zone]; j > 0 && samples[zone][j - 1] > raw; j--)
+                samples[zone][j] = samples[zone][j - 1];
+            samples[zone][j] = raw;
+
+            if (++counts[zone] == FILTER_MEDIAN_N)
+                complete++;
+        }
+    }
+
+    err = adc_continuous_stop(*adc_handle);
+    adc_continuous_flush_pool(*adc_handle);
+
+    xSemaphoreGive(sweepLock);
+
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+        medians[zone] = counts[zone] > 0 ? samples[zone][(counts[zone] - 1) / 2] : -1;
+
+    /* the medians are good, the next sweep finds out whether the driver recovered */
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "sweep not stopped: %s", esp_err_to_name(err));
+        return err;
+    }
+
+    if (complete < ZONE_COUNT)
+    {
+        ESP_LOGW(TAG, "sweep timed out, %d of %d zones complete", complete, ZONE_COUNT);
+        return ESP_ERR_TIMEOUT;
+    }
+
+    return ESP_OK;
+}
+
+int adc_get_average(adc_continuous_handle_t *adc_handle, int zone)
+{
+    int average = 0, count = 0;
+    int medians[ZONE_COUNT];
+
+    if (!adc_power_on())
+        return -1;
+
+    for (int i = 0; i < SENSOR_SAMPLES; i++)
+    {
+        adc_sweep(adc_handle, medians);
+        if (medians[zone] >= 0)
+        {
+            average += medians[zone];
+            count++;
+        }
+        vTaskDelay(pdMS_TO_TICKS(SENSOR_SAMPLE_DELAY_MS));
+    }
+
+    adc_power_off();
+
+    return count > 0 ? average / count : 0;
+}
+
+/*---------------------------------------------------------------
+        Moisture Estimator
+---------------------------------------------------------------*/
+void adc_estimate(adc_continuous_handle_t *adc_handle, adc_estimate_t estimates[ZONE_COUNT])
+{
+    int64_t now = esp_timer_get_time();
+    int medians[ZONE_COUNT];
+    int used[ZONE_COUNT] = {0};
+    int groups = 0;
+    bool converged;
+    bool failed;
+
+    /* a settle characterization owns the probes, the last estimate stands */
+    if (!adc_power_on())
+    {
+        for (int zone = 0; zone < ZONE_COUNT; zone++)
+        {
+            estimates[zone].raw = (filterState[zone] + 128) >> 8;
+            estimates[zone].variance = filterVar[zone];
+            estimates[zone].samples = 0;
+        }
+        return;
+    }
+
+    /* the soil may have drifted since the last reading */
+    if (filterTimeUs != 0)
+    {
+        uint64_t drift = (uint64_t)FILTER_PROCESS_VAR_PER_S * ((now - filterTimeUs) / 1000000);
+
+        for (int zone = 0; zone < ZONE_COUNT; zone++)
+            filterVar[zone] = drift + filterVar[zone] > FILTER_INITIAL_VAR ? FILTER_INITIAL_VAR : filterVar[zone] + drift;
+    }
+
+    do
+    {
+        if (groups > 0)
+            vTaskDelay(pdMS_TO_TICKS(FILTER_GROUP_DELAY_MS));
+
+        /* a driver error ends the pass, zones keep what the sweeps before it gave */
+        esp_err_t err = adc_sweep(adc_handle, medians);
+        failed = err != ESP_OK && err != ESP_ERR_TIMEOUT;
+        groups++;
+        converged = true;
+
+        for (int zone = 0; zone < ZONE_COUNT; zone++)
+        {
+            /* a zone missing from a timed out sweep keeps its estimate */
+            if (medians[zone] < 0)
+            {
+                converged = false;
+                continue;
+            }
+
+            int32_t innovation = (medians[zone] << 8) - filterState[zone]; // Q8
+            int64_t innovationVar = (int64_t)filterVar[zone] + FILTER_MEAS_VAR;
+            used[zone]++;
+
+            /* outside the gate: watering or a new probe position, forget the history */
+            if ((int64_t)innovation * innovation > ((int64_t)FILTER_GATE_SIGMAS * FILTER_GATE_SIGMAS * innovationVar) << 16)
+            {
+                filterVar[zone] = FILTER_INITIAL_VAR;
+                innovationVar = (int64_t)filterVar[zone] + FILTER_MEAS_VAR;
+            }
+
+            int64_t gain = ((int64_t)filterVar[zone] << 16) / innovationVar; // Q16
+            filterState[zone] += (int32_t)(((int64_t)innovation * gain) >> 16);
+            filterVar[zone] = (uint32_t)(((int64_t)filterVar[zone] * (65536 - gain)) >> 16);
+
+            if (filterVar[zone] > FILTER_TARGET_VAR)
+                converged = false;
+        }
+    } while (!failed && groups < FILTER_MAX_GROUPS && (groups < FILTER_MIN_GROUPS || !converged));
+
+    adc_power_off();
+
+    filterTimeUs = esp_timer_get_time();
+
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+    {
+        estimates[zone].raw = (filterState[zone] + 128) >> 8;
+        estimates[zone].variance = filterVar[zone];
+        estimates[zone].samples = used[zone] * FILTER_MEDIAN_N;
+    }
+}
+
+void adc_estimate_reset(void)
+{
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+    {
+        filterState[zone] = 0;
+        filterVar[zone] = FILTER_INITIAL_VAR;
+    }
+    filterTimeUs = 0;
+}
+
+/*---------------------------------------------------------------
+        Sensor Power
+---------------------------------------------------------------*/
+/* false while a settle characterization owns the probes */
+bool adc_power_on(void)
+{
+    int64_t readyUs = 0;
+
+    xSemaphoreTake(powerLock, portMAX_DELAY);
+    if (powerExclusive)
+    {
+        xSemaphoreGive(powerLock);
+        return false;
+    }
+
+    /* the estimator and a console calibration share the probes, the sweeps take turns on sweepLock */
+    if (powerUsers++ == 0)
+    {
+        /* the monitors keep the probes powered, they are settled already */
+        esp_err_t err = monitor_stop();
+        if (err != ESP_OK)
+            ESP_LOGW(TAG, "moisture monitor not stopped: %s", esp_err_to_name(err));
+        powerOnUs = esp_timer_get_time();
+    }
+    probes_on();
+#if SENSOR_POWER_IO >= 0
+    readyUs = poweredUs + 1000LL * settleMs;
+#endif
+    xSemaphoreGive(powerLock);
+
+    /* a second user waits out what is left of the same edge */
+    int64_t waitUs = readyUs - esp_timer_get_time();
+    if (waitUs > 0)
+        vTaskDelay(pdMS_TO_TICKS((waitUs + 999) / 1000));
+
+    return true;
+}
+
+void adc_power_off(void)
+{
+    xSemaphoreTake(powerLock, portMAX_DELAY);
+    if (--powerUsers == 0)
+    {
+        powerCycles++;
+        powerTotalUs += esp_timer_get_time() - powerOnUs;
+
+        monitor_resume();
+    }
+    xSemaphoreGive(powerLock);
+}
+
+void adc_set_settle(uint16_t settle_ms)
+{
+    settleMs = settle_ms;
+}
+
+esp_err_t adc_characterize_settle(adc_continuous_handle_t *adc_handle, uint16_t settle_ms[ZONE_COUNT])
+{
+#if SENSOR_POWER_IO < 0
+    return ESP_ERR_NOT_SUPPORTED;
+#else
+    static uint16_t raws[SENSOR_SETTLE_POINTS][ZONE_COUNT];
+    static uint32_t times[SENSOR_SETTLE_POINTS]; // us after power-on
+    int medians[ZONE_COUNT];
+    esp_err_t err = ESP_OK;
+
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+        settle_ms[zone] = 0;
+
+    /* the probes are switched by hand, an acquisition meanwhile keeps its last estimate */
+    xSemaphoreTake(powerLock, portMAX_DELAY);
+    if (powerExclusive || powerUsers > 0)
+    {
+        xSemaphoreGive(powerLock);
+        return ESP_ERR_INVALID_STATE;
+    }
+    powerExclusive = true;
+    monitor_stop();
+    xSemaphoreGive(powerLock);
+
+    for (int run = 0; run < SENSOR_SETTLE_RUNS; run++)
+    {
+        gpio_set_level(SENSOR_POWER_IO, 0);
+        vTaskDelay(pdMS_TO_TICKS(SENSOR_POWER_DISCHARGE_MS));
+
+        /* record the step response from the switch edge */
+        int64_t startUs = esp_timer_get_time();
+        gpio_set_level(SENSOR_POWER_IO, 1);
+
+        int points = 0;
+        while (points < SENSOR_SETTLE_POINTS)
+        {
+            adc_sweep(adc_handle, medians);
+            times[points] = esp_timer_get_time() - startUs;
+            for (int zone = 0; zone < ZONE_COUNT; zone++)
+                raws[points][zone] = medians[zone] >= 0 ? medians[zone] : points > 0 ? raws[points - 1][zone] : 0;
+
+            if (times[points++] >= SENSOR_SETTLE_WINDOW_MS * 1000)
+                break;
+            vTaskDelay(pdMS_TO_TICKS(SENSOR_SETTLE_STEP_MS));
+        }
+
+        for (int zone = 0; zone < ZONE_COUNT; zone++)
+        {
+            int tail = points - points / 4;
+            int final = 0;
+
+            for (int i = tail; i < points; i++)
+                final += raws[i][zone];
+            final /= points - tail;
+
+            /* walk back from the end while the output stays within tolerance of the settled value */
+            int stable = points;
+            while (stable > 0 && abs(raws[stable - 1][zone] - final) <= SENSOR_SETTLE_TOLERANCE)
+                stable--;
+
+            if (stable > tail)
+            {
+                ESP_LOGW(TAG, "zone %d did not settle within %d ms", zone, SENSOR_SETTLE_WINDOW_MS);
+                err = ESP_ERR_INVALID_STATE;
+                continue;
+            }
+
+            uint32_t ms = stable == 0 ? 0 : (times[stable] + 999) / 1000;
+            settle_ms[zone] = ms > settle_ms[zone] ? ms : settle_ms[zone];
+        }
+    }
+
+    xSemaphoreTake(powerLock, portMAX_DELAY);
+    powerExclusive = false;
+    probesPowered = true;
+    monitor_resume();
+    xSemaphoreGive(powerLock);
+
+    return err;
+#endif
+}
+
+void adc_power_stats(uint32_t *cycles, int64_t *on_us)
+{
+    *cycles = powerCycles;
+    *on_us = powerTotalUs;
+}
+
+static void probes_power(bool on)
+{
+#if SENSOR_POWER_IO >= 0
+    gpio_set_level(SENSOR_POWER_IO, on);
+#endif
+    probesPowered = on;
+}
+
+/* under powerLock, the caller waits out the settle time from poweredUs */
+static void probes_on(void)
+{
+    if (probesPowered)
+        return;
+
+    probes_power(true);
+    poweredUs = esp_timer_get_time();
+}
+
+/*---------------------------------------------------------------
+        Moisture Monitor
+
+ The digital monitors only compare while the continuous driver
+ converts, so the sweep pattern runs between acquisitions whenever
+ a zone is armed. Thresholds are fixed when a monitor is created,
+ each restart builds them again from the armed levels.
+---------------------------------------------------------------*/
+void adc_alarm_init(adc_continuous_handle_t *adc_handle, adc_alarm_fn_t alarm)
+{
+    monitorAdc = adc_handle;
+    monitorAlarm = alarm;
+
+    if (SENSOR_MONITOR_ZONES < ZONE_COUNT)
+        ESP_LOGI(TAG, "%d of %d zones monitored in hardware, the others are checked by the periodic sample", SENSOR_MONITOR_ZONES, ZONE_COUNT);
+}
+
+esp_err_t adc_alarm_arm(const uint16_t alert_low[ZONE_COUNT], const uint16_t alert_clear[ZONE_COUNT], const bool warned[ZONE_COUNT])
+{
+#if SENSOR_MONITOR_ZONES > 0
+    int64_t nowUs = esp_timer_get_time();
+    uint32_t fired, armed = 0;
+    esp_err_t err;
+
+    xSemaphoreTake(powerLock, portMAX_DELAY);
+    monitor_stop();
+
+    taskENTER_CRITICAL(&monitorLock);
+    fired = monitorFired;
+    monitorFired = 0;
+    taskEXIT_CRITICAL(&monitorLock);
+
+    for (int zone = 0; zone < SENSOR_MONITOR_ZONES; zone++)
+    {
+        /* the reading after an alarm left the zone on the same side, one noisy conversion must not loop alarm and re-arm */
+        if ((fired & (1 << zone)) && warned[zone] == monitorWarned[zone])
+        {
+            ESP_LOGW(TAG, "zone %d alarm not confirmed, periodic sample only for %d s", zone, SENSOR_MONITOR_HOLDOFF_MS / 1000);
+            monitorHoldUs[zone] = nowUs + 1000LL * SENSOR_MONITOR_HOLDOFF_MS;
+        }
+        monitorWarned[zone] = warned[zone];
+
+        if (nowUs < monitorHoldUs[zone])
+            continue;
+        armed |= 1 << zone;
+
+        int dry = sensorDryRaw[zone];
+        int wet = sensorWetRaw[zone];
+
+        /* a fine zone is watched for drying past the alert level, a warned one for wetting past the clear level */
+        int level = warned[zone] ? alert_clear[zone] : alert_low[zone];
+        int threshold = dry + (wet - dry) * level / 100;
+        bool rising = (dry > wet) != warned[zone];
+
+        monitorHigh[zone] = rising ? (threshold + SENSOR_MONITOR_MARGIN > SENSOR_ADC_MAX_RAW ? SENSOR_ADC_MAX_RAW : threshold + SENSOR_MONITOR_MARGIN) : -1;
+        monitorLow[zone] = rising ? -1 : (threshold - SENSOR_MONITOR_MARGIN < 0 ? 0 : threshold - SENSOR_MONITOR_MARGIN);
+    }
+
+    taskENTER_CRITICAL(&monitorLock);
+    monitorArmed = armed;
+    taskEXIT_CRITICAL(&monitorLock);
+
+    /* an acquisition still running starts them when it powers off */
+    err = powerUsers > 0 || powerExclusive ? ESP_OK : monitor_start();
+    if (err != ESP_OK)
+        probes_power(false);
+
+    xSemaphoreGive(powerLock);
+
+    return err == ESP_ERR_NOT_FOUND ? ESP_OK : err;
+#else
+    return ESP_OK;
+#endif
+}
+
+void adc_alarm_stats(int *zones, uint32_t *alarms)
+{
+    *zones = SENSOR_MONITOR_ZONES;
+    *alarms = monitorAlarms;
+}
+
+#if SENSOR_MONITOR_ZONES > 0
+static bool monitor_on_cross(adc_monitor_handle_t monitor_handle, const adc_monitor_evt_data_t *event_data, void *user_data)
+{
+    int zone = (int)(intptr_t)user_data;
+    BaseType_t woken = pdFALSE;
+    bool fire;
+
+    /* raised on every conversion past the threshold until the next acquisition stops the monitor, only the first counts */
+    taskENTER_CRITICAL_ISR(&monitorLock);
+    fire = monitorArmed & (1 << zone);
+    monitorArmed &= ~(1 << zone);
+    monitorFired |= fire ? 1 << zone : 0;
+    taskEXIT_CRITICAL_ISR(&monitorLock);
+
+    if (fire)
+    {
+        monitorAlarms++;
+        if (monitorAlarm != NULL)
+            monitorAlarm(zone, &woken);
+    }
+
+    return woken == pdTRUE;
+}
+#endif
+
+/* under powerLock with the driver stopped, ESP_ERR_NOT_FOUND when no zone is armed */
+static esp_err_t monitor_start(void)
+{
+#if SENSOR_MONITOR_ZONES > 0
+    adc_monitor_evt_cbs_t callbacks = {
+        .on_over_high_thresh = monitor_on_cross,
+        .on_below_low_thresh = monitor_on_cross,
+    };
+    esp_err_t err = ESP_ERR_NOT_FOUND;
+
+    for (int zone = 0; zone < SENSOR_MONITOR_ZONES; zone++)
+    {
+        if (!(monitorArmed & (1 << zone)))
+            continue;
+
+        adc_monitor_config_t config = {
+            .adc_unit = SENSOR_ADC_UNIT,
+            .channel = zoneTable->channel[zone],
+            .h_threshold = monitorHigh[zone],
+            .l_threshold = monitorLow[zone],
+        };
+        if ((err = adc_new_continuous_monitor(*monitorAdc, &config, &monitors[zone])) != ESP_OK ||
+            (err = adc_continuous_monitor_register_event_callbacks(monitors[zone], &callbacks, (void *)(intptr_t)zone)) != ESP_OK ||
+            (err = adc_continuous_monitor_enable(monitors[zone])) != ESP_OK)
+            break;
+    }
+
+    if (err == ESP_ERR_NOT_FOUND)
+        return err;
+
+    /* monitors only run on probes that are always powered, nothing to settle */
+    if (err == ESP_OK)
+    {
+        probes_on();
+        err = adc_continuous_start(*monitorAdc);
+    }
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG, "moisture monitor not started, periodic sample only: %s", esp_err_to_name(err));
+        monitor_release();
+        return err;
+    }
+
+    monitorRunning = true;
+    return ESP_OK;
+#else
+    return ESP_ERR_NOT_FOUND;
+#endif
+}
+
+static esp_err_t monitor_stop(void)
+{
+#if SENSOR_MONITOR_ZONES > 0
+    if (!monitorRunning)
+        return ESP_OK;
+
+    /* the monitors go either way, the sweep that follows must only see its own conversions */
+    esp_err_t err = adc_continuous_stop(*monitorAdc);
+    monitor_release();
+    adc_continuous_flush_pool(*monitorAdc);
+    monitorRunning = false;
+
+    return err;
+#else
+    return ESP_OK;
+#endif
+}
+
+static void monitor_release(void)
+{
+#if SENSOR_MONITOR_ZONES > 0
+    for (int zone = 0; zone < SENSOR_MONITOR_ZONES; zone++)
+    {
+        if (monitors[zone] == NULL)
+            continue;
+
+        adc_continuous_monitor_disable(monitors[zone]);
+        adc_del_continuous_monitor(monitors[zone]);
+        monitors[zone] = NULL;
+    }
+#endif
+}
+
+/* after an acquisition, the probes stay on only for the monitors */
+static void monitor_resume(void)
+{
+    if (monitor_start() != ESP_OK)
+        probes_power(false);
+}
+
+/*---------------------------------------------------------------
+        Measurement Broker
+
+ One acquisition at a time. Requests that arrive while it runs attach
+ their consumer bits to it, waiters get woken when it completes and
+ readings younger than the freshness window are served from cache.
+---------------------------------------------------------------*/
+bool adc_reading_get_fresh(uint32_t max_age_ms, adc_reading_t readings[ZONE_COUNT])
+{
+    bool fresh = true;
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&brokerLock);
+    /* every zone must be fresh, a sweep that failed part way leaves older readings behind */
+    for (int zone = 0; zone < ZONE_COUNT && fresh; zone++)
+        fresh = lastReadings[zone].seq != 0 && (now - lastReadings[zone].timeUs) < (int64_t)max_age_ms * 1000;
+    if (fresh)
+    {
+        memcpy(readings, lastReadings, sizeof(lastReadings));
+        brokerRequests++;
+        brokerCached++;
+    }
+    taskEXIT_CRITICAL(&brokerLock);
+
+    return fresh;
+}
+
+bool adc_reading_request(uint32_t consumers)
+{
+    bool acquire;
+
+    taskENTER_CRITICAL(&brokerLock);
+    brokerRequests++;
+    pendingConsumers |= consumers;
+    acquire = !inFlight;
+    if (acquire)
+    {
+        inFlight = true;
+        brokerAcquisitions++;
+    }
+    else
+    {
+        brokerCoalesced++;
+    }
+    taskEXIT_CRITICAL(&brokerLock);
+
+    /* true: the caller owns the acquisition and must call adc_reading_publish */
+    return acquire;
+}
+
+uint32_t adc_reading_publish(const adc_estimate_t estimates[ZONE_COUNT], adc_reading_t readings[ZONE_COUNT])
+{
+    uint32_t consumers;
+    TaskHandle_t waiters[BROKER_MAX_WAITERS];
+    int64_t now = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&brokerLock);
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+    {
+        lastReadings[zone].raw = estimates[zone].raw;
+        lastReadings[zone].variance = estimates[zone].variance;
+        lastReadings[zone].samples = estimates[zone].samples;
+        lastReadings[zone].percentage = adc_raw_to_percentage(zone, estimates[zone].raw);
+        lastReadings[zone].timeUs = now;
+        lastReadings[zone].seq++;
+    }
+    memcpy(readings, lastReadings, sizeof(lastReadings));
+
+    consumers = pendingConsumers;
+    pendingConsumers = 0;
+    inFlight = false;
+    memcpy(waiters, brokerWaiters, sizeof(waiters));
+    memset(brokerWaiters, 0, sizeof(brokerWaiters));
+    taskEXIT_CRITICAL(&brokerLock);
+
+    for (int i = 0; i < BROKER_MAX_WAITERS; i++)
+        if (waiters[i] != NULL)
+            xTaskNotifyGive(waiters[i]);
+
+    return consumers;
+}
+
+/* the owner could not run the acquisition, its consumers ride on the next one */
+void adc_reading_abort(void)
+{
+    taskENTER_CRITICAL(&brokerLock);
+    inFlight = false;
+    taskEXIT_CRITICAL(&brokerLock);
+}
+
+esp_err_t adc_reading_wait(uint32_t after_seq, TickType_t timeout, adc_reading_t readings[ZONE_COUNT])
+{
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    TickType_t start = xTaskGetTickCount();
+
+    while (1)
+    {
+        int slot = -1;
+
+        /* checked and registered together, a publish either lands before the check or wakes the task */
+        taskENTER_CRITICAL(&brokerLock);
+        bool done = lastReadings[0].seq != after_seq;
+        if (done)
+            memcpy(readings, lastReadings, sizeof(lastReadings));
+        else
+            for (int i = 0; i < BROKER_MAX_WAITERS && slot < 0; i++)
+                if (brokerWaiters[i] == NULL || brokerWaiters[i] == self)
+                {
+                    brokerWaiters[i] = self;
+                    slot = i;
+                }
+        taskEXIT_CRITICAL(&brokerLock);
+
+        if (done)
+            return ESP_OK;
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout)
+        {
+            taskENTER_CRITICAL(&brokerLock);
+            if (slot >= 0 && brokerWaiters[slot] == self)
+                brokerWaiters[slot] = NULL;
+            taskEXIT_CRITICAL(&brokerLock);
+
+            return ESP_ERR_TIMEOUT;
+        }
+
+        /* the acquisition may not even have started, the publish wakes the task; with every slot taken sleep a sample */
+        if (slot >= 0)
+            ulTaskNotifyTake(pdTRUE, timeout - elapsed);
+        else
+            vTaskDelay(pdMS_TO_TICKS(SENSOR_SAMPLE_DELAY_MS));
+    }
+}
+
+uint32_t adc_reading_seq(void)
+{
+    return lastReadings[0].seq;
+}
+
+void adc_broker_stats(uint32_t *requests, uint32_t *acquisitions, uint32_t *coalesced, uint32_t *cached)
+{
+    taskENTER_CRITICAL(&brokerLock);
+    *requests = brokerRequests;
+    *acquisitions = brokerAcquisitions;
+    *coalesced = brokerCoalesced;
+    *cached = brokerCached;
+    taskEXIT_CRITICAL(&brokerLock);
+}
+
+/*---------------------------------------------------------------
+        Sensor Calibration (raw reading to moisture percentage)
+---------------------------------------------------------------*/
+void adc_set_calibration(int zone, int dry_raw, int wet_raw)
+{
+    if (dry_raw == wet_raw)
+    {
+        ESP_LOGW(TAG, "zone %d: dry and wet points are equal, calibration ignored", zone);
+        return;
     }
+
+    sensorDryRaw[zone] = dry_raw;
+    sensorWetRaw[zone] = wet_raw;
 }
 
-void adc_get_raw(adc_oneshot_unit_handle_t *adc2_handle, int *raw_value)
+void adc_get_calibration(int zone, int *dry_raw, int *wet_raw)
 {
-    ESP_ERROR_CHECK(adc_oneshot_read(*adc2_handle, SENSOR_ADC1_CHAN0, &adc_raw[1][0]));
+    *dry_raw = sensorDryRaw[zone];
+    *wet_raw = sensorWetRaw[zone];
+}
+
+uint8_t adc_raw_to_percentage(int zone, int raw)
+{
+    /* linear between the two points, works for probes that read lower when wet too */
+    int percentage = ((raw - sensorDryRaw[zone]) * 100) / (sensorWetRaw[zone] - sensorDryRaw[zone]);
+
+    if (percentage < 0)
+        percentage = 0;
+    else if (percentage > 100)
+        percentage = 100;
 
-    *raw_value = adc_raw[1][0];
+    return percentage;
 }
 
 /*---------------------------------------------------------------
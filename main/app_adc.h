@@ -1,11 +1,131 @@
-#include "esp_adc/adc_oneshot.h"
+#include "freertos/FreeRTOS.h"
+
+#include "esp_adc/adc_continuous.h"
 #include "esp_adc/adc_cali.h"
 #include "esp_adc/adc_cali_scheme.h"
+#include "soc/soc_caps.h"
+#if SOC_ADC_MONITOR_SUPPORTED
+#include "esp_adc/adc_monitor.h"
+#endif
+
+#include "app_zones.h"
 
-#define SENSOR_ADC1_CHAN0 ADC_CHANNEL_6
+#define SENSOR_ADC_UNIT ADC_UNIT_1
+#define SENSOR_ADC_CHANNELS 10 // channel numbers the conversion results can carry
 
 #define SENSOR_ADC_ATTEN ADC_ATTEN_DB_11
 
-void adc_init(adc_oneshot_unit_handle_t *adc2_handle, adc_cali_handle_t *adc2_cali_handle, bool *do_calibration);
-void adc_deinit(adc_oneshot_unit_handle_t *adc2_handle, adc_cali_handle_t *adc2_cali_handle, bool do_calibration);
-void adc_get_raw(adc_oneshot_unit_handle_t *adc2_handle, int *raw_value);
+#define SENSOR_ADC_MAX_RAW 4095
+
+#define SENSOR_SAMPLES 50 // plain average, used for calibration
+#define SENSOR_SAMPLE_DELAY_MS 20
+
+/* with a load switch the probes are only fed while an acquisition runs, use a pin that is not a strapping pin */
+#ifndef SENSOR_POWER_IO
+#define SENSOR_POWER_IO -1 // load switch enable, -1 when the probes are always powered
+#endif
+#define SENSOR_POWER_DISCHARGE_MS 1000 // off time before each characterization run
+#define SENSOR_SETTLE_WINDOW_MS 2000   // step response recorded per run, the last quarter is the settled value
+#define SENSOR_SETTLE_STEP_MS 5
+#define SENSOR_SETTLE_POINTS 256
+#define SENSOR_SETTLE_RUNS 3
+#define SENSOR_SETTLE_TOLERANCE 20 // raw, about half a percent of the range
+#define SENSOR_SETTLE_MARGIN_MS 10
+
+/* one sweep runs the pattern over every zone until each has FILTER_MEDIAN_N conversions */
+#define SENSOR_SWEEP_FREQ_HZ SOC_ADC_SAMPLE_FREQ_THRES_LOW
+#define SENSOR_SWEEP_FRAME_SIZE (((ZONE_COUNT * FILTER_MEDIAN_N * SOC_ADC_DIGI_RESULT_BYTES) + 3) & ~3)
+#define SENSOR_SWEEP_TIMEOUT_MS 20
+
+#if CONFIG_IDF_TARGET_ESP32 || CONFIG_IDF_TARGET_ESP32S2
+#define SENSOR_ADC_OUTPUT_TYPE ADC_DIGI_OUTPUT_FORMAT_TYPE1
+#define SENSOR_ADC_GET_CHANNEL(p) ((p)->type1.channel)
+#define SENSOR_ADC_GET_DATA(p) ((p)->type1.data)
+#else
+#define SENSOR_ADC_OUTPUT_TYPE ADC_DIGI_OUTPUT_FORMAT_TYPE2
+#define SENSOR_ADC_GET_CHANNEL(p) ((p)->type2.channel)
+#define SENSOR_ADC_GET_DATA(p) ((p)->type2.data)
+#endif
+
+/*
+ * Critical-dry alarm between acquisitions. Where the ADC has digital
+ * monitors and the probes are always powered, the sweep pattern keeps
+ * converting at the lowest rate, and each monitored zone compares every
+ * conversion with a threshold derived from its calibration: the alert level
+ * while the zone is fine, the clear level once it was warned. A crossing
+ * interrupts at once and the alarm callback asks for a full reading, which
+ * confirms it. A zone whose alarm the reading does not confirm is left to the
+ * periodic sample for SENSOR_MONITOR_HOLDOFF_MS. Zones past the monitor
+ * count, the classic ESP32 and gated probes rely on the periodic sample, the
+ * monitors would keep a load switch on.
+ */
+#if SOC_ADC_MONITOR_SUPPORTED && SENSOR_POWER_IO < 0
+#define SENSOR_MONITOR_ZONES (ZONE_COUNT < SOC_ADC_DIGI_MONITOR_NUM ? ZONE_COUNT : SOC_ADC_DIGI_MONITOR_NUM)
+#else
+#define SENSOR_MONITOR_ZONES 0
+#endif
+#define SENSOR_MONITOR_MARGIN 48        // raw, keeps the noise of single conversions from tripping the threshold
+#define SENSOR_MONITOR_HOLDOFF_MS 600000 // a zone whose alarm was not confirmed is not watched again before this
+
+/* median-of-N prefilter feeding a persistent 1-D Kalman estimator, variances in raw^2 */
+#define FILTER_MEDIAN_N 5
+#define FILTER_GROUP_DELAY_MS 10 // spreads the groups so one burst of pump noise cannot fill them all
+#define FILTER_MIN_GROUPS 1
+#define FILTER_MAX_GROUPS 10
+#define FILTER_MEAS_VAR (15 * 15)  // noise of one median group
+#define FILTER_PROCESS_VAR_PER_S 2 // how fast soil moisture can drift
+#define FILTER_TARGET_VAR (12 * 12) // well under one percent (~41 raw)
+#define FILTER_INITIAL_VAR (SENSOR_ADC_MAX_RAW * SENSOR_ADC_MAX_RAW)
+#define FILTER_GATE_SIGMAS 4 // a median this far off is a real step, restart convergence
+#define FILTER_MAX_TIME_MS (FILTER_MAX_GROUPS * (FILTER_GROUP_DELAY_MS + SENSOR_SWEEP_TIMEOUT_MS)) // every group timing out
+
+struct adc_estimate_t
+{
+    int raw;           // estimate
+    uint32_t variance; // estimate variance
+    int samples;       // raw samples taken for this estimate
+};
+typedef struct adc_estimate_t adc_estimate_t;
+
+struct adc_reading_t
+{
+    int raw;
+    uint32_t variance;
+    int samples;
+    uint8_t percentage;
+    int64_t timeUs; // esp_timer time the reading completed
+    uint32_t seq;   // increments on every completed acquisition
+};
+typedef struct adc_reading_t adc_reading_t;
+
+void adc_init(adc_continuous_handle_t *adc_handle, adc_cali_handle_t *adc_cali_handle, bool *do_calibration);
+void adc_deinit(adc_continuous_handle_t *adc_handle, adc_cali_handle_t *adc_cali_handle, bool do_calibration);
+esp_err_t adc_sweep(adc_continuous_handle_t *adc_handle, int medians[ZONE_COUNT]);
+void adc_set_calibration(int zone, int dry_raw, int wet_raw);
+void adc_get_calibration(int zone, int *dry_raw, int *wet_raw);
+uint8_t adc_raw_to_percentage(int zone, int raw);
+int adc_get_average(adc_continuous_handle_t *adc_handle, int zone);
+void adc_estimate(adc_continuous_handle_t *adc_handle, adc_estimate_t estimates[ZONE_COUNT]);
+void adc_estimate_reset(void);
+
+bool adc_power_on(void);
+void adc_power_off(void);
+void adc_set_settle(uint16_t settle_ms);
+esp_err_t adc_characterize_settle(adc_continuous_handle_t *adc_handle, uint16_t settle_ms[ZONE_COUNT]);
+void adc_power_stats(uint32_t *cycles, int64_t *on_us);
+
+/* called from the ADC interrupt, once per crossing until the zone is armed again */
+typedef void (*adc_alarm_fn_t)(int zone, BaseType_t *woken);
+
+void adc_alarm_init(adc_continuous_handle_t *adc_handle, adc_alarm_fn_t alarm);
+esp_err_t adc_alarm_arm(const uint16_t alert_low[ZONE_COUNT], const uint16_t alert_clear[ZONE_COUNT], const bool warned[ZONE_COUNT]);
+void adc_alarm_stats(int *zones, uint32_t *alarms);
+
+/* readings are published for every zone at once, one pass per acquisition */
+bool adc_reading_get_fresh(uint32_t max_age_ms, adc_reading_t readings[ZONE_COUNT]);
+bool adc_reading_request(uint32_t consumers);
+uint32_t adc_reading_publish(const adc_estimate_t estimates[ZONE_COUNT], adc_reading_t readings[ZONE_COUNT]);
+void adc_reading_abort(void);
+esp_err_t adc_reading_wait(uint32_t after_seq, TickType_t timeout, adc_reading_t readings[ZONE_COUNT]);
+uint32_t adc_reading_seq(void);
+void adc_broker_stats(uint32_t *requests, uint32_t *acquisitions, uint32_t *coalesced, uint32_t *cached);
@@ -0,0 +1,244 @@
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "app_config.h"
+
+static void config_commit_cb(TimerHandle_t timer);
+static void config_commit(void);
+static void config_nvs_key(const config_schema_t *entry, int zone, char *name);
+
+#define CFG_SLOT(field) (offsetof(config_t, field) / sizeof(uint16_t))
+#define CFG_GLOBAL 1
+#define CFG_PER_ZONE ZONE_COUNT
+
+static const config_schema_t schema[CFG_TOTAL_KEYS] = {
+    [CFG_TIME_WATERING] = {"time_watering", 5, 100, 5, CFG_SLOT(timeWatering), CFG_PER_ZONE},
+    [CFG_AUTO_WATERING] = {"auto_watering", 0, 1, 0, CFG_SLOT(autoWatering), CFG_PER_ZONE},
+    [CFG_TARGET_MOISTURE] = {"target", 0, 100, 50, CFG_SLOT(targetMoisture), CFG_PER_ZONE},
+    [CFG_ALERT_LOW] = {"alert_low", 0, 100, 10, CFG_SLOT(alertLow), CFG_PER_ZONE},
+    [CFG_ALERT_CLEAR] = {"alert_clear", 0, 100, 20, CFG_SLOT(alertClear), CFG_PER_ZONE},
+    [CFG_WAIT_AFTER_WATERING] = {"wait_watering", 1, 3600, 10, CFG_SLOT(waitAfterWateringS), CFG_GLOBAL},
+    [CFG_SENSOR_DRY_RAW] = {"sensor_dry", 0, 4095, 0, CFG_SLOT(sensorDryRaw), CFG_PER_ZONE},
+    [CFG_SENSOR_WET_RAW] = {"sensor_wet", 0, 4095, 4095, CFG_SLOT(sensorWetRaw), CFG_PER_ZONE},
+    [CFG_READ_FRESHNESS] = {"freshness", 0, 600, 30, CFG_SLOT(readFreshnessS), CFG_GLOBAL},
+    [CFG_STORAGE] = {"storage", 0, 1, 0, CFG_SLOT(storage), CFG_GLOBAL},
+    [CFG_SENSOR_SETTLE] = {"sensor_settle", 0, 5000, 200, CFG_SLOT(sensorSettleMs), CFG_GLOBAL},
+    [CFG_EEPROM_CLOCK] = {"eeprom_khz", 0, 20000, 0, CFG_SLOT(eepromClockKhz), CFG_GLOBAL},
+};
+
+_Static_assert(sizeof(config_t) % sizeof(uint16_t) == 0, "config_t must only hold uint16_t values");
+_Static_assert(CFG_TOTAL_SLOTS <= 64, "dirty mask holds 64 values");
+
+static config_t config;
+const config_t *const appConfig = &config;
+
+static uint64_t dirty = 0;
+static TickType_t firstDirtyTick = 0;
+static portMUX_TYPE configLock = portMUX_INITIALIZER_UNLOCKED;
+static StaticTimer_t commitTimerBuffer;
+static TimerHandle_t commitTimer = NULL;
+
+static const char *TAG = "ASE-PROJECT-CONFIG";
+
+/*---------------------------------------------------------------
+        Config Initialization
+---------------------------------------------------------------*/
+void config_init(void)
+{
+    uint16_t *values = (uint16_t *)&config;
+    nvs_handle_t nvsHandle;
+
+    for (int i = 0; i < CFG_TOTAL_KEYS; i++)
+        for (int zone = 0; zone < schema[i].zones; zone++)
+            values[schema[i].slot + zone] = schema[i].def;
+
+    if (nvs_open(CFG_NVS_NAMESPACE, NVS_READONLY, &nvsHandle) == ESP_OK)
+    {
+        for (int i = 0; i < CFG_TOTAL_KEYS; i++)
+        {
+            for (int zone = 0; zone < schema[i].zones; zone++)
+            {
+                char name[16];
+                uint16_t value;
+
+                config_nvs_key(&schema[i], zone, name);
+                if (nvs_get_u16(nvsHandle, name, &value) != ESP_OK)
+                    continue;
+
+                if (value < schema[i].min || value > schema[i].max)
+                {
+                    ESP_LOGW(TAG, "%s=%u out of bounds, using default %u", name, value, schema[i].def);
+                    continue;
+                }
+
+                values[schema[i].slot + zone] = value;
+            }
+        }
+        nvs_close(nvsHandle);
+    }
+    else
+    {
+        ESP_LOGI(TAG, "no stored configuration, using defaults");
+    }
+
+    commitTimer = xTimerCreateStatic("Config_Commit", pdMS_TO_TICKS(CFG_COMMIT_DELAY_MS), pdFALSE, NULL, config_commit_cb,
+                                     &commitTimerBuffer);
+}
+
+/*---------------------------------------------------------------
+        Config Access
+---------------------------------------------------------------*/
+esp_err_t config_set(config_key_t key, uint16_t value)
+{
+    return config_set_zone(key, 0, value);
+}
+
+esp_err_t config_set_zone(config_key_t key, int zone, uint16_t value)
+{
+    if (key >= CFG_TOTAL_KEYS || zone < 0 || zone >= schema[key].zones)
+        return ESP_ERR_INVALID_ARG;
+
+    if (value < schema[key].min || value > schema[key].max)
+        return ESP_ERR_INVALID_ARG;
+
+    uint16_t *values = (uint16_t *)&config;
+    int slot = schema[key].slot + zone;
+    bool restart = false;
+
+    taskENTER_CRITICAL(&configLock);
+    if (values[slot] != value)
+    {
+        values[slot] = value;
+
+        TickType_t now = xTaskGetTickCount();
+        if (dirty == 0)
+            firstDirtyTick = now;
+        dirty |= 1ULL << slot;
+
+        /* keep pushing the commit back while the burst goes on, up to the max delay */
+        restart = (now - firstDirtyTick) < pdMS_TO_TICKS(CFG_COMMIT_MAX_DELAY_MS);
+    }
+    taskEXIT_CRITICAL(&configLock);
+
+    if (restart)
+        xTimerReset(commitTimer, 0);
+
+    return ESP_OK;
+}
+
+uint16_t config_get(config_key_t key)
+{
+    return config_get_zone(key, 0);
+}
+
+uint16_t config_get_zone(config_key_t key, int zone)
+{
+    return ((const uint16_t *)&config)[schema[key].slot + zone];
+}
+
+void config_flush(void)
+{
+    xTimerStop(commitTimer, 0);
+    config_commit();
+}
+
+void config_reset(void)
+{
+    for (int i = 0; i < CFG_TOTAL_KEYS; i++)
+        for (int zone = 0; zone < schema[i].zones; zone++)
+            config_set_zone(i, zone, schema[i].def);
+}
+
+const config_schema_t *config_schema(config_key_t key)
+{
+    return key < CFG_TOTAL_KEYS ? &schema[key] : NULL;
+}
+
+int config_find(const char *key)
+{
+    for (int i = 0; i < CFG_TOTAL_KEYS; i++)
+    {
+        if (strcmp(schema[i].key, key) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/*---------------------------------------------------------------
+        NVS Commit
+---------------------------------------------------------------*/
+static void config_commit_cb(TimerHandle_t timer)
+{
+    config_commit();
+}
+
+static void config_commit(void)
+{
+    uint16_t values[CFG_TOTAL_SLOTS];
+    uint64_t pending;
+    nvs_handle_t nvsHandle;
+
+    taskENTER_CRITICAL(&configLock);
+    pending = dirty;
+    dirty = 0;
+    memcpy(values, &config, sizeof(values));
+    taskEXIT_CRITICAL(&configLock);
+
+    if (pending == 0)
+        return;
+
+    esp_err_t err = nvs_open(CFG_NVS_NAMESPACE, NVS_READWRITE, &nvsHandle);
+    if (err == ESP_OK)
+    {
+        for (int i = 0; i < CFG_TOTAL_KEYS && err == ESP_OK; i++)
+        {
+            for (int zone = 0; zone < schema[i].zones && err == ESP_OK; zone++)
+            {
+                char name[16];
+
+                if (!(pending & (1ULL << (schema[i].slot + zone))))
+                    continue;
+
+                config_nvs_key(&schema[i], zone, name);
+                err = nvs_set_u16(nvsHandle, name, values[schema[i].slot + zone]);
+            }
+        }
+
+        if (err == ESP_OK)
+            err = nvs_commit(nvsHandle);
+
+        nvs_close(nvsHandle);
+    }
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "commit failed (%s), retrying later", esp_err_to_name(err));
+
+        taskENTER_CRITICAL(&configLock);
+        dirty |= pending;
+        firstDirtyTick = xTaskGetTickCount();
+        taskEXIT_CRITICAL(&configLock);
+
+        xTimerReset(commitTimer, 0);
+        return;
+    }
+
+    ESP_LOGI(TAG, "committed config (mask 0x%llx)", (unsigned long long)pending);
+}
+
+static void config_nvs_key(const config_schema_t *entry, int zone, char *name)
+{
+    /* zone 0 keeps the single-zone key so existing settings carry over */
+    if (zone == 0)
+        strlcpy(name, entry->key, 16);
+    else
+        snprintf(name, 16, "%s%d", entry->key, zone);
+}
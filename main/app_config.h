@@ -0,0 +1,73 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_zones.h"
+
+#define CFG_NVS_NAMESPACE "app_config"
+#define CFG_COMMIT_DELAY_MS 2000      // quiet time before a burst of writes is committed
+#define CFG_COMMIT_MAX_DELAY_MS 10000 // a continuous burst is still committed after this
+
+enum config_key_t
+{
+    CFG_TIME_WATERING,
+    CFG_AUTO_WATERING,
+    CFG_TARGET_MOISTURE,
+    CFG_ALERT_LOW,
+    CFG_ALERT_CLEAR,
+    CFG_WAIT_AFTER_WATERING,
+    CFG_SENSOR_DRY_RAW,
+    CFG_SENSOR_WET_RAW,
+    CFG_READ_FRESHNESS,
+    CFG_STORAGE,
+    CFG_SENSOR_SETTLE,
+    CFG_EEPROM_CLOCK,
+    CFG_TOTAL_KEYS,
+};
+typedef enum config_key_t config_key_t;
+
+/* per-zone fields hold one value per zone, zone 0 keeps the original NVS key */
+struct config_t
+{
+    uint16_t timeWatering[ZONE_COUNT];   // seconds of manual watering
+    uint16_t autoWatering[ZONE_COUNT];   // 0 or 1
+    uint16_t targetMoisture[ZONE_COUNT]; // % auto watering aims for
+    uint16_t alertLow[ZONE_COUNT];       // % that raises the critical alert
+    uint16_t alertClear[ZONE_COUNT];     // % that re-arms the critical alert
+    uint16_t waitAfterWateringS;         // seconds to let the soil settle after watering
+    uint16_t sensorDryRaw[ZONE_COUNT];   // raw ADC reading at 0%
+    uint16_t sensorWetRaw[ZONE_COUNT];   // raw ADC reading at 100%
+    uint16_t readFreshnessS;             // on-demand reads younger than this come from cache
+    uint16_t storage;                    // history backend, STORAGE_EEPROM or STORAGE_FLASH, read at boot
+    uint16_t sensorSettleMs;             // probe power-on to stable output, set by 'calibrate settle'
+    uint16_t eepromClockKhz;             // history EEPROM SPI clock, 0 characterizes the bus at the next boot
+};
+typedef struct config_t config_t;
+
+#define CFG_TOTAL_SLOTS (sizeof(config_t) / sizeof(uint16_t))
+
+struct config_schema_t
+{
+    const char *key; // NVS key, at most 14 characters so a zone digit fits
+    uint16_t min;
+    uint16_t max;
+    uint16_t def;
+    uint8_t slot;  // index of the first value in config_t
+    uint8_t zones; // 1 for global keys, ZONE_COUNT for per-zone keys
+};
+typedef struct config_schema_t config_schema_t;
+
+/* RAM copy loaded at boot, read it directly */
+extern const config_t *const appConfig;
+
+void config_init(void);
+esp_err_t config_set(config_key_t key, uint16_t value);
+esp_err_t config_set_zone(config_key_t key, int zone, uint16_t value);
+uint16_t config_get(config_key_t key);
+uint16_t config_get_zone(config_key_t key, int zone);
+void config_flush(void);
+void config_reset(void);
+const config_schema_t *config_schema(config_key_t key);
+int config_find(const char *key);
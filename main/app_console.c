@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "driver/uart.h"
+#include "esp_log.h"
+
+#include "app_console.h"
+#include "app_mem.h"
+
+static void console_task(void *arg);
+static void console_run_line(char *line);
+
+static QueueHandle_t uartQueue = NULL;
+static TaskHandle_t consoleTaskHandle = NULL;
+
+static const char *TAG = "ASE-PROJECT-CONSOLE";
+
+/*---------------------------------------------------------------
+        Console Initialization
+---------------------------------------------------------------*/
+void console_init(void)
+{
+    /* the driver delivers RX through an event queue, the console task sleeps on it */
+    ESP_ERROR_CHECK(uart_driver_install(CONSOLE_UART_NUM, CONSOLE_UART_RX_BUF_SIZE, 0,
+                                        CONSOLE_UART_QUEUE_SIZE, &uartQueue, 0));
+
+    esp_console_config_t consoleConfig = ESP_CONSOLE_CONFIG_DEFAULT();
+    consoleConfig.max_cmdline_length = CONSOLE_MAX_LINE;
+    consoleConfig.max_cmdline_args = CONSOLE_MAX_ARGS;
+    ESP_ERROR_CHECK(esp_console_init(&consoleConfig));
+
+    ESP_ERROR_CHECK(esp_console_register_help_command());
+}
+
+void console_register(const char *command, const char *hint, const char *help, esp_console_cmd_func_t func)
+{
+    const esp_console_cmd_t cmd = {
+        .command = command,
+        .help = help,
+        .hint = hint,
+        .func = func,
+    };
+    ESP_ERROR_CHECK(esp_console_cmd_register(&cmd));
+}
+
+void console_start(void)
+{
+    ESP_ERROR_CHECK(mem_task_start(MEM_TASK_CONSOLE, 0, console_task, NULL, &consoleTaskHandle));
+}
+
+/*---------------------------------------------------------------
+        Console Task
+---------------------------------------------------------------*/
+static void console_task(void *arg)
+{
+    static char line[CONSOLE_MAX_LINE];
+    static uint8_t rx[CONSOLE_UART_RX_BUF_SIZE];
+    size_t length = 0;
+    uart_event_t event;
+
+    printf("\n" CONSOLE_PROMPT);
+    fflush(stdout);
+
+    while (1)
+    {
+        if (xQueueReceive(uartQueue, &event, portMAX_DELAY) != pdTRUE)
+            continue;
+
+        switch (event.type)
+        {
+        case UART_DATA:
+        {
+            int read = uart_read_bytes(CONSOLE_UART_NUM, rx, event.size < sizeof(rx) ? event.size : sizeof(rx), 0);
+
+            for (int i = 0; i < read; i++)
+            {
+                char c = (char)rx[i];
+
+                if (c == '\r' || c == '\n')
+                {
+                    if (length == 0)
+                        continue;
+
+                    line[length] = '\0';
+                    length = 0;
+
+                    printf("\n");
+                    console_run_line(line);
+                    printf(CONSOLE_PROMPT);
+                }
+                else if (c == '\b' || c == 0x7F)
+                {
+                    if (length > 0)
+                    {
+                        length--;
+                        printf("\b \b");
+                    }
+                }
+                else if (length < sizeof(line) - 1)
+                {
+                    line[length++] = c;
+                    putchar(c);
+                }
+            }
+            fflush(stdout);
+            break;
+        }
+
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            ESP_LOGW(TAG, "console input overflow, line dropped");
+            uart_flush_input(CONSOLE_UART_NUM);
+            xQueueReset(uartQueue);
+            length = 0;
+            break;
+
+        default:
+            break;
+        }
+    }
+}
+
+static void console_run_line(char *line)
+{
+    int ret;
+    esp_err_t err = esp_console_run(line, &ret);
+
+    if (err == ESP_ERR_NOT_FOUND)
+        printf("Unrecognized command, type 'help'\n");
+    else if (err == ESP_OK && ret != ESP_OK)
+        printf("Command returned non-zero error code: 0x%x (%s)\n", ret, esp_err_to_name(ret));
+    else if (err != ESP_OK && err != ESP_ERR_INVALID_ARG)
+        printf("Internal error: %s\n", esp_err_to_name(err));
+}
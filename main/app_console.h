@@ -0,0 +1,14 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+#include "esp_console.h"
+
+#define CONSOLE_UART_NUM CONFIG_ESP_CONSOLE_UART_NUM
+#define CONSOLE_UART_RX_BUF_SIZE 256
+#define CONSOLE_UART_QUEUE_SIZE 8
+#define CONSOLE_MAX_LINE 128
+#define CONSOLE_MAX_ARGS 8
+#define CONSOLE_PROMPT "ase> "
+
+void console_init(void);
+void console_register(const char *command, const char *hint, const char *help, esp_console_cmd_func_t func);
+void console_start(void);
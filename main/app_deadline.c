@@ -0,0 +1,148 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_timer.h"
+
+#include "app_deadline.h"
+#include "app_tlog.h"
+#include "app_trace.h"
+
+struct deadline_desc_t
+{
+    const char *name;
+    uint32_t budgetMs;
+    uint8_t shedAt;
+};
+typedef struct deadline_desc_t deadline_desc_t;
+
+static void deadline_decay(int64_t nowUs);
+
+#define DEADLINE_DESC(job, name, budgetMs, shedAt) [job] = {name, budgetMs, shedAt},
+static const deadline_desc_t jobs[DEADLINE_TOTAL_JOBS] = {DEADLINE_JOBS(DEADLINE_DESC)};
+
+static deadline_stats_t stats[DEADLINE_TOTAL_JOBS];
+static int level = 0;
+static int peakLevel = 0;
+static int64_t levelUs = 0; // last miss or step down, the recovery time counts from here
+static portMUX_TYPE deadlineLock = portMUX_INITIALIZER_UNLOCKED;
+
+/*---------------------------------------------------------------
+        Job Timing
+---------------------------------------------------------------*/
+int64_t deadline_due(deadline_job_t job, int64_t releaseUs)
+{
+    return releaseUs + 1000LL * jobs[job].budgetMs;
+}
+
+void deadline_done(deadline_job_t job, int64_t dueUs)
+{
+    int64_t nowUs = esp_timer_get_time();
+    int64_t lateUs = nowUs - dueUs;
+    int raised = -1;
+
+    taskENTER_CRITICAL(&deadlineLock);
+    stats[job].runs++;
+    if (lateUs > 0)
+    {
+        stats[job].misses++;
+        if (lateUs > stats[job].worstUs)
+            stats[job].worstUs = lateUs;
+
+        /* every miss is one more step, a slow cloud call keeps pushing until its class is shed */
+        if (level < DEADLINE_MAX_LEVEL)
+        {
+            raised = ++level;
+            if (level > peakLevel)
+                peakLevel = level;
+        }
+        levelUs = nowUs;
+    }
+    else
+    {
+        deadline_decay(nowUs);
+    }
+    taskEXIT_CRITICAL(&deadlineLock);
+
+    if (raised >= 0)
+    {
+        TLOG(TLOG_DEADLINE_SHED, job, (uint32_t)(lateUs / 1000), raised);
+        trace_record(TRACE_SHED_LEVEL, job, raised);
+    }
+}
+
+/* false when the job is to be deferred or dropped at the current level */
+bool deadline_admit(deadline_job_t job)
+{
+    bool admitted;
+
+    taskENTER_CRITICAL(&deadlineLock);
+    deadline_decay(esp_timer_get_time());
+    admitted = jobs[job].shedAt == DEADLINE_NEVER || level < jobs[job].shedAt;
+    if (!admitted)
+        stats[job].shed++;
+    taskEXIT_CRITICAL(&deadlineLock);
+
+    return admitted;
+}
+
+int deadline_level(void)
+{
+    int current;
+
+    taskENTER_CRITICAL(&deadlineLock);
+    deadline_decay(esp_timer_get_time());
+    current = level;
+    taskEXIT_CRITICAL(&deadlineLock);
+
+    return current;
+}
+
+void deadline_reset(void)
+{
+    taskENTER_CRITICAL(&deadlineLock);
+    memset(stats, 0, sizeof(stats));
+    level = 0;
+    peakLevel = 0;
+    taskEXIT_CRITICAL(&deadlineLock);
+}
+
+/* under deadlineLock, one step down per quiet recovery period */
+static void deadline_decay(int64_t nowUs)
+{
+    while (level > 0 && nowUs - levelUs >= 1000LL * DEADLINE_RECOVER_MS)
+    {
+        level--;
+        levelUs += 1000LL * DEADLINE_RECOVER_MS;
+    }
+}
+
+/*---------------------------------------------------------------
+        Deadline Report
+---------------------------------------------------------------*/
+void deadline_print(void)
+{
+    deadline_stats_t copy[DEADLINE_TOTAL_JOBS];
+    int current, peak;
+
+    taskENTER_CRITICAL(&deadlineLock);
+    deadline_decay(esp_timer_get_time());
+    memcpy(copy, stats, sizeof(copy));
+    current = level;
+    peak = peakLevel;
+    taskEXIT_CRITICAL(&deadlineLock);
+
+    printf("shed level %d of %d (peak %d)\n", current, DEADLINE_MAX_LEVEL, peak);
+    printf("%-10s %7s %8s %6s %6s %6s %10s\n", "job", "budget", "shed at", "runs", "misses", "shed", "worst late");
+    for (int i = 0; i < DEADLINE_TOTAL_JOBS; i++)
+    {
+        char shedAt[8] = "never";
+        if (jobs[i].shedAt != DEADLINE_NEVER)
+            snprintf(shedAt, sizeof(shedAt), "%u", jobs[i].shedAt);
+
+        printf("%-10s %5lums %8s %6lu %6lu %6lu %8lldms%s\n", jobs[i].name, (unsigned long)jobs[i].budgetMs, shedAt,
+               (unsigned long)copy[i].runs, (unsigned long)copy[i].misses, (unsigned long)copy[i].shed,
+               copy[i].worstUs / 1000, jobs[i].shedAt != DEADLINE_NEVER && current >= jobs[i].shedAt ? "  (shed)" : "");
+    }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DEADLINE_NEVER 0             // shed level of jobs that always run
+#define DEADLINE_MAX_LEVEL 3         // everything below critical is shed
+#define DEADLINE_RECOVER_MS 30000    // a level without misses for this long steps down
+#define DEADLINE_SAMPLE_MARGIN_MS 20 // per zone, on top of the probe settle time
+
+/*
+ * Jobs the monitor times. A job is due its budget after its release: the
+ * timer alarm for a sample (plus the probe settle time), the scheduled
+ * stop for the pump, the call for a report. Completing past the due time
+ * is a miss and raises the shed level by one. From its shed level on, a
+ * job is deferred or dropped, so an overloaded cloud path sheds exports
+ * and history dumps first, then status reports, then moisture reports.
+ * Sampling, the pump stop and critical alerts are never shed.
+ *
+ * X(job, name, budget ms, shed level)
+ */
+#define DEADLINE_JOBS(X)                                   \
+    X(DEADLINE_SAMPLE, "sample", 500, DEADLINE_NEVER)      \
+    X(DEADLINE_PUMP_STOP, "pump stop", 20, DEADLINE_NEVER) \
+    X(DEADLINE_ALERT, "alert", 2000, DEADLINE_NEVER)       \
+    X(DEADLINE_REPORT, "report", 500, 3)                   \
+    X(DEADLINE_STATUS, "status", 500, 2)                   \
+    X(DEADLINE_HISTORY, "history", 60000, 1)               \
+    X(DEADLINE_EXPORT, "export", 60000, 1)
+
+#define DEADLINE_ENUM(job, name, budgetMs, shedAt) job,
+
+enum deadline_job_t
+{
+    DEADLINE_JOBS(DEADLINE_ENUM)
+    DEADLINE_TOTAL_JOBS,
+};
+typedef enum deadline_job_t deadline_job_t;
+
+struct deadline_stats_t
+{
+    uint32_t runs;
+    uint32_t misses;
+    uint32_t shed;   // deferred or dropped while the level was at or above the job's
+    int64_t worstUs; // latest completion past the due time, 0 if never late
+};
+typedef struct deadline_stats_t deadline_stats_t;
+
+int64_t deadline_due(deadline_job_t job, int64_t releaseUs);
+void deadline_done(deadline_job_t job, int64_t dueUs);
+bool deadline_admit(deadline_job_t job);
+int deadline_level(void);
+void deadline_reset(void);
+void deadline_print(void);
@@ -0,0 +1,436 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_crt_bundle.h"
+#include "esp_http_client.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_system.h"
+#include "mbedtls/sha256.h"
+
+#include "app_delta.h"
+
+enum delta_state_t
+{
+    DELTA_HEADER,  // collecting the magic, then the rest of the header
+    DELTA_FULL,    // not a patch, every byte goes to the partition
+    DELTA_OP,      // next byte is an opcode
+    DELTA_ARGS,    // collecting the operands of op
+    DELTA_LITERAL, // inserting literal bytes
+    DELTA_DONE,    // end op seen
+};
+typedef enum delta_state_t delta_state_t;
+
+struct delta_t
+{
+    delta_state_t state;
+    const esp_partition_t *base;
+    const esp_partition_t *target;
+    esp_ota_handle_t ota;
+    mbedtls_sha256_context sha; // over the image written to target
+    delta_header_t header;
+    uint8_t pending[sizeof(delta_header_t)]; // header or operands split across writes
+    size_t pendingSize;
+    size_t pendingNeed;
+    uint8_t op;
+    uint32_t literal; // insert bytes still to come
+    uint32_t written;
+    uint8_t buffer[DELTA_BUFFER_SIZE];
+};
+typedef struct delta_t delta_t;
+
+static esp_err_t delta_header(void);
+static esp_err_t delta_operands(void);
+static esp_err_t delta_copy(uint32_t offset, uint32_t length);
+static esp_err_t delta_emit(const uint8_t *data, size_t size);
+static esp_err_t delta_hash_base(uint32_t size, uint8_t *sha256);
+static uint32_t delta_u32(const uint8_t *p);
+
+static delta_t deltaState; // reserved at build time, an update must not depend on a heap block
+static delta_t *delta = NULL;
+
+static const char *TAG = "ASE-PROJECT-DELTA";
+
+/*---------------------------------------------------------------
+        Streaming Update
+---------------------------------------------------------------*/
+esp_err_t delta_begin(void)
+{
+    if (delta != NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    delta = &deltaState;
+    memset(delta, 0, sizeof(delta_t));
+
+    delta->base = esp_ota_get_running_partition();
+    delta->target = esp_ota_get_next_update_partition(NULL);
+    if (delta->target == NULL)
+    {
+        delta = NULL;
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    /* the magic alone tells a patch from a full image */
+    delta->state = DELTA_HEADER;
+    delta->pendingNeed = sizeof(uint32_t);
+    mbedtls_sha256_init(&delta->sha);
+    mbedtls_sha256_starts(&delta->sha, 0);
+
+    return ESP_OK;
+}
+
+esp_err_t delta_write(const uint8_t *data, size_t size)
+{
+    esp_err_t err = ESP_OK;
+
+    if (delta == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    while (size > 0 && err == ESP_OK)
+    {
+        size_t take;
+
+        switch (delta->state)
+        {
+        case DELTA_HEADER:
+        case DELTA_ARGS:
+            take = delta->pendingNeed - delta->pendingSize;
+            take = take < size ? take : size;
+            memcpy(delta->pending + delta->pendingSize, data, take);
+            delta->pendingSize += take;
+
+            if (delta->pendingSize == delta->pendingNeed)
+                err = delta->state == DELTA_HEADER ? delta_header() : delta_operands();
+            break;
+
+        case DELTA_FULL:
+            take = size;
+            err = delta_emit(data, take);
+            break;
+
+        case DELTA_OP:
+            take = 1;
+            delta->op = data[0];
+            delta->pendingSize = 0;
+
+            if (delta->op == DELTA_OP_COPY)
+            {
+                delta->pendingNeed = 2 * sizeof(uint32_t);
+                delta->state = DELTA_ARGS;
+            }
+            else if (delta->op == DELTA_OP_INSERT)
+            {
+                delta->pendingNeed = sizeof(uint32_t);
+                delta->state = DELTA_ARGS;
+            }
+            else if (delta->op == DELTA_OP_END)
+            {
+                delta->state = DELTA_DONE;
+            }
+            else
+            {
+                ESP_LOGE(TAG, "bad opcode 0x%02x", delta->op);
+                err = ESP_ERR_INVALID_ARG;
+            }
+            break;
+
+        case DELTA_LITERAL:
+            take = delta->literal < size ? delta->literal : size;
+            err = delta_emit(data, take);
+            delta->literal -= take;
+
+            if (delta->literal == 0)
+                delta->state = DELTA_OP;
+            break;
+
+        default:
+            ESP_LOGE(TAG, "data after the end of the patch");
+            take = size;
+            err = ESP_ERR_INVALID_SIZE;
+            break;
+        }
+
+        data += take;
+        size -= take;
+    }
+
+    if (err != ESP_OK)
+        delta_abort();
+
+    return err;
+}
+
+esp_err_t delta_end(void)
+{
+    esp_err_t err = ESP_OK;
+    uint8_t sha256[32];
+
+    if (delta == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    if (delta->state != DELTA_FULL)
+    {
+        /* the patch must be complete and rebuild exactly the image it was made from */
+        mbedtls_sha256_finish(&delta->sha, sha256);
+
+        if (delta->state != DELTA_DONE || delta->written != delta->header.targetSize)
+        {
+            ESP_LOGE(TAG, "patch truncated, %lu of %lu bytes", (unsigned long)delta->written, (unsigned long)delta->header.targetSize);
+            err = ESP_ERR_INVALID_SIZE;
+        }
+        else if (memcmp(sha256, delta->header.targetSha256, sizeof(sha256)) != 0)
+        {
+            ESP_LOGE(TAG, "rebuilt image does not match the target hash");
+            err = ESP_ERR_INVALID_CRC;
+        }
+    }
+
+    if (err != ESP_OK)
+    {
+        delta_abort();
+        return err;
+    }
+
+    /* esp_ota_end still validates the image itself (header, checksum, signature) */
+    err = esp_ota_end(delta->ota);
+    if (err == ESP_OK)
+        err = esp_ota_set_boot_partition(delta->target);
+
+    if (err == ESP_OK)
+        ESP_LOGI(TAG, "%s image written to %s (%lu bytes)", delta->state == DELTA_FULL ? "full" : "patched", delta->target->label,
+                 (unsigned long)delta->written);
+
+    mbedtls_sha256_free(&delta->sha);
+    delta = NULL;
+
+    return err;
+}
+
+void delta_abort(void)
+{
+    if (delta == NULL)
+        return;
+
+    if (delta->ota != 0)
+        esp_ota_abort(delta->ota);
+
+    mbedtls_sha256_free(&delta->sha);
+    delta = NULL;
+}
+
+static esp_err_t delta_header(void)
+{
+    esp_err_t err;
+    uint8_t sha256[32];
+
+    if (delta->pendingNeed == sizeof(uint32_t))
+    {
+        if (delta_u32(delta->pending) != DELTA_MAGIC)
+        {
+            /* plain image, keep the bytes already taken */
+            ESP_LOGI(TAG, "no patch header, writing a full image");
+            err = esp_ota_begin(delta->target, OTA_SIZE_UNKNOWN, &delta->ota);
+            if (err != ESP_OK)
+                return err;
+
+            delta->state = DELTA_FULL;
+            return delta_emit(delta->pending, delta->pendingSize);
+        }
+
+        delta->pendingNeed = sizeof(delta_header_t);
+        return ESP_OK;
+    }
+
+    memcpy(&delta->header, delta->pending, sizeof(delta_header_t));
+
+    if (delta->header.version != DELTA_VERSION || delta->header.targetSize > delta->target->size ||
+        delta->header.baseSize > delta->base->size)
+    {
+        ESP_LOGE(TAG, "unsupported patch (version %u)", delta->header.version);
+        return ESP_ERR_NOT_SUPPORTED;
+    }
+
+    /* copies read the running partition, it has to be the exact image the patch was made against */
+    err = delta_hash_base(delta->header.baseSize, sha256);
+    if (err != ESP_OK)
+        return err;
+
+    if (memcmp(sha256, delta->header.baseSha256, sizeof(sha256)) != 0)
+    {
+        ESP_LOGE(TAG, "patch base does not match the running image, a full image is needed");
+        return ESP_ERR_INVALID_VERSION;
+    }
+
+    err = esp_ota_begin(delta->target, delta->header.targetSize, &delta->ota);
+    if (err != ESP_OK)
+        return err;
+
+    ESP_LOGI(TAG, "applying patch from %s to %s, %lu byte image", delta->base->label, delta->target->label,
+             (unsigned long)delta->header.targetSize);
+
+    delta->state = DELTA_OP;
+    return ESP_OK;
+}
+
+static esp_err_t delta_operands(void)
+{
+    if (delta->op == DELTA_OP_COPY)
+    {
+        delta->state = DELTA_OP;
+        return delta_copy(delta_u32(delta->pending), delta_u32(delta->pending + 4));
+    }
+
+    delta->literal = delta_u32(delta->pending);
+    delta->state = delta->literal > 0 ? DELTA_LITERAL : DELTA_OP;
+    return ESP_OK;
+}
+
+static esp_err_t delta_copy(uint32_t offset, uint32_t length)
+{
+    esp_err_t err = ESP_OK;
+
+    if (offset > delta->header.baseSize || length > delta->header.baseSize - offset)
+    {
+        ESP_LOGE(TAG, "copy outside the base image");
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    while (length > 0 && err == ESP_OK)
+    {
+        uint32_t chunk = length < DELTA_BUFFER_SIZE ? length : DELTA_BUFFER_SIZE;
+
+        err = esp_partition_read(delta->base, offset, delta->buffer, chunk);
+        if (err == ESP_OK)
+            err = delta_emit(delta->buffer, chunk);
+
+        offset += chunk;
+        length -= chunk;
+    }
+
+    return err;
+}
+
+static esp_err_t delta_emit(const uint8_t *data, size_t size)
+{
+    if (delta->state != DELTA_FULL && size > delta->header.targetSize - delta->written)
+    {
+        ESP_LOGE(TAG, "patch writes past the target size");
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    esp_err_t err = esp_ota_write(delta->ota, data, size);
+    if (err != ESP_OK)
+        return err;
+
+    mbedtls_sha256_update(&delta->sha, data, size);
+    delta->written += size;
+
+    return ESP_OK;
+}
+
+static esp_err_t delta_hash_base(uint32_t size, uint8_t *sha256)
+{
+    mbedtls_sha256_context sha;
+    esp_err_t err = ESP_OK;
+
+    mbedtls_sha256_init(&sha);
+    mbedtls_sha256_starts(&sha, 0);
+
+    for (uint32_t offset = 0; offset < size && err == ESP_OK; offset += DELTA_BUFFER_SIZE)
+    {
+        uint32_t chunk = size - offset < DELTA_BUFFER_SIZE ? size - offset : DELTA_BUFFER_SIZE;
+
+        err = esp_partition_read(delta->base, offset, delta->buffer, chunk);
+        if (err == ESP_OK)
+            mbedtls_sha256_update(&sha, delta->buffer, chunk);
+    }
+
+    mbedtls_sha256_finish(&sha, sha256);
+    mbedtls_sha256_free(&sha);
+
+    return err;
+}
+
+static uint32_t delta_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/*---------------------------------------------------------------
+        Download
+---------------------------------------------------------------*/
+esp_err_t delta_apply_url(const char *url, const char *cert)
+{
+    static char chunk[DELTA_BUFFER_SIZE];
+
+    esp_http_client_config_t httpConfig = {
+        .url = url,
+        .cert_pem = cert,
+        .crt_bundle_attach = cert == NULL ? esp_crt_bundle_attach : NULL, // https without a pinned cert
+        .timeout_ms = 10000,
+        .buffer_size = DELTA_BUFFER_SIZE,
+    };
+
+    esp_http_client_handle_t client = esp_http_client_init(&httpConfig);
+    if (client == NULL)
+        return ESP_FAIL;
+
+    esp_err_t err = esp_http_client_open(client, 0);
+    if (err == ESP_OK && (esp_http_client_fetch_headers(client) < 0 || esp_http_client_get_status_code(client) != 200))
+        err = ESP_ERR_NOT_FOUND;
+
+    if (err == ESP_OK)
+        err = delta_begin();
+
+    /* streamed straight into the partition, only one chunk is ever held */
+    while (err == ESP_OK)
+    {
+        int read = esp_http_client_read(client, chunk, sizeof(chunk));
+        if (read < 0)
+        {
+            delta_abort();
+            err = ESP_FAIL;
+        }
+        else if (read == 0)
+        {
+            err = delta_end();
+            break;
+        }
+        else
+        {
+            err = delta_write((const uint8_t *)chunk, read);
+        }
+    }
+
+    esp_http_client_close(client);
+    esp_http_client_cleanup(client);
+
+    return err;
+}
+
+esp_err_t delta_rmaker_ota_cb(esp_rmaker_ota_handle_t handle, esp_rmaker_ota_data_t *otaData)
+{
+    esp_rmaker_ota_report_status(handle, OTA_STATUS_IN_PROGRESS, "Downloading");
+
+    esp_err_t err = delta_apply_url(otaData->url, otaData->server_cert);
+
+    if (err == ESP_ERR_INVALID_VERSION)
+    {
+        esp_rmaker_ota_report_status(handle, OTA_STATUS_FAILED, "Patch base does not match the running image, push the full image");
+        return err;
+    }
+    else if (err != ESP_OK)
+    {
+        esp_rmaker_ota_report_status(handle, OTA_STATUS_FAILED, (char *)esp_err_to_name(err));
+        return err;
+    }
+
+    esp_rmaker_ota_report_status(handle, OTA_STATUS_SUCCESS, "Rebooting");
+    vTaskDelay(pdMS_TO_TICKS(5000));
+    esp_restart();
+
+    return ESP_OK;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+#include "esp_rmaker_ota.h"
+
+#define DELTA_MAGIC 0x50445341 // "ASDP"
+#define DELTA_VERSION 1
+#define DELTA_BUFFER_SIZE 1024 // copy and download buffer, the whole update runs in about twice this
+
+/*
+ * Patch layout, little endian, made by tools/delta_ota.py:
+ *
+ *   header   magic u32, version u8, reserved u8[3], base size u32,
+ *            target size u32, base sha256[32], target sha256[32]
+ *   ops      DELTA_OP_COPY   offset u32, length u32  bytes of the running image
+ *            DELTA_OP_INSERT length u32, then the bytes
+ *            DELTA_OP_END
+ *
+ * The base is the image the running partition was flashed with. Any stream
+ * without the magic is written as a full image.
+ */
+#define DELTA_OP_END 0x00
+#define DELTA_OP_COPY 0x01
+#define DELTA_OP_INSERT 0x02
+
+struct delta_header_t
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t reserved[3];
+    uint32_t baseSize;
+    uint32_t targetSize;
+    uint8_t baseSha256[32];
+    uint8_t targetSha256[32];
+} __attribute__((packed));
+typedef struct delta_header_t delta_header_t;
+
+esp_err_t delta_begin(void);
+esp_err_t delta_write(const uint8_t *data, size_t size);
+esp_err_t delta_end(void);
+void delta_abort(void);
+/* cert NULL verifies an https server against the ESP-IDF certificate bundle */
+esp_err_t delta_apply_url(const char *url, const char *cert);
+esp_err_t delta_rmaker_ota_cb(esp_rmaker_ota_handle_t handle, esp_rmaker_ota_data_t *otaData);
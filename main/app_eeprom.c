@@ -1,86 +1,417 @@
 #include <stdio.h>
+#include <string.h>
 
+#include "esp_log.h"
+
+#include "app_config.h"
 #include "app_eeprom.h"
+#include "app_gptimer.h"
+#include "app_zones.h"
+
+static esp_err_t eeprom_open(void);
+static esp_err_t eeprom_recover(void);
+static esp_err_t eeprom_reset(uint64_t timestamp);
+static esp_err_t eeprom_append(const uint8_t samples[ZONE_COUNT], uint64_t timestamp, uint16_t deltaS);
+static int eeprom_read_range(int zone, uint32_t first, uint8_t *samples, uint16_t count);
+static int eeprom_read_deltas(uint32_t first, uint16_t *deltas, uint16_t count);
+static esp_err_t eeprom_flush(void);
+static uint32_t eeprom_count(void);
+static uint32_t eeprom_capacity(void);
+static uint64_t eeprom_timestamp(void);
+static void eeprom_wear(uint32_t *bytesWritten, uint32_t *erases);
+static void eeprom_clean_moisture_readings(void);
+static uint32_t eeprom_zone_base(int zone);
+static uint32_t eeprom_tail_rows(uint32_t timed);
+static uint32_t eeprom_tail_address(uint32_t byte);
+static bool eeprom_timed(uint8_t sample);
+static void eeprom_clock_init(void);
+static bool eeprom_downshift(esp_err_t err);
+static esp_err_t eeprom_read(uint32_t address, uint8_t *pBuffer, uint32_t size);
+static esp_err_t eeprom_write(uint32_t address, const uint8_t *pBuffer, uint32_t size);
+
+_Static_assert(sizeof(eeprom_header_t) == HISTORY_FIRST_ADDRESS, "eeprom_header_t must fill the header");
+_Static_assert(EEPROM_COUNT >= 1 && EEPROM_COUNT <= SPI_25XX_MAX_STRIPE, "EEPROM_COUNT must be between 1 and SPI_25XX_MAX_STRIPE");
+
+const storage_backend_t storageEeprom = {
+    .name = "eeprom",
+    .endurance = EEPROM_ENDURANCE,
+    .cyclesPerWrap = 2, // cleared to 0xFF, then written once
+    .wraps = false,
+    .open = eeprom_open,
+    .recover = eeprom_recover,
+    .reset = eeprom_reset,
+    .append = eeprom_append,
+    .read_range = eeprom_read_range,
+    .read_deltas = eeprom_read_deltas,
+    .flush = eeprom_flush,
+    .count = eeprom_count,
+    .capacity = eeprom_capacity,
+    .timestamp = eeprom_timestamp,
+    .wear = eeprom_wear,
+};
+
+static spi_25xx_stripe_t eeprom = {0};
+static uint32_t eepromScratch = 0;   // address of the scratch pages, one per chip, the log ends before it
+static uint32_t eepromPartition = 0; // samples each zone holds
+static uint64_t eepromTimestamp = 0;
+static uint32_t eepromRecords = 0; // records written since the base timestamp
+static uint64_t eepromLastTime = 0; // time the newest record is dated with
+static uint32_t eepromTimed = 0;    // timed records, their deltas fill the tail of the columns
+static uint32_t timedRecords[EEPROM_TIMED_SLOTS]; // index of every timed record, ascending
+static uint16_t timedDeltas[EEPROM_TIMED_SLOTS];
+static uint32_t eepromBytesWritten = 0;
+static uint32_t eepromPageClears = 0;
+static uint32_t eepromDownshifts = 0;
 
 static const char *TAG = "ASE-PROJECT-EEPROM";
 
-static uint16_t eeprom_address = 0x0000;
+void eeprom_init(void)
+{
+    static const int csPins[] = SPI_CS_IOS;
+
+    ESP_ERROR_CHECK(spi_25xx_stripe_init(SPI_MASTER_HOST, EEPROM_PART, csPins, EEPROM_COUNT, SPI_SCK_IO, SPI_MOSI_IO, SPI_MISO_IO,
+                                         SPI_CLK_SPEED_HZ, &eeprom));
+
+    /* a larger part only grows the partitions, one sample per zone per pass plus a delta now and then */
+    eepromScratch = eeprom.size - eeprom.count * eeprom.pageSize;
+    eepromPartition = (eepromScratch - HISTORY_FIRST_ADDRESS) / ZONE_COUNT;
+
+    ESP_LOGI(TAG, "%d x %s, %lu history samples per zone", eeprom.count, eeprom.devices[0].desc->name, (unsigned long)eepromPartition);
 
-void eeprom_init(spi_device_handle_t *devHandle)
+    eeprom_clock_init();
+}
+
+void eeprom_deinit(void)
 {
-    ESP_ERROR_CHECK(spi_25LC040_init(SPI_MASTER_HOST, SPI_CS_IO, SPI_SCK_IO, SPI_MOSI_IO, SPI_MISO_IO, SPI_CLK_SPEED_HZ, devHandle));
+    ESP_ERROR_CHECK(spi_25xx_stripe_free(SPI_MASTER_HOST, &eeprom));
 }
 
-void eeprom_deinit(spi_device_handle_t devHandle)
+/*---------------------------------------------------------------
+        Storage Backend
+---------------------------------------------------------------*/
+static esp_err_t eeprom_open(void)
 {
-    ESP_ERROR_CHECK(spi_25LC040_free(SPI_MASTER_HOST, devHandle));
+    return eeprom.count > 0 ? ESP_OK : ESP_ERR_INVALID_STATE;
 }
 
-void eeprom_write_timestamp(spi_device_handle_t devHandle, uint64_t timestamp)
+static esp_err_t eeprom_recover(void)
 {
-    uint8_t *data = (uint8_t *)(&timestamp);
+    eeprom_header_t header;
+
+    /* an erased header, a log written with another zone count or one without deltas is not continued */
+    ESP_ERROR_CHECK(eeprom_read(0, (uint8_t *)&header, sizeof(header)));
+    if (header.magic != EEPROM_LOG_MAGIC || header.zones != ZONE_COUNT)
+        return ESP_ERR_NOT_FOUND;
+    eepromTimestamp = header.timestamp;
+    eepromTimed = 0;
 
-    ESP_ERROR_CHECK(spi_25LC040_write_page(devHandle, 0, data, 8));
+    /* slots are cleared to 0xFF and written in order, one scan of zone 0 finds the head and the timed records */
+    uint8_t chunk[64];
+    uint64_t time = header.timestamp;
+    uint32_t i = 0;
+    bool erased = false;
 
-    eeprom_clean_moisture_readings(devHandle);
+    while (!erased && i < eepromPartition - eeprom_tail_rows(eepromTimed))
+    {
+        uint32_t n = eepromPartition - eeprom_tail_rows(eepromTimed) - i;
+        n = n < sizeof(chunk) ? n : sizeof(chunk);
+        ESP_ERROR_CHECK(eeprom_read(eeprom_zone_base(0) + i, chunk, n));
+
+        /* the stream grows with every timed record, records never reach into it */
+        for (uint32_t j = 0; j < n && i < eepromPartition - eeprom_tail_rows(eepromTimed); j++, i++)
+        {
+            if (chunk[j] == STORAGE_ERASED)
+            {
+                erased = true;
+                break;
+            }
+
+            if (!eeprom_timed(chunk[j]))
+            {
+                time += GPTIMER_PERIOD_S;
+                continue;
+            }
+
+            if (eepromTimed >= EEPROM_TIMED_SLOTS)
+                return ESP_ERR_NOT_FOUND;
+
+            uint8_t delta[EEPROM_DELTA_SIZE];
+            for (int b = 0; b < EEPROM_DELTA_SIZE; b++)
+                ESP_ERROR_CHECK(eeprom_read(eeprom_tail_address(eepromTimed * EEPROM_DELTA_SIZE + b), &delta[b], 1));
+
+            timedRecords[eepromTimed] = i;
+            timedDeltas[eepromTimed] = delta[0] | (delta[1] << 8);
+            time += timedDeltas[eepromTimed];
+            eepromTimed++;
+        }
+    }
+    eepromRecords = i;
+    eepromLastTime = time;
 
-    eeprom_address = 8;
+    ESP_LOGI(TAG, "recovered %lu records, %lu timed", (unsigned long)eepromRecords, (unsigned long)eepromTimed);
+    return ESP_OK;
 }
 
-int eeprom_read_timestamp(spi_device_handle_t devHandle, uint64_t *timestamp)
+static esp_err_t eeprom_reset(uint64_t timestamp)
 {
-    if (eeprom_address <= 8)
-        return 0;
+    eeprom_header_t header = {
+        .timestamp = timestamp,
+        .magic = EEPROM_LOG_MAGIC,
+        .zones = ZONE_COUNT,
+        .reserved = 0xFF,
+    };
 
-    uint8_t data[8];
+    eeprom_clean_moisture_readings();
 
-    for (int i = 0; i < 8; i++)
-        ESP_ERROR_CHECK(spi_25LC040_read_byte(devHandle, i, &data[i]));
+    ESP_ERROR_CHECK(eeprom_write(0, (uint8_t *)&header, sizeof(header)));
+    eepromBytesWritten += sizeof(header);
 
-    *timestamp = *(uint64_t *)data;
+    eepromTimestamp = header.timestamp;
+    eepromLastTime = header.timestamp;
+    eepromRecords = 0;
+    eepromTimed = 0;
 
-    return 1;
+    return ESP_OK;
 }
 
-int eeprom_write_moisture(spi_device_handle_t devHandle, uint8_t moisture)
+static esp_err_t eeprom_append(const uint8_t samples[ZONE_COUNT], uint64_t timestamp, uint16_t deltaS)
 {
-    if (eeprom_address >= 8 && eeprom_address < TOTAL_ADDRESSES)
+    /* dated from the grid rather than deltaS, so small offsets never add up */
+    uint64_t next = eepromLastTime + GPTIMER_PERIOD_S;
+    bool timed = timestamp + EEPROM_TIME_SLACK_S < next || timestamp > next + EEPROM_TIME_SLACK_S;
+    uint32_t timedAfter = eepromTimed + (timed ? 1 : 0);
+
+    if (timedAfter > EEPROM_TIMED_SLOTS || eepromRecords + 1 + eeprom_tail_rows(timedAfter) > eepromPartition)
+        return ESP_ERR_NO_MEM;
+
+    uint8_t first = samples[0];
+    uint16_t delta = 0;
+
+    if (timed)
     {
-        ESP_ERROR_CHECK(spi_25LC040_write_byte(devHandle, eeprom_address, moisture));
-        eeprom_address++;
-        return 1;
+        uint64_t elapsed = timestamp > eepromLastTime ? timestamp - eepromLastTime : 0;
+        delta = elapsed < UINT16_MAX ? elapsed : UINT16_MAX;
+
+        /* little endian, the delta is written before the record that points at it */
+        for (int b = 0; b < EEPROM_DELTA_SIZE; b++)
+        {
+            uint8_t byte = delta >> (8 * b);
+            ESP_ERROR_CHECK(eeprom_write(eeprom_tail_address(eepromTimed * EEPROM_DELTA_SIZE + b), &byte, 1));
+        }
+        eepromBytesWritten += EEPROM_DELTA_SIZE;
+
+        first = first == STORAGE_NO_SAMPLE ? EEPROM_TIMED_NO_SAMPLE : first | EEPROM_TIMED_FLAG;
+        next = eepromLastTime + delta;
+    }
+
+    /* zone 0 last, it marks the record as complete for recovery */
+    for (int zone = ZONE_COUNT - 1; zone > 0; zone--)
+        ESP_ERROR_CHECK(eeprom_write(eeprom_zone_base(zone) + eepromRecords, &samples[zone], 1));
+    ESP_ERROR_CHECK(eeprom_write(eeprom_zone_base(0) + eepromRecords, &first, 1));
+
+    if (timed)
+    {
+        timedRecords[eepromTimed] = eepromRecords;
+        timedDeltas[eepromTimed] = delta;
+        eepromTimed++;
     }
-    return 0;
+
+    eepromBytesWritten += ZONE_COUNT;
+    eepromLastTime = next;
+    eepromRecords++;
+    return ESP_OK;
 }
 
-int eeprom_read_moisture(spi_device_handle_t devHandle, uint16_t address, uint8_t *moisture)
+static int eeprom_read_range(int zone, uint32_t first, uint8_t *samples, uint16_t count)
 {
-    if (address + 8 >= eeprom_address)
+    if (first >= eepromRecords)
         return 0;
 
-    ESP_ERROR_CHECK(spi_25LC040_read_byte(devHandle, address + 8, moisture));
-    return 1;
+    if (count > eepromRecords - first)
+        count = eepromRecords - first;
+
+    ESP_ERROR_CHECK(eeprom_read(eeprom_zone_base(zone) + first, samples, count));
+
+    /* zone 0 carries the timed flag */
+    if (zone == 0)
+    {
+        for (uint16_t i = 0; i < count; i++)
+        {
+            if (samples[i] == EEPROM_TIMED_NO_SAMPLE)
+                samples[i] = STORAGE_NO_SAMPLE;
+            else if (eeprom_timed(samples[i]))
+                samples[i] &= ~EEPROM_TIMED_FLAG;
+        }
+    }
+    return count;
 }
 
-int eeprom_read_moisture_timestamp(spi_device_handle_t devHandle, uint16_t address, uint16_t *timestamp)
+static int eeprom_read_deltas(uint32_t first, uint16_t *deltas, uint16_t count)
 {
-    if (address + 8 >= eeprom_address)
+    if (first >= eepromRecords)
         return 0;
 
-    *timestamp = (address) * ((60 / MEASUREMENTS_PER_HOUR) * 60);
-    return 1;
+    if (count > eepromRecords - first)
+        count = eepromRecords - first;
+
+    /* the timed deltas are all in RAM, the first one at or after the range by bisection */
+    uint32_t low = 0, high = eepromTimed;
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (timedRecords[mid] < first)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+
+    for (uint16_t i = 0; i < count; i++)
+    {
+        if (low < eepromTimed && timedRecords[low] == first + i)
+            deltas[i] = timedDeltas[low++];
+        else
+            deltas[i] = GPTIMER_PERIOD_S;
+    }
+    return count;
 }
 
-int eeprom_read_last_moisture(spi_device_handle_t devHandle, uint8_t *moisture)
+static esp_err_t eeprom_flush(void)
 {
-    return eeprom_read_moisture(devHandle, eeprom_address - 8 - 1, moisture);
+    /* every append is a completed write cycle already */
+    return ESP_OK;
 }
 
-void eeprom_clean_moisture_readings(spi_device_handle_t devHandle)
+static uint32_t eeprom_count(void)
 {
-    uint64_t zeros[2] = {0, 0};
-    for (int i = 16; i < 512; i += 16)
+    return eepromRecords;
+}
+
+static uint32_t eeprom_capacity(void)
+{
+    /* without timed records, each one takes EEPROM_DELTA_SIZE / ZONE_COUNT rows of it */
+    return eepromPartition;
+}
+
+static uint64_t eeprom_timestamp(void)
+{
+    return eepromTimestamp;
+}
+
+static void eeprom_wear(uint32_t *bytesWritten, uint32_t *erases)
+{
+    *bytesWritten = eepromBytesWritten;
+    *erases = eepromPageClears;
+}
+
+static void eeprom_clean_moisture_readings(void)
+{
+    static uint8_t erased[SPI_25XX_MAX_PAGE_SIZE];
+    uint32_t size = eepromScratch;
+    uint16_t pageSize = eeprom.pageSize;
+
+    memset(erased, STORAGE_ERASED, sizeof(erased));
+
+    /* one page per write so consecutive pages alternate between striped chips, the first page shares its lower half with the timestamp */
+    for (uint32_t i = HISTORY_FIRST_ADDRESS; i < size; i += pageSize - (i % pageSize))
+        ESP_ERROR_CHECK(eeprom_write(i, erased, pageSize - (i % pageSize)));
+
+    eepromPageClears += size / pageSize;
+    eepromBytesWritten += size - HISTORY_FIRST_ADDRESS;
+}
+
+static uint32_t eeprom_zone_base(int zone)
+{
+    return HISTORY_FIRST_ADDRESS + zone * eepromPartition;
+}
+
+/* rows at the end of the columns the deltas of that many timed records take */
+static uint32_t eeprom_tail_rows(uint32_t timed)
+{
+    return (timed * EEPROM_DELTA_SIZE + ZONE_COUNT - 1) / ZONE_COUNT;
+}
+
+/* byte of the delta stream, from the last row of every column down */
+static uint32_t eeprom_tail_address(uint32_t byte)
+{
+    return eeprom_zone_base(byte % ZONE_COUNT) + eepromPartition - 1 - byte / ZONE_COUNT;
+}
+
+static bool eeprom_timed(uint8_t sample)
+{
+    return sample >= EEPROM_TIMED_FLAG && sample <= EEPROM_TIMED_NO_SAMPLE;
+}
+
+/*---------------------------------------------------------------
+        SPI Clock
+---------------------------------------------------------------*/
+void eeprom_clock_stats(int *clkSpeedHz, uint32_t *downshifts)
+{
+    *clkSpeedHz = eeprom.devices[0].clkSpeedHz;
+    *downshifts = eepromDownshifts;
+}
+
+static void eeprom_clock_init(void)
+{
+    int clkSpeedHz = appConfig->eepromClockKhz * 1000;
+
+    /* a first boot, 'config set eeprom_khz 0' or a part rated lower than the stored clock runs the sweep */
+    if (clkSpeedHz == 0 || clkSpeedHz > eeprom.devices[0].desc->maxClockHz)
     {
-        ESP_ERROR_CHECK(spi_25LC040_write_page(devHandle, i, (uint8_t *)zeros, 16));
+        esp_err_t err = spi_25xx_stripe_characterize(&eeprom, eepromScratch, &clkSpeedHz);
+        if (err != ESP_OK)
+        {
+            /* nothing stored, the next boot tries again */
+            ESP_LOGE(TAG, "SPI clock characterization failed: %s", esp_err_to_name(err));
+            clkSpeedHz = SPI_CLK_SPEED_HZ;
+        }
+        else
+        {
+            config_set(CFG_EEPROM_CLOCK, clkSpeedHz / 1000);
+        }
     }
-}
\ No newline at end of file
+
+    ESP_ERROR_CHECK(spi_25xx_stripe_set_clock(&eeprom, clkSpeedHz));
+    ESP_LOGI(TAG, "SPI clock %d kHz", clkSpeedHz / 1000);
+}
+
+/* a mismatched read-back or a status that never clears retries one clock step lower, persisted for the next boot */
+static bool eeprom_downshift(esp_err_t err)
+{
+    int clkSpeedHz = spi_25xx_clock_below(eeprom.devices[0].clkSpeedHz);
+
+    if (clkSpeedHz == 0 || (err != ESP_ERR_INVALID_CRC && err != ESP_ERR_TIMEOUT))
+        return false;
+
+    ESP_LOGW(TAG, "%s at %d kHz, down to %d kHz", esp_err_to_name(err), eeprom.devices[0].clkSpeedHz / 1000, clkSpeedHz / 1000);
+    ESP_ERROR_CHECK(spi_25xx_stripe_set_clock(&eeprom, clkSpeedHz));
+    config_set(CFG_EEPROM_CLOCK, clkSpeedHz / 1000);
+    eepromDownshifts++;
+
+    return true;
+}
+
+static esp_err_t eeprom_read(uint32_t address, uint8_t *pBuffer, uint32_t size)
+{
+    esp_err_t err;
+
+    do
+        err = spi_25xx_stripe_read(&eeprom, address, pBuffer, size);
+    while (err != ESP_OK && eeprom_downshift(err));
+
+    return err;
+}
+
+/* every write is read back before the log moves on */
+static esp_err_t eeprom_write(uint32_t address, const uint8_t *pBuffer, uint32_t size)
+{
+    esp_err_t err;
+
+    do
+    {
+        err = spi_25xx_stripe_write(&eeprom, address, pBuffer, size);
+        if (err == ESP_OK)
+            err = spi_25xx_stripe_verify(&eeprom, address, pBuffer, size);
+    } while (err != ESP_OK && eeprom_downshift(err));
+
+    return err;
+}
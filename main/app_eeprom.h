@@ -1,22 +1,49 @@
-#include "spi_25LC040A_eeprom.h"
+#include "spi_25xx_eeprom.h"
+
+#include "app_storage.h"
 
 #define SPI_MASTER_HOST SPI3_HOST
-#define SPI_CS_IO 16
+#define SPI_CS_IOS {16, 4, 14, 15} // one chip-select per EEPROM, the first EEPROM_COUNT are used
 #define SPI_SCK_IO 17
 #define SPI_MOSI_IO 5
 #define SPI_MISO_IO 18
-#define SPI_CLK_SPEED_HZ 1000000
+#define SPI_CLK_SPEED_HZ 1000000 // bring-up clock until the characterized one is applied
+#define EEPROM_PART SPI_25LC040 // part fitted on the board, sizes come from its descriptor
+#ifndef EEPROM_COUNT
+#define EEPROM_COUNT 1 // identical parts striped page by page, two or more overlap their write cycles
+#endif
+
+#define HISTORY_FIRST_ADDRESS 8 // after the header
+#define EEPROM_LOG_MAGIC 0x5443 // "CT", older logs keep a delta per record or overlap the scratch pages
+#define EEPROM_DELTA_SIZE 2
+#define EEPROM_TIME_SLACK_S 2      // a record this close to one period after the previous one carries no time
+#define EEPROM_TIMED_SLOTS 128     // deltas of timed records kept in RAM, the log starts over when they run out
+#define EEPROM_TIMED_FLAG 0x80     // zone 0 byte of a timed record, samples only use 7 bits
+#define EEPROM_TIMED_NO_SAMPLE 0xFD // zone 0 byte of a timed STORAGE_NO_SAMPLE marker
+#define EEPROM_ENDURANCE 1000000
+
+/*
+ * The space after the header is split evenly between one column per zone,
+ * so a zone's samples are read in one transfer. Records are dated on a grid
+ * of GPTIMER_PERIOD_S from the previous one. A record off that grid, after
+ * a gap, a clock step or an extra sample, is timed: its zone 0 byte carries
+ * EEPROM_TIMED_FLAG and its uint16 delta in seconds goes to a stream that
+ * grows down from the end of the columns, one row of every column per
+ * ZONE_COUNT bytes. The last page of every chip is kept as scratch for the
+ * SPI clock characterization.
+ */
+struct eeprom_header_t
+{
+    uint32_t timestamp; // time the first record's delta counts from
+    uint16_t magic;
+    uint8_t zones;
+    uint8_t reserved;
+};
+typedef struct eeprom_header_t eeprom_header_t;
 
-#define MEASUREMENTS_PER_HOUR 20 //  every 3 minutes
-#define MEASUREMENTS_PER_DAY (MEASUREMENTS_PER_HOUR * 24)
-#define TOTAL_ADDRESSES (MEASUREMENTS_PER_DAY + 8)
+/* history backend on the external EEPROM */
+extern const storage_backend_t storageEeprom;
 
-void eeprom_init(spi_device_handle_t *devHandle);
-void eeprom_deinit(spi_device_handle_t devHandle);
-void eeprom_write_timestamp(spi_device_handle_t devHandle, uint64_t timestamp);
-int eeprom_read_timestamp(spi_device_handle_t devHandle, uint64_t *timestamp);
-int eeprom_write_moisture(spi_device_handle_t devHandle, uint8_t moisture);
-int eeprom_read_moisture(spi_device_handle_t devHandle, uint16_t address, uint8_t *moisture);
-int eeprom_read_moisture_timestamp(spi_device_handle_t devHandle, uint16_t address, uint16_t *timestamp);
-int eeprom_read_last_moisture(spi_device_handle_t devHandle, uint8_t *moisture);
-void eeprom_clean_moisture_readings(spi_device_handle_t devHandle);
\ No newline at end of file
+void eeprom_init(void);
+void eeprom_deinit(void);
+void eeprom_clock_stats(int *clkSpeedHz, uint32_t *downshifts);
@@ -0,0 +1,250 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "esp_log.h"
+#include "mbedtls/base64.h"
+
+#include "app_gptimer.h"
+#include "app_export.h"
+#include "app_storage.h"
+#include "app_zones.h"
+
+struct export_base64_ctx_t
+{
+    char *out;
+    size_t size;
+    size_t used;
+    bool overflow;
+};
+typedef struct export_base64_ctx_t export_base64_ctx_t;
+
+struct export_stream_t
+{
+    export_sink_t sink;
+    void *ctx;
+    size_t used;
+    uint16_t crc;
+    int streamed;
+};
+typedef struct export_stream_t export_stream_t;
+
+static void export_put(export_stream_t *stream, const void *data, size_t len);
+static void export_flush(export_stream_t *stream);
+static uint16_t export_crc16(uint16_t crc, const uint8_t *data, size_t len);
+static void export_console_sink(const uint8_t *data, size_t len, void *ctx);
+static void export_base64_sink(const uint8_t *data, size_t len, void *ctx);
+
+static uint8_t chunk[EXPORT_CHUNK_SIZE];
+
+static const char *TAG = "ASE-PROJECT-EXPORT";
+
+_Static_assert(GPTIMER_PERIOD_S <= UINT16_MAX, "interval_s is 16 bit in the export frame");
+
+/*---------------------------------------------------------------
+        History Export
+---------------------------------------------------------------*/
+int export_history(export_sink_t sink, void *ctx, uint64_t since, uint32_t maxRecords)
+{
+    storage_snapshot_t snap;
+    storage_snapshot(&snap);
+
+    export_stream_t stream = {
+        .sink = sink,
+        .ctx = ctx,
+        .used = 0,
+        .crc = 0xFFFF,
+        .streamed = 0,
+    };
+    uint64_t times[STORAGE_TIME_CHUNK];
+    uint32_t records = snap.count;
+    uint16_t interval = GPTIMER_PERIOD_S;
+    uint32_t magic = EXPORT_MAGIC;
+
+    /* the most recent window that fits, the frame count is 16 bit */
+    if (maxRecords > UINT16_MAX)
+        maxRecords = UINT16_MAX;
+    uint32_t first = records - (records < maxRecords ? records : maxRecords);
+
+    /* a time range starts at its first record, found from the keyframe index */
+    if (since != 0)
+    {
+        int seek = storage_seek(&snap, since);
+        if (seek < 0)
+        {
+            ESP_LOGW(TAG, "history moved during export");
+            return -1;
+        }
+        if ((uint32_t)seek > first)
+            first = seek;
+    }
+
+    uint16_t total = records - first;
+    uint64_t timestamp = 0;
+    if (total > 0 && storage_read_times(&snap, first, &timestamp, 1) != 1)
+        return -1;
+
+    memcpy(&chunk[0], &magic, 4);
+    chunk[4] = EXPORT_VERSION;
+    chunk[5] = ZONE_COUNT;
+    memcpy(&chunk[6], &interval, 2);
+    memcpy(&chunk[8], &timestamp, 8);
+    memcpy(&chunk[16], &total, 2);
+    stream.used = EXPORT_HEADER_SIZE;
+
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+    {
+        uint16_t address = 0;
+
+        /* samples go straight from the storage backend into the chunk buffer */
+        while (address < total)
+        {
+            uint16_t room = sizeof(chunk) - stream.used;
+            int read = storage_read(&snap, zone, first + address, &chunk[stream.used], room < total - address ? room : total - address);
+            if (read <= 0)
+                break;
+
+            address += read;
+            stream.used += read;
+
+            if (stream.used == sizeof(chunk))
+                export_flush(&stream);
+        }
+
+        /* a short read means the log changed under us, keep the frame consistent */
+        if (address != total)
+        {
+            ESP_LOGW(TAG, "zone %d history moved during export (%u of %u samples)", zone, address, total);
+            return -1;
+        }
+    }
+
+    /* deltas between the exported records, so the frame does not depend on the log's first record */
+    uint64_t previous = timestamp;
+    for (uint16_t address = 0; address < total;)
+    {
+        int read = storage_read_times(&snap, first + address, times, total - address < STORAGE_TIME_CHUNK ? total - address : STORAGE_TIME_CHUNK);
+        if (read <= 0)
+        {
+            ESP_LOGW(TAG, "history times moved during export (%u of %u records)", address, total);
+            return -1;
+        }
+
+        for (int i = 0; i < read; i++, address++)
+        {
+            uint16_t delta = times[i] - previous;
+
+            export_put(&stream, &delta, EXPORT_DELTA_SIZE);
+            previous = times[i];
+        }
+    }
+
+    /* the last chunk is the only one that may need padding */
+    if (stream.used + EXPORT_CRC_SIZE > sizeof(chunk))
+        export_flush(&stream);
+
+    stream.crc = export_crc16(stream.crc, chunk, stream.used);
+    memcpy(&chunk[stream.used], &stream.crc, EXPORT_CRC_SIZE);
+    stream.used += EXPORT_CRC_SIZE;
+
+    sink(chunk, stream.used, ctx);
+    stream.streamed += stream.used;
+
+    return stream.streamed;
+}
+
+int export_history_to_console(uint64_t since)
+{
+    printf("EXPORT-BEGIN\n");
+    int len = export_history(export_console_sink, NULL, since, UINT16_MAX);
+    printf("EXPORT-END %d\n", len);
+
+    return len;
+}
+
+int export_history_to_base64(char *out, size_t size)
+{
+    export_base64_ctx_t ctx = {
+        .out = out,
+        .size = size,
+        .used = 0,
+        .overflow = false,
+    };
+
+    out[0] = '\0';
+
+    int len = export_history(export_base64_sink, &ctx, 0, EXPORT_MAX_PAYLOAD / (ZONE_COUNT + EXPORT_DELTA_SIZE));
+    if (len < 0 || ctx.overflow)
+        return -1;
+
+    return ctx.used;
+}
+
+static void export_put(export_stream_t *stream, const void *data, size_t len)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    /* fields may straddle two chunks, the frame is a byte stream */
+    for (size_t i = 0; i < len; i++)
+    {
+        chunk[stream->used++] = bytes[i];
+        if (stream->used == sizeof(chunk))
+            export_flush(stream);
+    }
+}
+
+static void export_flush(export_stream_t *stream)
+{
+    /* whole base64 groups only, padding mid-stream would end the decoded frame there; the rest starts the next chunk */
+    size_t len = stream->used - stream->used % 3;
+
+    stream->crc = export_crc16(stream->crc, chunk, len);
+    stream->sink(chunk, len, stream->ctx);
+    stream->streamed += len;
+    stream->used -= len;
+    memmove(chunk, &chunk[len], stream->used);
+}
+
+/*---------------------------------------------------------------
+        Export Sinks
+---------------------------------------------------------------*/
+static void export_console_sink(const uint8_t *data, size_t len, void *ctx)
+{
+    char line[EXPORT_B64_CHUNK_SIZE];
+    size_t olen;
+
+    if (mbedtls_base64_encode((unsigned char *)line, sizeof(line), &olen, data, len) == 0)
+        printf("EXPORT:%s\n", line);
+}
+
+static void export_base64_sink(const uint8_t *data, size_t len, void *ctx)
+{
+    export_base64_ctx_t *b64 = (export_base64_ctx_t *)ctx;
+    size_t olen;
+
+    if (b64->overflow)
+        return;
+
+    if (mbedtls_base64_encode((unsigned char *)&b64->out[b64->used], b64->size - b64->used, &olen, data, len) != 0)
+    {
+        b64->overflow = true;
+        return;
+    }
+
+    b64->used += olen;
+}
+
+/*---------------------------------------------------------------
+        CRC16 (CCITT, poly 0x1021)
+---------------------------------------------------------------*/
+static uint16_t export_crc16(uint16_t crc, const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        crc ^= (uint16_t)data[i] << 8;
+        for (int b = 0; b < 8; b++)
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+
+    return crc;
+}
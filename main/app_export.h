@@ -0,0 +1,33 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+
+/*
+ * Binary history frame, all fields little endian:
+ *   magic (4) | version (1) | zones (1) | interval_s (2) | base_timestamp (8) | count (2)
+ *   samples (zones * count bytes, one moisture percentage each, zone 0 first,
+ *            0xFE/0xFF mark slots without a sample)
+ *   deltas (count uint16, seconds since the previous record, 0 for the first)
+ *   crc16 (2), CRC16 little endian over everything before it
+ * base_timestamp is the time of the first record, interval_s the nominal
+ * sampling period.
+ */
+#define EXPORT_MAGIC 0x48455341 // "ASEH"
+#define EXPORT_VERSION 3 // version 2 had no deltas, records were interval_s apart; version 1 also had a single zone
+#define EXPORT_HEADER_SIZE 18
+#define EXPORT_CRC_SIZE 2
+
+#define EXPORT_CHUNK_SIZE 48 // multiple of 3, so every chunk base64 encodes without padding
+#define EXPORT_B64_CHUNK_SIZE (((EXPORT_CHUNK_SIZE + 2) / 3) * 4 + 1)
+
+#define EXPORT_DELTA_SIZE 2
+#define EXPORT_MAX_PAYLOAD 480 // samples and deltas of a cloud frame, the console takes the whole log
+#define EXPORT_MAX_FRAME_SIZE (EXPORT_HEADER_SIZE + EXPORT_MAX_PAYLOAD + EXPORT_CRC_SIZE)
+#define EXPORT_MAX_B64_SIZE (((EXPORT_MAX_FRAME_SIZE + 2) / 3) * 4 + 1)
+
+typedef void (*export_sink_t)(const uint8_t *chunk, size_t len, void *ctx);
+
+int export_history(export_sink_t sink, void *ctx, uint64_t since, uint32_t maxRecords);
+int export_history_to_console(uint64_t since);
+int export_history_to_base64(char *out, size_t size);
@@ -0,0 +1,313 @@
+#include <string.h>
+
+#include "esp_log.h"
+#include "esp_partition.h"
+
+#include "app_flash_log.h"
+
+static esp_err_t flash_log_open(void);
+static esp_err_t flash_log_recover(void);
+static esp_err_t flash_log_reset(uint64_t timestamp);
+static esp_err_t flash_log_append(const uint8_t samples[ZONE_COUNT], uint64_t timestamp, uint16_t deltaS);
+static int flash_log_read_range(int zone, uint32_t first, uint8_t *samples, uint16_t count);
+static int flash_log_read_deltas(uint32_t first, uint16_t *deltas, uint16_t count);
+static int flash_log_read_field(uint32_t first, uint16_t count, uint8_t offset, uint8_t width, uint8_t *out);
+static esp_err_t flash_log_flush(void);
+static uint32_t flash_log_count(void);
+static uint32_t flash_log_capacity(void);
+static uint64_t flash_log_timestamp(void);
+static void flash_log_wear(uint32_t *bytesWritten, uint32_t *erases);
+static esp_err_t flash_log_start_sector(uint16_t sector, uint32_t seq, uint64_t timestamp);
+static bool flash_log_read_header(uint16_t sector, flash_log_header_t *header);
+
+_Static_assert(sizeof(flash_log_header_t) == FLASH_LOG_HEADER_SIZE, "flash_log_header_t must fill the header");
+
+const storage_backend_t storageFlash = {
+    .name = "flash",
+    .endurance = FLASH_LOG_ENDURANCE,
+    .cyclesPerWrap = 1, // one erase per sector each time the ring goes around
+    .wraps = true,
+    .open = flash_log_open,
+    .recover = flash_log_recover,
+    .reset = flash_log_reset,
+    .append = flash_log_append,
+    .read_range = flash_log_read_range,
+    .read_deltas = flash_log_read_deltas,
+    .flush = flash_log_flush,
+    .count = flash_log_count,
+    .capacity = flash_log_capacity,
+    .timestamp = flash_log_timestamp,
+    .wear = flash_log_wear,
+};
+
+static const esp_partition_t *partition = NULL;
+static uint16_t sectors = 0;
+
+static uint16_t headSector = 0;
+static uint32_t headSeq = 0;
+static uint64_t headTimestamp = 0;
+static uint16_t headRecords = 0; // records in the head sector
+static uint16_t tailSector = 0;
+static uint64_t tailTimestamp = 0;
+static uint16_t usedSectors = 0;
+
+static uint32_t bytesWritten = 0;
+static uint32_t sectorErases = 0;
+
+static const char *TAG = "ASE-PROJECT-FLASHLOG";
+
+/*---------------------------------------------------------------
+        Storage Backend
+---------------------------------------------------------------*/
+static esp_err_t flash_log_open(void)
+{
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, FLASH_LOG_SUBTYPE, FLASH_LOG_PARTITION);
+    if (partition == NULL)
+    {
+        ESP_LOGE(TAG, "no '%s' partition", FLASH_LOG_PARTITION);
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    sectors = partition->size / SPI_FLASH_SEC_SIZE;
+    usedSectors = 0;
+
+    return sectors >= 2 ? ESP_OK : ESP_ERR_INVALID_SIZE;
+}
+
+static esp_err_t flash_log_recover(void)
+{
+    flash_log_header_t header;
+    bool found = false;
+
+    /* the head is the valid sector with the highest sequence number */
+    for (uint16_t sector = 0; sector < sectors; sector++)
+    {
+        if (flash_log_read_header(sector, &header) && (!found || header.seq > headSeq))
+        {
+            found = true;
+            headSector = sector;
+            headSeq = header.seq;
+            headTimestamp = header.timestamp;
+        }
+    }
+
+    if (!found)
+        return ESP_ERR_NOT_FOUND;
+
+    /* walk back while the sequence stays contiguous, the last one is the tail */
+    usedSectors = 1;
+    tailSector = headSector;
+    tailTimestamp = headTimestamp;
+    while (usedSectors < sectors)
+    {
+        uint16_t previous = (tailSector + sectors - 1) % sectors;
+
+        if (!flash_log_read_header(previous, &header) || header.seq != headSeq - usedSectors)
+            break;
+
+        tailSector = previous;
+        tailTimestamp = header.timestamp;
+        usedSectors++;
+    }
+
+    /* records are written in order, binary search for the first erased one */
+    size_t base = (size_t)headSector * SPI_FLASH_SEC_SIZE + FLASH_LOG_HEADER_SIZE;
+    uint16_t low = 0, high = FLASH_LOG_RECORDS_PER_SECTOR;
+    while (low < high)
+    {
+        uint16_t middle = (low + high) / 2;
+        uint8_t first;
+
+        ESP_ERROR_CHECK(esp_partition_read(partition, base + (size_t)middle * FLASH_LOG_RECORD_SIZE, &first, 1));
+        if (first == STORAGE_ERASED)
+            high = middle;
+        else
+            low = middle + 1;
+    }
+    headRecords = low;
+
+    ESP_LOGI(TAG, "recovered %u sectors, head %u (seq %lu, %u records)", usedSectors, headSector,
+             (unsigned long)headSeq, headRecords);
+    return ESP_OK;
+}
+
+static esp_err_t flash_log_reset(uint64_t timestamp)
+{
+    /* start after the old head and skip a sequence number, so the old chain never links to the new one */
+    uint16_t sector = usedSectors > 0 ? (headSector + 1) % sectors : 0;
+    uint32_t seq = usedSectors > 0 ? headSeq + 2 : 1;
+
+    usedSectors = 0;
+    esp_err_t err = flash_log_start_sector(sector, seq, timestamp);
+    if (err == ESP_OK)
+    {
+        tailSector = sector;
+        tailTimestamp = timestamp;
+    }
+
+    return err;
+}
+
+static esp_err_t flash_log_append(const uint8_t samples[ZONE_COUNT], uint64_t timestamp, uint16_t deltaS)
+{
+    uint8_t record[FLASH_LOG_RECORD_SIZE];
+
+    if (usedSectors == 0)
+        return ESP_ERR_INVALID_STATE;
+
+    if (headRecords == FLASH_LOG_RECORDS_PER_SECTOR)
+    {
+        uint16_t next = (headSector + 1) % sectors;
+        flash_log_header_t header;
+
+        /* the ring is full, the oldest sector makes room and the next one dates the log */
+        if (usedSectors == sectors)
+        {
+            usedSectors--;
+            tailSector = (tailSector + 1) % sectors;
+            if (flash_log_read_header(tailSector, &header))
+                tailTimestamp = header.timestamp;
+        }
+
+        /* the new sector counts from the record before this one */
+        esp_err_t err = flash_log_start_sector(next, headSeq + 1, timestamp - deltaS);
+        if (err != ESP_OK)
+            return err;
+    }
+
+    /* one program operation, zone 0 first so an erased first byte still marks the end of the log */
+    memcpy(record, samples, ZONE_COUNT);
+    memcpy(&record[ZONE_COUNT], &deltaS, FLASH_LOG_DELTA_SIZE);
+
+    size_t offset = (size_t)headSector * SPI_FLASH_SEC_SIZE + FLASH_LOG_HEADER_SIZE + (size_t)headRecords * FLASH_LOG_RECORD_SIZE;
+    esp_err_t err = esp_partition_write(partition, offset, record, sizeof(record));
+    if (err != ESP_OK)
+        return err;
+
+    bytesWritten += sizeof(record);
+    headRecords++;
+    return ESP_OK;
+}
+
+static int flash_log_read_range(int zone, uint32_t first, uint8_t *samples, uint16_t count)
+{
+    return flash_log_read_field(first, count, zone, 1, samples);
+}
+
+static int flash_log_read_deltas(uint32_t first, uint16_t *deltas, uint16_t count)
+{
+    /* little endian on both sides */
+    return flash_log_read_field(first, count, ZONE_COUNT, FLASH_LOG_DELTA_SIZE, (uint8_t *)deltas);
+}
+
+static esp_err_t flash_log_flush(void)
+{
+    /* records are programmed as they are appended */
+    return ESP_OK;
+}
+
+static uint32_t flash_log_count(void)
+{
+    return usedSectors > 0 ? (uint32_t)(usedSectors - 1) * FLASH_LOG_RECORDS_PER_SECTOR + headRecords : 0;
+}
+
+static uint32_t flash_log_capacity(void)
+{
+    return (uint32_t)sectors * FLASH_LOG_RECORDS_PER_SECTOR;
+}
+
+static uint64_t flash_log_timestamp(void)
+{
+    return tailTimestamp;
+}
+
+static void flash_log_wear(uint32_t *written, uint32_t *erases)
+{
+    *written = bytesWritten;
+    *erases = sectorErases;
+}
+
+/*---------------------------------------------------------------
+        Record Fields
+---------------------------------------------------------------*/
+static int flash_log_read_field(uint32_t first, uint16_t count, uint8_t offset, uint8_t width, uint8_t *out)
+{
+    static uint8_t chunk[FLASH_LOG_READ_CHUNK];
+    uint32_t total = flash_log_count();
+    uint16_t done = 0;
+
+    if (first >= total)
+        return 0;
+
+    if (count > total - first)
+        count = total - first;
+
+    /* strided by record, records are read in chunks and the field picked out of each */
+    while (done < count)
+    {
+        uint32_t record = first + done;
+        uint16_t sector = (tailSector + record / FLASH_LOG_RECORDS_PER_SECTOR) % sectors;
+        uint16_t index = record % FLASH_LOG_RECORDS_PER_SECTOR;
+        uint16_t run = FLASH_LOG_RECORDS_PER_SECTOR - index;
+
+        if (run > count - done)
+            run = count - done;
+        if (run > sizeof(chunk) / FLASH_LOG_RECORD_SIZE)
+            run = sizeof(chunk) / FLASH_LOG_RECORD_SIZE;
+
+        size_t address = (size_t)sector * SPI_FLASH_SEC_SIZE + FLASH_LOG_HEADER_SIZE + (size_t)index * FLASH_LOG_RECORD_SIZE;
+        if (esp_partition_read(partition, address, chunk, (size_t)run * FLASH_LOG_RECORD_SIZE) != ESP_OK)
+            break;
+
+        for (uint16_t i = 0; i < run; i++)
+            memcpy(&out[(done + i) * width], &chunk[i * FLASH_LOG_RECORD_SIZE + offset], width);
+        done += run;
+    }
+
+    return done;
+}
+
+/*---------------------------------------------------------------
+        Sectors
+---------------------------------------------------------------*/
+static esp_err_t flash_log_start_sector(uint16_t sector, uint32_t seq, uint64_t timestamp)
+{
+    flash_log_header_t header = {
+        .magic = FLASH_LOG_MAGIC,
+        .seq = seq,
+        .timestamp = timestamp,
+        .recordSize = FLASH_LOG_RECORD_SIZE,
+        .zones = ZONE_COUNT,
+    };
+    memset(header.reserved, 0xFF, sizeof(header.reserved));
+
+    esp_err_t err = esp_partition_erase_range(partition, (size_t)sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE);
+    if (err == ESP_OK)
+        err = esp_partition_write(partition, (size_t)sector * SPI_FLASH_SEC_SIZE, &header, sizeof(header));
+
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG, "sector %u: %s", sector, esp_err_to_name(err));
+        return err;
+    }
+
+    sectorErases++;
+    bytesWritten += sizeof(header);
+
+    headSector = sector;
+    headSeq = seq;
+    headTimestamp = timestamp;
+    headRecords = 0;
+    usedSectors++;
+
+    return ESP_OK;
+}
+
+static bool flash_log_read_header(uint16_t sector, flash_log_header_t *header)
+{
+    if (esp_partition_read(partition, (size_t)sector * SPI_FLASH_SEC_SIZE, header, sizeof(*header)) != ESP_OK)
+        return false;
+
+    /* a log written with another zone count or record layout cannot be read back */
+    return header->magic == FLASH_LOG_MAGIC && header->zones == ZONE_COUNT && header->recordSize == FLASH_LOG_RECORD_SIZE;
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include <stdint.h>
+
+#include "app_storage.h"
+
+#define FLASH_LOG_PARTITION "history"
+#define FLASH_LOG_SUBTYPE 0x40 // custom data subtype, see partitions.csv
+#define FLASH_LOG_MAGIC 0x544C5341 // "ASLT", "ASLG" logs had no deltas
+#define FLASH_LOG_HEADER_SIZE 32
+#define FLASH_LOG_DELTA_SIZE 2
+#define FLASH_LOG_RECORD_SIZE (ZONE_COUNT + FLASH_LOG_DELTA_SIZE)
+#define FLASH_LOG_RECORDS_PER_SECTOR ((SPI_FLASH_SEC_SIZE - FLASH_LOG_HEADER_SIZE) / FLASH_LOG_RECORD_SIZE)
+#define FLASH_LOG_READ_CHUNK 256
+#define FLASH_LOG_ENDURANCE 100000
+
+/*
+ * Sector layout: header, then fixed size records of one byte per zone
+ * followed by a uint16 delta in seconds since the previous record. Sectors
+ * are filled in ring order, each header carries a sequence number one above
+ * the previous sector's and the time of the previous sector's last record,
+ * so every sector dates its records without the ones before it.
+ */
+struct flash_log_header_t
+{
+    uint32_t magic;
+    uint32_t seq;        // the highest valid sequence is the head sector
+    uint64_t timestamp;  // time the first record's delta counts from
+    uint16_t recordSize; // bytes per record
+    uint8_t zones;
+    uint8_t reserved[FLASH_LOG_HEADER_SIZE - 19];
+};
+typedef struct flash_log_header_t flash_log_header_t;
+
+/* history backend on a log-structured, sector-aligned data partition */
+extern const storage_backend_t storageFlash;
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "app_jitter.h"
+
+/* upper bound of each bucket in us, the last bucket takes everything above */
+static const int64_t bucketLimits[JITTER_BUCKETS - 1] = {
+    10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000};
+
+static const char *probeNames[JITTER_TOTAL_PROBES] = {
+    [JITTER_SAMPLE_START] = "alarm -> sample start",
+    [JITTER_PUMP_STOP] = "scheduled -> pump stop",
+};
+
+static jitter_stats_t stats[JITTER_TOTAL_PROBES];
+static portMUX_TYPE jitterLock = portMUX_INITIALIZER_UNLOCKED;
+
+/*---------------------------------------------------------------
+        Jitter Recording
+---------------------------------------------------------------*/
+void jitter_stats_add(jitter_stats_t *s, int64_t latency_us)
+{
+    int bucket = 0;
+    while (bucket < JITTER_BUCKETS - 1 && latency_us >= bucketLimits[bucket])
+        bucket++;
+
+    if (s->count == 0 || latency_us < s->min)
+        s->min = latency_us;
+    if (s->count == 0 || latency_us > s->max)
+        s->max = latency_us;
+    s->sum += latency_us;
+    s->count++;
+    s->buckets[bucket]++;
+}
+
+void jitter_record(jitter_probe_t probe, int64_t latency_us)
+{
+    taskENTER_CRITICAL(&jitterLock);
+    jitter_stats_add(&stats[probe], latency_us);
+    taskEXIT_CRITICAL(&jitterLock);
+}
+
+void jitter_reset(void)
+{
+    taskENTER_CRITICAL(&jitterLock);
+    memset(stats, 0, sizeof(stats));
+    taskEXIT_CRITICAL(&jitterLock);
+}
+
+/*---------------------------------------------------------------
+        Jitter Report
+---------------------------------------------------------------*/
+void jitter_print(void)
+{
+    jitter_stats_t copy[JITTER_TOTAL_PROBES];
+
+    taskENTER_CRITICAL(&jitterLock);
+    memcpy(copy, stats, sizeof(copy));
+    taskEXIT_CRITICAL(&jitterLock);
+
+    for (int p = 0; p < JITTER_TOTAL_PROBES; p++)
+        jitter_stats_print(probeNames[p], &copy[p]);
+}
+
+void jitter_stats_print(const char *name, const jitter_stats_t *s)
+{
+    if (s->count == 0)
+    {
+        printf("%s: no samples\n", name);
+        return;
+    }
+
+    printf("%s: n=%lu min=%lldus avg=%lldus max=%lldus\n", name, (unsigned long)s->count,
+           s->min, s->sum / s->count, s->max);
+
+    for (int b = 0; b < JITTER_BUCKETS; b++)
+    {
+        if (s->buckets[b] == 0)
+            continue;
+
+        if (b < JITTER_BUCKETS - 1)
+            printf("  < %6lldus: %lu\n", bucketLimits[b], (unsigned long)s->buckets[b]);
+        else
+            printf("  >=%6lldus: %lu\n", bucketLimits[b - 1], (unsigned long)s->buckets[b]);
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <stdint.h>
+
+#define JITTER_BUCKETS 14
+
+enum jitter_probe_t
+{
+    JITTER_SAMPLE_START, // timer alarm to sensor task start
+    JITTER_PUMP_STOP,    // scheduled to actual pump stop
+    JITTER_TOTAL_PROBES,
+};
+typedef enum jitter_probe_t jitter_probe_t;
+
+/* latency histogram, also kept by other modules under their own lock */
+struct jitter_stats_t
+{
+    uint32_t count;
+    int64_t min;
+    int64_t max;
+    int64_t sum;
+    uint32_t buckets[JITTER_BUCKETS];
+};
+typedef struct jitter_stats_t jitter_stats_t;
+
+void jitter_stats_add(jitter_stats_t *s, int64_t latency_us);
+void jitter_stats_print(const char *name, const jitter_stats_t *s);
+void jitter_record(jitter_probe_t probe, int64_t latency_us);
+void jitter_reset(void);
+void jitter_print(void);
@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "mqtt_client.h"
+
+#include "app_jitter.h"
+#include "app_latency.h"
+#include "app_rmaker.h"
+
+struct latency_probe_t
+{
+    bool open;
+    int8_t zone;
+    uint32_t seq;
+    int64_t stageUs[LATENCY_TOTAL_STAGES];
+};
+typedef struct latency_probe_t latency_probe_t;
+
+static void latency_mqtt_event(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data);
+static void latency_send(esp_mqtt_client_handle_t client, const latency_record_t *record);
+
+/* the stage that ends each command, the pump status is published before the pump turns on */
+static const latency_stage_t lastStage[LATENCY_TOTAL_CMDS] = {
+    [LATENCY_PUMP] = LATENCY_ACTUATE,
+    [LATENCY_READ] = LATENCY_PUBLISH,
+};
+
+static const char *cmdNames[LATENCY_TOTAL_CMDS] = {
+    [LATENCY_PUMP] = "pump",
+    [LATENCY_READ] = "read",
+};
+
+static const char *stageNames[LATENCY_TOTAL_STAGES] = {
+    [LATENCY_RECEIVE] = "receive",
+    [LATENCY_CALLBACK] = "callback",
+    [LATENCY_DISPATCH] = "dispatch",
+    [LATENCY_TASK] = "task",
+    [LATENCY_ACTUATE] = "actuate",
+    [LATENCY_PUBLISH] = "publish",
+};
+
+static latency_probe_t probes[LATENCY_TOTAL_CMDS];
+static jitter_stats_t stats[LATENCY_TOTAL_CMDS][LATENCY_TOTAL_STAGES];
+static uint32_t completed[LATENCY_TOTAL_CMDS];
+static uint32_t lost[LATENCY_TOTAL_CMDS];
+static uint32_t seq = 0;
+static int64_t receiveUs = 0;
+static portMUX_TYPE latencyLock = portMUX_INITIALIZER_UNLOCKED;
+
+/* bench broker session, records are handed over to the serving task through the queue */
+static volatile bool serving = false;
+static volatile int loadPerS = 0;
+static QueueHandle_t doneQueue = NULL;
+static StaticQueue_t doneQueueBuffer;
+static uint8_t doneQueueStorage[LATENCY_QUEUE_LEN * sizeof(latency_record_t)];
+static char remoteTopic[64];
+static char loadTopic[64];
+static char resultTopic[64];
+
+static const char *TAG = "ASE-PROJECT-LATENCY";
+
+/*---------------------------------------------------------------
+        Stage Stamps
+---------------------------------------------------------------*/
+void latency_receive(void)
+{
+    int64_t nowUs = esp_timer_get_time();
+
+    taskENTER_CRITICAL(&latencyLock);
+    receiveUs = nowUs;
+    taskEXIT_CRITICAL(&latencyLock);
+}
+
+void latency_begin(latency_cmd_t cmd, int zone)
+{
+    int64_t nowUs = esp_timer_get_time();
+    latency_probe_t *p = &probes[cmd];
+
+    taskENTER_CRITICAL(&latencyLock);
+
+    if (p->open)
+        lost[cmd]++;
+
+    memset(p->stageUs, 0, sizeof(p->stageUs));
+    p->open = true;
+    p->zone = zone;
+    p->seq = seq++;
+
+    /* the bench broker stamps the message right before handing it to the callback */
+    if (receiveUs != 0 && nowUs - receiveUs < LATENCY_RECEIVE_MAX_US)
+        p->stageUs[LATENCY_RECEIVE] = receiveUs;
+    receiveUs = 0;
+    p->stageUs[LATENCY_CALLBACK] = nowUs;
+
+    taskEXIT_CRITICAL(&latencyLock);
+}
+
+void latency_mark(latency_cmd_t cmd, int zone, latency_stage_t stage)
+{
+    int64_t nowUs = esp_timer_get_time();
+    latency_probe_t *p = &probes[cmd];
+    latency_record_t record;
+    bool done = false;
+
+    taskENTER_CRITICAL(&latencyLock);
+
+    if (p->open && p->stageUs[stage] == 0 &&
+        (zone == LATENCY_ANY_ZONE || p->zone == LATENCY_ANY_ZONE || zone == p->zone))
+    {
+        p->stageUs[stage] = nowUs;
+
+        if (stage == lastStage[cmd])
+        {
+            int64_t startUs = p->stageUs[LATENCY_RECEIVE] != 0 ? p->stageUs[LATENCY_RECEIVE] : p->stageUs[LATENCY_CALLBACK];
+
+            for (int s = 0; s < LATENCY_TOTAL_STAGES; s++)
+                if (p->stageUs[s] != 0)
+                    jitter_stats_add(&stats[cmd][s], p->stageUs[s] - startUs);
+
+            completed[cmd]++;
+            p->open = false;
+
+            record.seq = p->seq;
+            record.cmd = cmd;
+            record.zone = p->zone;
+            memcpy(record.stageUs, p->stageUs, sizeof(record.stageUs));
+            done = true;
+        }
+    }
+
+    taskEXIT_CRITICAL(&latencyLock);
+
+    /* never blocks the control path, a full queue only loses the bench copy */
+    if (done && serving)
+        xQueueSend(doneQueue, &record, 0);
+}
+
+/*---------------------------------------------------------------
+        Latency Report
+---------------------------------------------------------------*/
+void latency_reset(void)
+{
+    taskENTER_CRITICAL(&latencyLock);
+    memset(stats, 0, sizeof(stats));
+    memset(completed, 0, sizeof(completed));
+    memset(lost, 0, sizeof(lost));
+    taskEXIT_CRITICAL(&latencyLock);
+}
+
+void latency_print(void)
+{
+    static jitter_stats_t copy[LATENCY_TOTAL_CMDS][LATENCY_TOTAL_STAGES]; // about 1 KB, kept off the console stack
+    uint32_t copyCompleted[LATENCY_TOTAL_CMDS];
+    uint32_t copyLost[LATENCY_TOTAL_CMDS];
+
+    taskENTER_CRITICAL(&latencyLock);
+    memcpy(copy, stats, sizeof(copy));
+    memcpy(copyCompleted, completed, sizeof(copyCompleted));
+    memcpy(copyLost, lost, sizeof(copyLost));
+    taskEXIT_CRITICAL(&latencyLock);
+
+    for (int c = 0; c < LATENCY_TOTAL_CMDS; c++)
+    {
+        printf("%s: %lu completed, %lu lost\n", cmdNames[c], (unsigned long)copyCompleted[c], (unsigned long)copyLost[c]);
+
+        for (int s = LATENCY_CALLBACK; s < LATENCY_TOTAL_STAGES; s++)
+        {
+            char name[32];
+
+            if (copy[c][s].count == 0)
+                continue;
+
+            snprintf(name, sizeof(name), "  start -> %s", stageNames[s]);
+            jitter_stats_print(name, &copy[c][s]);
+        }
+    }
+}
+
+/*---------------------------------------------------------------
+        Bench Broker
+---------------------------------------------------------------*/
+esp_err_t latency_serve(const char *uri, int seconds, latency_load_fn_t load)
+{
+    const char *nodeId = esp_rmaker_get_node_id();
+
+    if (uri == NULL || uri[0] == '\0' || nodeId == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    /* same topics as the RainMaker node, so the host tool speaks the cloud's format */
+    snprintf(remoteTopic, sizeof(remoteTopic), "node/%s/params/remote", nodeId);
+    snprintf(loadTopic, sizeof(loadTopic), "node/%s/bench/load", nodeId);
+    snprintf(resultTopic, sizeof(resultTopic), "node/%s/bench/latency", nodeId);
+
+    if (doneQueue == NULL)
+        doneQueue = xQueueCreateStatic(LATENCY_QUEUE_LEN, sizeof(latency_record_t), doneQueueStorage, &doneQueueBuffer);
+    xQueueReset(doneQueue);
+
+    esp_mqtt_client_config_t mqttCfg = {
+        .broker.address.uri = uri,
+    };
+    esp_mqtt_client_handle_t client = esp_mqtt_client_init(&mqttCfg);
+    if (client == NULL)
+        return ESP_ERR_NO_MEM;
+
+    esp_mqtt_client_register_event(client, ESP_EVENT_ANY_ID, latency_mqtt_event, client);
+
+    esp_err_t err = esp_mqtt_client_start(client);
+    if (err != ESP_OK)
+    {
+        esp_mqtt_client_destroy(client);
+        return err;
+    }
+
+    ESP_LOGI(TAG, "serving %s on %s for %ds", remoteTopic, uri, seconds);
+
+    loadPerS = 0;
+    serving = true;
+
+    int64_t endUs = esp_timer_get_time() + 1000000LL * seconds;
+    while (esp_timer_get_time() < endUs)
+    {
+        latency_record_t record;
+
+        if (xQueueReceive(doneQueue, &record, pdMS_TO_TICKS(LATENCY_LOAD_SLICE_MS)) == pdTRUE)
+            latency_send(client, &record);
+
+        int reports = loadPerS * LATENCY_LOAD_SLICE_MS / 1000;
+        if (reports > 0 && load != NULL)
+            load(reports);
+    }
+
+    serving = false;
+
+    esp_mqtt_client_stop(client);
+    esp_mqtt_client_destroy(client);
+
+    ESP_LOGI(TAG, "bench broker session ended");
+
+    return ESP_OK;
+}
+
+static void latency_mqtt_event(void *handler_args, esp_event_base_t base, int32_t event_id, void *event_data)
+{
+    esp_mqtt_client_handle_t client = (esp_mqtt_client_handle_t)handler_args;
+    esp_mqtt_event_handle_t event = (esp_mqtt_event_handle_t)event_data;
+
+    if (event_id == MQTT_EVENT_CONNECTED)
+    {
+        esp_mqtt_client_subscribe(client, remoteTopic, 1);
+        esp_mqtt_client_subscribe(client, loadTopic, 1);
+    }
+    else if (event_id == MQTT_EVENT_DATA)
+    {
+        /* commands are a few dozen bytes, a fragmented message is not one of them */
+        if (event->data_len != event->total_data_len)
+            return;
+
+        if (event->topic_len == strlen(remoteTopic) && strncmp(event->topic, remoteTopic, event->topic_len) == 0)
+        {
+            latency_receive();
+            if (rmaker_write_params(event->data, event->data_len, ESP_RMAKER_REQ_SRC_LOCAL) != ESP_OK)
+                ESP_LOGW(TAG, "bench write not applied: %.*s", event->data_len, event->data);
+        }
+        else if (event->topic_len == strlen(loadTopic) && strncmp(event->topic, loadTopic, event->topic_len) == 0)
+        {
+            char value[12];
+            snprintf(value, sizeof(value), "%.*s", event->data_len, event->data);
+            loadPerS = atoi(value);
+            ESP_LOGI(TAG, "background load %d reports/s", loadPerS);
+        }
+    }
+}
+
+static void latency_send(esp_mqtt_client_handle_t client, const latency_record_t *record)
+{
+    char json[160];
+    int64_t startUs = record->stageUs[LATENCY_RECEIVE] != 0 ? record->stageUs[LATENCY_RECEIVE] : record->stageUs[LATENCY_CALLBACK];
+
+    /* stage offsets from the first stamp, -1 for the stages the command skipped */
+    int len = snprintf(json, sizeof(json), "{\"seq\":%lu,\"cmd\":\"%s\",\"zone\":%d,\"us\":[",
+                       (unsigned long)record->seq, cmdNames[record->cmd], record->zone);
+    for (int s = 0; s < LATENCY_TOTAL_STAGES; s++)
+        len += snprintf(json + len, sizeof(json) - len, "%s%lld", s ? "," : "",
+                        record->stageUs[s] != 0 ? record->stageUs[s] - startUs : -1LL);
+    len += snprintf(json + len, sizeof(json) - len, "]}");
+
+    esp_mqtt_client_publish(client, resultTopic, json, len, 1, 0);
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#define LATENCY_ANY_ZONE -1
+#define LATENCY_QUEUE_LEN 8            // completed commands waiting to be sent to the bench broker
+#define LATENCY_RECEIVE_MAX_US 1000000 // a receive stamp older than this belongs to no callback
+#define LATENCY_LOAD_SLICE_MS 100      // the loaded run spreads its reports over slices this long
+
+/*
+ * End-to-end command latency. A RainMaker write opens a probe for its
+ * command, every stage on the way to the pump or the published reading
+ * stamps it, and the last stage closes it into per-stage distributions
+ * measured from the first stamp. One probe per command is open at a time,
+ * a write that arrives before the previous one completed counts it as lost.
+ */
+enum latency_cmd_t
+{
+    LATENCY_PUMP, // "trigger pump" to the pump on
+    LATENCY_READ, // "trigger reading" to the reading published
+    LATENCY_TOTAL_CMDS,
+};
+typedef enum latency_cmd_t latency_cmd_t;
+
+enum latency_stage_t
+{
+    LATENCY_RECEIVE,  // message taken off the bench broker, absent for cloud writes
+    LATENCY_CALLBACK, // device write callback
+    LATENCY_DISPATCH, // main loop picked the action up
+    LATENCY_TASK,     // pump or sensor task started, absent when a reading is shared or cached
+    LATENCY_ACTUATE,  // pwm_set_duty turned the pump on
+    LATENCY_PUBLISH,  // result reported to RainMaker
+    LATENCY_TOTAL_STAGES,
+};
+typedef enum latency_stage_t latency_stage_t;
+
+struct latency_record_t
+{
+    uint32_t seq;
+    uint8_t cmd;
+    int8_t zone;
+    int64_t stageUs[LATENCY_TOTAL_STAGES]; // since boot, 0 for stages the command skipped
+};
+typedef struct latency_record_t latency_record_t;
+
+/* generates background traffic for the loaded runs, called with the reports of one slice */
+typedef void (*latency_load_fn_t)(int reports);
+
+void latency_receive(void);
+void latency_begin(latency_cmd_t cmd, int zone);
+void latency_mark(latency_cmd_t cmd, int zone, latency_stage_t stage);
+void latency_reset(void);
+void latency_print(void);
+esp_err_t latency_serve(const char *uri, int seconds, latency_load_fn_t load);
@@ -1,21 +1,41 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "freertos/timers.h"
 
 #include "soc/soc_caps.h"
 #include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
 #include "esp_netif_sntp.h"
 #include "nvs_flash.h"
 
 #include "app_adc.h"
+#include "app_config.h"
+#include "app_console.h"
+#include "app_deadline.h"
+#include "app_delta.h"
 #include "app_eeprom.h"
+#include "app_export.h"
 #include "app_gptimer.h"
+#include "app_jitter.h"
+#include "app_latency.h"
+#include "app_mem.h"
+#include "app_planner.h"
 #include "app_pwm.h"
 #include "app_rmaker.h"
+#include "app_schedule.h"
+#include "app_storage.h"
+#include "app_storm.h"
+#include "app_tlog.h"
+#include "app_trace.h"
+#include "app_tasks.h"
+#include "app_zones.h"
 
 #define ACTION_AUTO_SENSOR_READ 0x01
 #define ACTION_MANUAL_SENSOR_READ 0x02
@@ -23,66 +43,184 @@
 #define ACTION_MANUAL_WATERING 0x08
 #define ACTION_SET_AUTO_WATERING 0x10
 #define ACTION_HUMIDITY_HISTORY 0x20
+#define ACTION_EXPORT_CONSOLE 0x40
+#define ACTION_EXPORT_CLOUD 0x80
+#define ACTION_REPORT_CONFIG 0x100
+#define ACTION_SCHEDULE 0x200
+#define ACTION_ALARM_SENSOR_READ 0x400
 
 #define SENSOR_AUTO 0x01
 #define SENSOR_MANUAL 0x02
+#define SENSOR_ALARM 0x04
 
 #define WATERING_AUTO 0x01
 #define WATERING_MANUAL 0x02
 
-#define WAIT_AFTER_WATERING_S /*1000 * 60 * 15*/ 1000 * 10
+#define PUMP_STOP_POLL_MS 100 // a stop request reaches a task queued for the supply this fast
+
+#define READ_WAIT_MARGIN_MS 1000 // the main loop may be finishing another action first
+
+#define EXPORT_CONSOLE 0x01
+#define EXPORT_CLOUD 0x02
+
+#define HISTORY_ALL 0
+#define HISTORY_CHUNK 64
 
 static bool timer_on_alarm_cb(gptimer_handle_t timer, const gptimer_alarm_event_data_t *edata, void *user_ctx);
-static esp_err_t auto_watering_write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
-                                        const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx);
-static esp_err_t manual_watering_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
-                                    const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx);
-static esp_err_t current_moisture_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
-                                     const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx);
+static esp_err_t auto_watering_write(int zone, esp_rmaker_param_val_t val);
+static esp_err_t time_watering_write(int zone, esp_rmaker_param_val_t val);
+static esp_err_t trigger_pump_write(int zone, esp_rmaker_param_val_t val);
+static esp_err_t trigger_reading_write(int zone, esp_rmaker_param_val_t val);
+static esp_err_t trigger_export_write(int zone, esp_rmaker_param_val_t val);
+static esp_err_t schedule_rules_write(int zone, esp_rmaker_param_val_t val);
+static schedule_result_t schedule_fire(int rule, const schedule_rule_t *entry, uint32_t lateS);
+static void schedule_wake(void);
+static void moisture_alarm_cb(int zone, BaseType_t *woken);
+static void crossing_sample_cb(TimerHandle_t timer);
+static void crossing_sample_arm(void);
 
 static void sensor_task(void *arg);
 static void pump_task(void *arg);
 static void history_task(void *arg);
-static void get_data_from_terminal_task(void *arg);
+static void export_task(void *arg);
+static void bench_task(void *arg);
+static void ota_task(void *arg);
+static void bench_storage(const storage_backend_t *backend, int iterations);
+static void bench_netload(int reports);
+static void bench_storm_inject(storm_source_t source, int seq);
+static uint32_t bench_storm_check(void);
+static uint8_t pump_run(int zone, uint8_t activeTimeS);
+static bool pump_sleep(int zone, uint32_t ms);
+static bool pump_start(int zone, uint8_t mode);
+static bool sensor_start(int64_t alarmUs);
+
+static void action_post(uint16_t bits);
+static void action_post_from_isr(uint16_t bits, BaseType_t *pxHigherPriorityTaskWoken);
+static void action_clear(uint16_t bits);
+static void manual_watering_post(int zone, uint8_t seconds);
+
+static void console_register_commands(void);
+static int cmd_history(int argc, char **argv);
+static int cmd_export(int argc, char **argv);
+static int cmd_read(int argc, char **argv);
+static int cmd_water(int argc, char **argv);
+static int cmd_auto(int argc, char **argv);
+static int cmd_config(int argc, char **argv);
+static int cmd_calibrate(int argc, char **argv);
+static int cmd_stats(int argc, char **argv);
+static int cmd_bench(int argc, char **argv);
+static int cmd_jitter(int argc, char **argv);
+static int cmd_deadline(int argc, char **argv);
+static int cmd_latency(int argc, char **argv);
+static int cmd_log(int argc, char **argv);
+static int cmd_trace(int argc, char **argv);
+static int cmd_ota(int argc, char **argv);
+static int cmd_mem(int argc, char **argv);
+static int cmd_plan(int argc, char **argv);
+static int cmd_schedule(int argc, char **argv);
+static int cmd_zone_arg(int argc, char **argv, int index);
 
 struct sensor_task_arg_t
 {
-    uint8_t mode;
-    adc_oneshot_unit_handle_t *adcHandle;
-    spi_device_handle_t *spiHandle;
-    uint8_t *moisture;
+    adc_continuous_handle_t *adcHandle;
+    int64_t alarmUs;
 };
 typedef struct sensor_task_arg_t sensor_task_arg_t;
 
 struct pump_task_arg_t
 {
+    int zone;
     uint8_t mode;
-    spi_device_handle_t *spiHandle;
     uint8_t activeTimeS;
 };
 typedef struct pump_task_arg_t pump_task_arg_t;
 
 struct history_task_arg_t
 {
-    spi_device_handle_t *spiHandle;
-    uint8_t moistures[TOTAL_ADDRESSES];
-    uint8_t total;
-    uint64_t timestamp;
+    int zone;
+    uint8_t moistures[HISTORY_CHUNK];
+    uint64_t times[HISTORY_CHUNK];
+    uint32_t total;
+    uint16_t last;
+    uint64_t since; // epoch seconds, 0 for no lower bound
+    int64_t dueUs;
 };
 typedef struct history_task_arg_t history_task_arg_t;
 
+struct export_task_arg_t
+{
+    uint8_t target;
+    uint64_t since; // console export only
+    int64_t dueUs;
+};
+typedef struct export_task_arg_t export_task_arg_t;
+
+struct bench_task_arg_t
+{
+    char name[16];
+    int iterations;
+};
+typedef struct bench_task_arg_t bench_task_arg_t;
+
 TaskHandle_t mainTaskHandle = NULL;
 TaskHandle_t sensorTaskHandle = NULL;
-TaskHandle_t pumpTaskHandle = NULL;
+TaskHandle_t pumpTaskHandle[ZONE_COUNT];
 TaskHandle_t historyTaskHandle = NULL;
-TaskHandle_t getDataFromTerminalTask = NULL;
+TaskHandle_t exportTaskHandle = NULL;
+TaskHandle_t benchTaskHandle = NULL;
+TaskHandle_t otaTaskHandle = NULL;
+
+static uint16_t action = ACTION_AUTO_SENSOR_READ;
+static portMUX_TYPE actionLock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t manualZones = 0; // zones with a pending manual watering, under actionLock
+static uint8_t pumpTasksAlive[ZONE_COUNT]; // pump tasks between start and delete, under actionLock
+static volatile bool pumpStop[ZONE_COUNT]; // main loop asks the zone's pump task to end early, under actionLock
+static uint8_t alarmZones = 0; // zones whose moisture monitor fired, under actionLock
+static uint8_t forcedTimeWatering[ZONE_COUNT];
+static uint16_t historyLast = HISTORY_ALL;
+static int historyZone = 0;
+static uint64_t historySince = 0;
+static uint64_t exportSince = 0;
+static bool watering[ZONE_COUNT];
+
+static adc_continuous_handle_t adcHandle;
+
+static uint32_t pumpRuns[ZONE_COUNT];
+static uint8_t lastMoisture[ZONE_COUNT];
+static volatile int64_t alarmUs = 0;
+static volatile int64_t tickUs = 0; // last periodic alarm, the next one is a period later
+
+/* task arguments outlive app_main's stack frame, they are part of the static plan */
+static sensor_task_arg_t sensorTaskArg;
+static pump_task_arg_t pumpTaskArg[ZONE_COUNT];
+static history_task_arg_t historyTaskArg;
+static export_task_arg_t exportTaskArg;
+static bench_task_arg_t benchTaskArg;
+static char otaUrl[128];
+static char latencyUri[128];
+
+static char exportFrame[EXPORT_MAX_B64_SIZE];
+static char scheduleText[SCHEDULE_TEXT_SIZE];
+
+/* by bit of the main loop actions, for the storm benchmark */
+static const char *const actionNames[STORM_ACTION_BITS] = {
+    "auto read", "manual read", "auto watering", "manual watering", "set auto", "history", "export console", "export cloud", "report config", "schedule", "alarm read",
+};
 
-static uint8_t action = ACTION_AUTO_SENSOR_READ;
-static bool autoWateringEn = false;
-static uint8_t timeWatering = 5;
-static bool watering = false;
+/* parameters the app accepts writes for, the others are read-only in the app */
+static const rmaker_handler_t rmakerHandlers[] = {
+    {RMAKER_PARAM_AUTO_WATERING, RMAKER_VAL_TYPE_BOOLEAN, auto_watering_write},
+    {RMAKER_PARAM_TIME_WATERING, RMAKER_VAL_TYPE_INTEGER, time_watering_write},
+    {RMAKER_PARAM_TRIGGER_PUMP, RMAKER_VAL_TYPE_BOOLEAN, trigger_pump_write},
+    {RMAKER_PARAM_TRIGGER_READING, RMAKER_VAL_TYPE_BOOLEAN, trigger_reading_write},
+    {RMAKER_PARAM_TRIGGER_EXPORT, RMAKER_VAL_TYPE_BOOLEAN, trigger_export_write},
+    {RMAKER_PARAM_SCHEDULE, RMAKER_VAL_TYPE_STRING, schedule_rules_write},
+};
 
 SemaphoreHandle_t xSemaphore = NULL;
+static StaticSemaphore_t xSemaphoreBuffer;
+static TimerHandle_t crossingTimer = NULL;
+static StaticTimer_t crossingTimerBuffer;
 
 static const char *TAG = "ASE-PROJECT";
 
@@ -98,44 +236,72 @@ void app_main(void)
     }
     ESP_ERROR_CHECK(err);
 
+    /* dump the flight recorder of the previous boot before anything else records */
+    trace_init();
+
+    /* task slots of the static memory plan, before the first task starts */
+    mem_init();
+
+    /* control path logging goes through the token ring from here on */
+    tlog_init();
+
+    /* Zone pin map and history partitions, then the configuration that tunes them */
+    zones_init();
+    config_init();
+    planner_init();
+    schedule_init();
+
     /* Init rainmaker */
-    rmaker_init(auto_watering_write_cb, current_moisture_cb, manual_watering_cb);
+    rmaker_init(rmakerHandlers, sizeof(rmakerHandlers) / sizeof(rmakerHandlers[0]));
+    trace_report();
 
     mainTaskHandle = xTaskGetCurrentTaskHandle();
 
-    xSemaphore = xSemaphoreCreateBinary();
+    xSemaphore = xSemaphoreCreateBinaryStatic(&xSemaphoreBuffer);
 
     /* create gptimer */
     gptimer_handle_t gptimer = NULL;
     gptimer_create(&gptimer, timer_on_alarm_cb);
 
+    /* extra samples ahead of a predicted crossing, between the periodic ones */
+    crossingTimer = xTimerCreateStatic("Crossing_Sample", 1, pdFALSE, NULL, crossing_sample_cb, &crossingTimerBuffer);
+
+    /* watering rules fire from the main loop on the node's own clock */
+    schedule_start(schedule_wake);
+
     /* Init ADC2 */
-    adc_oneshot_unit_handle_t adcHandle;
     adc_cali_handle_t adcCaliHandle;
     bool doCalibration;
     adc_init(&adcHandle, &adcCaliHandle, &doCalibration);
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+        adc_set_calibration(zone, appConfig->sensorDryRaw[zone], appConfig->sensorWetRaw[zone]);
+    adc_set_settle(appConfig->sensorSettleMs);
+    adc_alarm_init(&adcHandle, moisture_alarm_cb);
 
     /* Init pwm */
     pwm_init();
 
     /* Init eeprom */
-    spi_device_handle_t spiHandle;
-    eeprom_init(&spiHandle);
+    eeprom_init();
 
+    /* Open the history log, it continues across reboots when the backend still holds it */
     uint64_t now = time(NULL);
-    eeprom_write_timestamp(spiHandle, now);
+    storage_init(appConfig->storage, now, GPTIMER_PERIOD_S);
 
-    xTaskCreate(get_data_from_terminal_task, "Data_From_Terminal_Task", 1024, NULL, 5, &getDataFromTerminalTask);
+    /* Init console */
+    console_init();
+    console_register_commands();
+    console_start();
 
-    sensor_task_arg_t sensorTaskArg;
     sensorTaskArg.adcHandle = &adcHandle;
-    sensorTaskArg.spiHandle = &spiHandle;
 
-    pump_task_arg_t pumpTaskArg;
-    pumpTaskArg.spiHandle = &spiHandle;
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+        pumpTaskArg[zone].zone = zone;
 
-    history_task_arg_t historyTaskArg;
-    historyTaskArg.spiHandle = &spiHandle;
+    /* the main loop is the control path, run it above the app-level network tasks */
+    if (xPortGetCoreID() != TASK_CORE_CONTROL)
+        ESP_LOGW(TAG, "main task runs on core %d, expected %d (check CONFIG_ESP_MAIN_TASK_AFFINITY)", xPortGetCoreID(), TASK_CORE_CONTROL);
+    vTaskPrioritySet(NULL, TASK_PRIO_CONTROL);
 
     /* run once to get first sensor read */
     xSemaphoreGive(xSemaphore);
@@ -144,93 +310,220 @@ void app_main(void)
     {
         if (xSemaphoreTake(xSemaphore, pdMS_TO_TICKS(1000 * 60 * 4)) == pdTRUE)
         {
+            trace_record(TRACE_ACTION, 0, action);
+            storm_wake(action);
 
             if (action & ACTION_AUTO_SENSOR_READ) // update moisture history and current moisture
             {
-                sensorTaskArg.mode = SENSOR_AUTO;
+                /* a reading already in flight is shared, it will also be stored */
+                if (!adc_reading_request(SENSOR_AUTO) || sensor_start(alarmUs))
+                {
+                    alarmUs = 0;
+
+                    action_clear(ACTION_AUTO_SENSOR_READ);
+                }
+            }
+
+            if (action & ACTION_MANUAL_SENSOR_READ) // get current moisture
+            {
+                adc_reading_t readings[ZONE_COUNT];
+                bool started = true;
 
-                xTaskCreate(sensor_task, "Sensor_Task", 8192, &sensorTaskArg, 5, &sensorTaskHandle);
+                latency_mark(LATENCY_READ, LATENCY_ANY_ZONE, LATENCY_DISPATCH);
 
-                action &= ~ACTION_AUTO_SENSOR_READ;
+                if (adc_reading_get_fresh(1000 * appConfig->readFreshnessS, readings))
+                {
+                    for (int zone = 0; zone < ZONE_COUNT && deadline_admit(DEADLINE_REPORT); zone++)
+                    {
+                        int64_t dueUs = deadline_due(DEADLINE_REPORT, esp_timer_get_time());
+
+                        TLOG(TLOG_MANUAL_READ_CACHED, zone, readings[zone].percentage);
+                        rmaker_update_moisture(zone, readings[zone].percentage);
+                        latency_mark(LATENCY_READ, zone, LATENCY_PUBLISH);
+                        deadline_done(DEADLINE_REPORT, dueUs);
+                    }
+                }
+                else if (adc_reading_request(SENSOR_MANUAL))
+                {
+                    started = sensor_start(0);
+                }
+
+                if (started) // otherwise retried on a later pass
+                    action_clear(ACTION_MANUAL_SENSOR_READ);
             }
-            else if (action & ACTION_MANUAL_SENSOR_READ) // get current moisture
+
+            if (action & ACTION_ALARM_SENSOR_READ) // a moisture monitor crossed its threshold, confirm it with a full reading
             {
-                uint8_t moisture;
+                uint8_t zones;
 
-                sensorTaskArg.mode = SENSOR_MANUAL;
-                sensorTaskArg.moisture = &moisture;
+                taskENTER_CRITICAL(&actionLock);
+                zones = alarmZones;
+                alarmZones = 0;
+                taskEXIT_CRITICAL(&actionLock);
 
-                xTaskCreate(sensor_task, "Sensor_Task", 8192, &sensorTaskArg, 8, &sensorTaskHandle);
+                for (int zone = 0; zone < ZONE_COUNT; zone++)
+                    if (zones & (1 << zone))
+                        TLOG(TLOG_SENSOR_ALARM, zone);
 
-                action &= ~ACTION_MANUAL_SENSOR_READ;
+                if (!adc_reading_request(SENSOR_ALARM) || sensor_start(0))
+                    action_clear(ACTION_ALARM_SENSOR_READ);
             }
 
             if (action & ACTION_SET_AUTO_WATERING) // enable/disable auto watering
             {
-                rmaker_update_auto_watering(autoWateringEn);
+                /* the echo to the cloud is the only part that waits for the network, under overload it joins the config report */
+                bool report = deadline_admit(DEADLINE_STATUS);
+                if (!report)
+                    action_post(ACTION_REPORT_CONFIG);
 
-                ESP_LOGI(TAG, "AUTO_WATERING SET TO %s", autoWateringEn ? "true" : "false");
+                for (int zone = 0; zone < ZONE_COUNT; zone++)
+                {
+                    if (report)
+                    {
+                        int64_t dueUs = deadline_due(DEADLINE_STATUS, esp_timer_get_time());
+                        rmaker_update_auto_watering(zone, appConfig->autoWatering[zone]);
+                        deadline_done(DEADLINE_STATUS, dueUs);
+                    }
+
+                    TLOG(TLOG_AUTO_WATERING_SET, zone, appConfig->autoWatering[zone]);
+
+                    /* a planning pump task may sleep for long, let it see the change now */
+                    if (pumpTaskHandle[zone] != NULL)
+                        xTaskNotifyGive(pumpTaskHandle[zone]);
+                }
+
+                action_clear(ACTION_SET_AUTO_WATERING);
+            }
+
+            if (action & ACTION_SCHEDULE) // start the scheduled runs that are due
+            {
+                /* cleared first, the timer re-armed by the run may fire before it returns */
+                action_clear(ACTION_SCHEDULE);
 
-                action &= ~ACTION_SET_AUTO_WATERING;
+                schedule_run(schedule_fire);
             }
 
             if (action & ACTION_AUTO_WATERING) // auto watering
             {
-                if (pumpTaskHandle == NULL && autoWateringEn)
+                for (int zone = 0; zone < ZONE_COUNT; zone++)
                 {
-                    ESP_LOGI(TAG, "ENTERING AUTO_WATERING. ENABLED = %s", autoWateringEn ? "true" : "false");
-
-                    pumpTaskArg.mode = WATERING_AUTO;
+                    if (pumpTaskHandle[zone] == NULL && appConfig->autoWatering[zone])
+                    {
+                        TLOG(TLOG_AUTO_WATERING_ENTER, zone);
 
-                    xTaskCreate(pump_task, "Pump_Task", 8192, &pumpTaskArg, 5, &pumpTaskHandle);
+                        pump_start(zone, WATERING_AUTO); // a zone that could not start is picked up by the next pass
+                    }
                 }
 
-                action &= ~ACTION_AUTO_WATERING;
+                action_clear(ACTION_AUTO_WATERING);
             }
             else if (action & ACTION_MANUAL_WATERING) // manual watering
             {
-                ESP_LOGI(TAG, "ENTERING MANUAL_WATERING");
+                uint8_t zones;
 
-                if (pumpTaskHandle != NULL)
-                    vTaskDelete(pumpTaskHandle);
+                taskENTER_CRITICAL(&actionLock);
+                zones = manualZones;
+                manualZones = 0;
+                action &= ~ACTION_MANUAL_WATERING;
+                storm_dispatched(ACTION_MANUAL_WATERING);
+                taskEXIT_CRITICAL(&actionLock);
 
-                pumpTaskArg.mode = WATERING_MANUAL;
-                pumpTaskArg.activeTimeS = timeWatering;
+                bool retry = false;
 
-                xTaskCreate(pump_task, "Pump_Task", 8192, &pumpTaskArg, 8, &pumpTaskHandle);
+                for (int zone = 0; zone < ZONE_COUNT; zone++)
+                {
+                    if (!(zones & (1 << zone)))
+                        continue;
+
+                    TLOG(TLOG_MANUAL_WATERING_ENTER, zone);
+                    latency_mark(LATENCY_PUMP, zone, LATENCY_DISPATCH);
+
+                    /* a running cycle ends itself, releasing its supply token and status; the request waits for it */
+                    TaskHandle_t running;
+
+                    taskENTER_CRITICAL(&actionLock);
+                    running = pumpTaskHandle[zone];
+                    if (running != NULL)
+                    {
+                        pumpStop[zone] = true;
+                        manualZones |= 1 << zone;
+                    }
+                    taskEXIT_CRITICAL(&actionLock);
+
+                    if (running != NULL)
+                    {
+                        xTaskNotifyGive(running);
+                        continue;
+                    }
+
+                    pumpTaskArg[zone].activeTimeS = forcedTimeWatering[zone] ? forcedTimeWatering[zone] : appConfig->timeWatering[zone];
+
+                    if (pump_start(zone, WATERING_MANUAL))
+                    {
+                        forcedTimeWatering[zone] = 0;
+                    }
+                    else
+                    {
+                        /* the slot is still being released, keep the request for the next pass */
+                        taskENTER_CRITICAL(&actionLock);
+                        manualZones |= 1 << zone;
+                        taskEXIT_CRITICAL(&actionLock);
+                        retry = true;
+                    }
+                }
 
-                action &= ~ACTION_MANUAL_WATERING;
+                if (retry)
+                    action_post(ACTION_MANUAL_WATERING);
             }
 
             if (action & ACTION_HUMIDITY_HISTORY) // check moisture history
             {
-                uint8_t *moistures;
-                uint8_t total;
-
-                xTaskCreate(history_task, "History_Task", 8192, &historyTaskArg, 8, &historyTaskHandle);
+                /* the task reads and prints on its own, the loop never waits for it; shed requests wait for a later pass */
+                if (historyTaskHandle == NULL && deadline_admit(DEADLINE_HISTORY))
+                {
+                    historyTaskArg.last = historyLast;
+                    historyTaskArg.zone = historyZone;
+                    historyTaskArg.since = historySince;
+                    historyTaskArg.dueUs = deadline_due(DEADLINE_HISTORY, esp_timer_get_time());
 
-                action &= ~ACTION_HUMIDITY_HISTORY;
+                    if (mem_task_start(MEM_TASK_HISTORY, 0, history_task, &historyTaskArg, &historyTaskHandle) == ESP_OK)
+                        action_clear(ACTION_HUMIDITY_HISTORY);
+                }
+            }
 
-                /*Example for usage*/
-                do
+            if (action & (ACTION_EXPORT_CONSOLE | ACTION_EXPORT_CLOUD)) // stream binary history
+            {
+                if (exportTaskHandle == NULL && deadline_admit(DEADLINE_EXPORT))
                 {
-                    vTaskDelay(10);
-                } while (historyTaskHandle != NULL);
+                    exportTaskArg.target = 0;
+                    exportTaskArg.since = exportSince;
+                    exportTaskArg.dueUs = deadline_due(DEADLINE_EXPORT, esp_timer_get_time());
+                    if (action & ACTION_EXPORT_CONSOLE)
+                        exportTaskArg.target |= EXPORT_CONSOLE;
+                    if (action & ACTION_EXPORT_CLOUD)
+                        exportTaskArg.target |= EXPORT_CLOUD;
+
+                    if (mem_task_start(MEM_TASK_EXPORT, 0, export_task, &exportTaskArg, &exportTaskHandle) == ESP_OK)
+                        action_clear(ACTION_EXPORT_CONSOLE | ACTION_EXPORT_CLOUD);
+                }
+            }
 
-                moistures = historyTaskArg.moistures;
-                total = historyTaskArg.total;
+            if ((action & ACTION_REPORT_CONFIG) && deadline_admit(DEADLINE_STATUS)) // push locally changed settings to the cloud
+            {
+                int64_t dueUs = deadline_due(DEADLINE_STATUS, esp_timer_get_time());
 
-                for (int i = 0; i < total; i++)
+                for (int zone = 0; zone < ZONE_COUNT; zone++)
                 {
-                    time_t timestamp = historyTaskArg.timestamp + i * GPTIMER_PERIOD_S;
-                    struct tm tm;
-                    char s[64];
+                    rmaker_update_auto_watering(zone, appConfig->autoWatering[zone]);
+                    rmaker_update_time_watering(zone, appConfig->timeWatering[zone]);
+                }
 
-                    localtime_r(&timestamp, &tm);
-                    strftime(s, sizeof(s), "%c", &tm);
+                schedule_rule_t rules[SCHEDULE_MAX_RULES];
+                schedule_format(rules, schedule_get(rules, NULL), scheduleText, sizeof(scheduleText));
+                rmaker_update_schedule(scheduleText);
 
-                    ESP_LOGI(TAG, "HISTORY VALUE [%d] = %u | date = %s", i, moistures[i], s);
-                }
+                deadline_done(DEADLINE_STATUS, dueUs);
+                action_clear(ACTION_REPORT_CONFIG);
             }
         }
     }
@@ -240,69 +533,113 @@ void app_main(void)
 }
 
 /*---------------------------------------------------------------
-        Auto watering callback
+        RainMaker write handlers
 ---------------------------------------------------------------*/
-static esp_err_t auto_watering_write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
-                                        const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
+static esp_err_t auto_watering_write(int zone, esp_rmaker_param_val_t val)
 {
-    if (ctx)
-    {
-        ESP_LOGI(TAG, "Received write request via : %s", esp_rmaker_device_cb_src_to_str(ctx->src));
-    }
-    if (strcmp(esp_rmaker_param_get_name(param), ESP_RMAKER_DEF_POWER_NAME) == 0)
-    {
-        autoWateringEn = val.val.b ? true : false;
-        ESP_LOGI(TAG, "RECEIVED_AUTO_WATERING_EN: %s", autoWateringEn ? "true" : "false");
-        action |= ACTION_SET_AUTO_WATERING;
+    config_set_zone(CFG_AUTO_WATERING, zone, val.val.b ? 1 : 0);
+    TLOG(TLOG_RMAKER_AUTO_WATERING, zone, appConfig->autoWatering[zone]);
+
+    action_post(ACTION_SET_AUTO_WATERING);
 
-        xSemaphoreGiveFromISR(xSemaphore, NULL);
-    }
     return ESP_OK;
 }
 
-/*---------------------------------------------------------------
-        Watering device callback
----------------------------------------------------------------*/
-static esp_err_t manual_watering_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
-                                    const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
+static esp_err_t time_watering_write(int zone, esp_rmaker_param_val_t val)
 {
-    if (ctx)
-    {
-        ESP_LOGI(TAG, "Received write request via : %s", esp_rmaker_device_cb_src_to_str(ctx->src));
-    }
-    if (strcmp(esp_rmaker_param_get_name(param), "time irrigating (seconds)") == 0)
+    /* slider drags arrive as bursts, the config store coalesces them into one commit */
+    if (config_set_zone(CFG_TIME_WATERING, zone, val.val.i) != ESP_OK)
+        return ESP_ERR_INVALID_ARG;
+
+    return rmaker_report_int(RMAKER_PARAM_TIME_WATERING, zone, val.val.i);
+}
+
+static esp_err_t trigger_pump_write(int zone, esp_rmaker_param_val_t val)
+{
+    if (!watering[zone])
     {
-        timeWatering = val.val.i;
-        esp_rmaker_param_update_and_report(param, val);
+        latency_begin(LATENCY_PUMP, zone);
+        manual_watering_post(zone, 0);
     }
-    else if (strcmp(esp_rmaker_param_get_name(param), "trigger pump") == 0 && !watering)
-    {
-        action |= ACTION_MANUAL_WATERING;
 
-        xSemaphoreGiveFromISR(xSemaphore, NULL);
-    }
+    return ESP_OK;
+}
+
+static esp_err_t trigger_reading_write(int zone, esp_rmaker_param_val_t val)
+{
+    latency_begin(LATENCY_READ, zone);
+    action_post(ACTION_MANUAL_SENSOR_READ);
+
+    return ESP_OK;
+}
+
+static esp_err_t trigger_export_write(int zone, esp_rmaker_param_val_t val)
+{
+    action_post(ACTION_EXPORT_CLOUD);
+
+    return ESP_OK;
+}
+
+static esp_err_t schedule_rules_write(int zone, esp_rmaker_param_val_t val)
+{
+    schedule_rule_t rules[SCHEDULE_MAX_RULES];
+
+    int count = schedule_parse(val.val.s, rules, SCHEDULE_MAX_RULES);
+    if (count < 0)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = schedule_set(rules, count);
+    if (err != ESP_OK)
+        return err;
+
+    /* echo the rules in their canonical form */
+    action_post(ACTION_REPORT_CONFIG);
 
     return ESP_OK;
 }
 
 /*---------------------------------------------------------------
-        Moisture sensor device callback
+        Schedule
 ---------------------------------------------------------------*/
-static esp_err_t current_moisture_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
-                                     const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
+static void schedule_wake(void)
 {
-    if (ctx)
-    {
-        ESP_LOGI(TAG, "Received write request via : %s", esp_rmaker_device_cb_src_to_str(ctx->src));
-    }
-    if (strcmp(esp_rmaker_param_get_name(param), "trigger reading") == 0)
+    action_post(ACTION_SCHEDULE);
+}
+
+/* main loop, the run it posts is dispatched in the same pass */
+static schedule_result_t schedule_fire(int rule, const schedule_rule_t *entry, uint32_t lateS)
+{
+    int zone = entry->zone;
+    uint8_t seconds = entry->durationS;
+
+    if (watering[zone])
+        return SCHEDULE_BUSY;
+
+    if (entry->target > 0)
     {
-        action |= ACTION_MANUAL_SENSOR_READ;
+        planner_plan_t plan;
 
-        xSemaphoreGiveFromISR(xSemaphore, NULL);
+        /* no run without a settled sample to compare the target with, one may arrive within the window */
+        if (!planner_size(zone, entry->target, &plan))
+        {
+            TLOG(TLOG_SCHEDULE_WAIT, rule, zone);
+            return SCHEDULE_BUSY;
+        }
+
+        if (plan.durationS == 0)
+        {
+            TLOG(TLOG_SCHEDULE_SKIP, rule, zone, plan.level, entry->target);
+            return SCHEDULE_SKIPPED;
+        }
+        seconds = plan.durationS;
     }
 
-    return ESP_OK;
+    TLOG(TLOG_SCHEDULE_RUN, rule, zone, seconds, lateS);
+    trace_record(TRACE_SCHEDULE, zone, rule);
+
+    manual_watering_post(zone, seconds);
+
+    return SCHEDULE_RAN;
 }
 
 /*---------------------------------------------------------------
@@ -312,153 +649,364 @@ static bool timer_on_alarm_cb(gptimer_handle_t timer, const gptimer_alarm_event_
 {
     BaseType_t xHigherPriorityTaskWoken = pdFALSE;
 
-    action |= ACTION_AUTO_SENSOR_READ;
-    action |= ACTION_AUTO_WATERING;
+    alarmUs = esp_timer_get_time();
+    tickUs = alarmUs;
 
-    xSemaphoreGiveFromISR(xSemaphore, &xHigherPriorityTaskWoken);
+    action_post_from_isr(ACTION_AUTO_SENSOR_READ | ACTION_AUTO_WATERING, &xHigherPriorityTaskWoken);
 
     // return whether we need to yield at the end of ISR
     return xHigherPriorityTaskWoken;
 }
 
+/* timer service task, a history sample like the periodic one but off its grid */
+static void crossing_sample_cb(TimerHandle_t timer)
+{
+    action_post(ACTION_AUTO_SENSOR_READ);
+}
+
+/* the periodic sample after a crossing would leave the pump task extrapolating for up to a period */
+static void crossing_sample_arm(void)
+{
+    int64_t crossingUs = planner_next_crossing();
+    int64_t nowUs = esp_timer_get_time();
+    int64_t sampleUs = crossingUs - 1000LL * (appConfig->sensorSettleMs + FILTER_MAX_TIME_MS + PLAN_SAMPLE_LEAD_MS);
+
+    /* nothing predicted, this sample is recent enough, or a periodic one comes first and arms again */
+    if (crossingUs == 0 || sampleUs <= nowUs || sampleUs >= tickUs + 1000000LL * GPTIMER_PERIOD_S)
+        return;
+
+    uint32_t inMs = (sampleUs - nowUs) / 1000;
+
+    TLOG(TLOG_SENSOR_CROSSING, inMs);
+    xTimerChangePeriod(crossingTimer, pdMS_TO_TICKS(inMs) > 0 ? pdMS_TO_TICKS(inMs) : 1, 0);
+}
+
+/* ADC interrupt, the reading it asks for decides whether the alert is raised */
+static void moisture_alarm_cb(int zone, BaseType_t *woken)
+{
+    taskENTER_CRITICAL_ISR(&actionLock);
+    alarmZones |= 1 << zone;
+    taskEXIT_CRITICAL_ISR(&actionLock);
+
+    action_post_from_isr(ACTION_ALARM_SENSOR_READ, woken);
+}
+
 /*---------------------------------------------------------------
         Sensor Task
 ---------------------------------------------------------------*/
 static void sensor_task(void *arg)
 {
-    static bool warned = false;
+    static bool warned[ZONE_COUNT];
+    static uint8_t reported[ZONE_COUNT]; // last moisture RainMaker was sent
 
     sensor_task_arg_t *sensorTaskArg = (sensor_task_arg_t *)arg;
+    int64_t startUs = esp_timer_get_time();
 
-    adc_oneshot_unit_handle_t *adcHandle = (adc_oneshot_unit_handle_t *)(sensorTaskArg->adcHandle);
+    if (sensorTaskArg->alarmUs != 0)
+        jitter_record(JITTER_SAMPLE_START, startUs - sensorTaskArg->alarmUs);
+    else
+        latency_mark(LATENCY_READ, LATENCY_ANY_ZONE, LATENCY_TASK);
 
-    int average = 0, raw;
-    for (int i = 0; i < 50; i++)
-    {
-        adc_get_raw(adcHandle, &raw);
-        average += raw;
-        vTaskDelay(pdMS_TO_TICKS(20));
-    }
+    /* the probes are powered and settle before the sweep, that time is part of the job */
+    int64_t releaseUs = sensorTaskArg->alarmUs != 0 ? sensorTaskArg->alarmUs : startUs;
+    int64_t sampleDueUs = deadline_due(DEADLINE_SAMPLE, releaseUs + 1000LL * (appConfig->sensorSettleMs + ZONE_COUNT * DEADLINE_SAMPLE_MARGIN_MS));
 
-    average /= 50;
+    adc_continuous_handle_t *adcHandle = (adc_continuous_handle_t *)(sensorTaskArg->adcHandle);
 
-    uint8_t percentage = (average * 100) / 4095;
+    /* one pattern sweep per group covers every zone */
+    adc_estimate_t estimates[ZONE_COUNT];
+    adc_estimate(adcHandle, estimates);
 
-    uint8_t old;
-    eeprom_read_last_moisture(*sensorTaskArg->spiHandle, &old);
+    adc_reading_t readings[ZONE_COUNT];
+    uint32_t consumers = adc_reading_publish(estimates, readings);
 
-    if (sensorTaskArg->mode == SENSOR_AUTO)
+    /* one history record per pass, holding every zone */
+    if (consumers & SENSOR_AUTO)
     {
-        eeprom_write_moisture(*sensorTaskArg->spiHandle, percentage);
-        ESP_LOGI(TAG, "SENSOR_TASK: AUTO_SENSOR_READ %u stored to EEPROM", percentage);
-    }
+        uint8_t samples[ZONE_COUNT];
 
-    /* update value on cloud service if it changed or was manually requested */
-    if ((old != percentage) || sensorTaskArg->mode == SENSOR_MANUAL)
-    {
-        ESP_LOGI(TAG, "SENSOR_TASK: %d UPDATED IN THE CLOUD", percentage);
-        rmaker_update_moisture(percentage);
-    }
+        for (int zone = 0; zone < ZONE_COUNT; zone++)
+            samples[zone] = readings[zone].percentage;
 
-    /* warn user if moisture value is critical */
-    if (percentage < 10 && !warned)
-    {
-        rmaker_warn_user("Moisture on critical level!");
-        warned = true;
+        if (storage_append(samples, time(NULL)) == ESP_OK)
+            TLOG(TLOG_SENSOR_STORED, samples[0]);
+        else
+            TLOG(TLOG_SENSOR_FULL);
     }
-    else if (percentage > 20 && warned) // clean warned flag
+    deadline_done(DEADLINE_SAMPLE, sampleDueUs);
+
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
     {
-        warned = false;
+        uint8_t percentage = readings[zone].percentage;
+
+        lastMoisture[zone] = percentage;
+        trace_record(TRACE_SAMPLE, zone, percentage);
+
+        /* same core and below the pump task, the handle cannot go stale in between */
+        if (planner_sample(zone, percentage) && pumpTaskHandle[zone] != NULL)
+        {
+            TLOG(TLOG_PUMP_AUTO_EARLY, zone);
+            xTaskNotifyGive(pumpTaskHandle[zone]);
+        }
+
+        /* update value on cloud service if it changed or was manually requested, a shed report is caught up once the level drops */
+        if ((reported[zone] != percentage || (consumers & SENSOR_MANUAL)) && deadline_admit(DEADLINE_REPORT))
+        {
+            int64_t dueUs = deadline_due(DEADLINE_REPORT, esp_timer_get_time());
+
+            TLOG(TLOG_SENSOR_CLOUD, zone, percentage);
+            rmaker_update_moisture(zone, percentage);
+            reported[zone] = percentage;
+            if (consumers & SENSOR_MANUAL)
+                latency_mark(LATENCY_READ, zone, LATENCY_PUBLISH);
+
+            deadline_done(DEADLINE_REPORT, dueUs);
+        }
+
+        /* warn user if moisture value is critical */
+        if (percentage < appConfig->alertLow[zone] && !warned[zone])
+        {
+            int64_t dueUs = deadline_due(DEADLINE_ALERT, esp_timer_get_time());
+            char alert[48];
+            snprintf(alert, sizeof(alert), ZONE_COUNT == 1 ? "Moisture on critical level!" : "Moisture on critical level in zone %d!", zone + 1);
+            rmaker_warn_user(alert);
+            warned[zone] = true;
+            deadline_done(DEADLINE_ALERT, dueUs);
+        }
+        else if (percentage > appConfig->alertClear[zone] && warned[zone]) // clean warned flag
+        {
+            warned[zone] = false;
+        }
     }
 
+    /* the monitors watch the zones until the next pass, for the side their alert state waits for */
+    adc_alarm_arm(appConfig->alertLow, appConfig->alertClear, warned);
+
+    /* after the planner has seen this pass, its crossing may fall before the next period */
+    crossing_sample_arm();
+
     if (xTaskGetCurrentTaskHandle() == sensorTaskHandle)
         sensorTaskHandle = NULL;
     vTaskDelete(NULL);
 }
 
+/* runs the acquisition the broker just handed out, false gives it back for a later pass */
+static bool sensor_start(int64_t alarmUs)
+{
+    sensorTaskArg.alarmUs = alarmUs;
+
+    if (mem_task_start(MEM_TASK_SENSOR, 0, sensor_task, &sensorTaskArg, &sensorTaskHandle) == ESP_OK)
+        return true;
+
+    adc_reading_abort();
+    return false;
+}
+
 /*---------------------------------------------------------------
         Pump Task
 ---------------------------------------------------------------*/
 static void pump_task(void *arg)
 {
-    ESP_LOGI(TAG, "PUMP_TASK: ENTERING");
-
     pump_task_arg_t *pumpTaskArg = (pump_task_arg_t *)arg;
+    int zone = pumpTaskArg->zone;
+
+    taskENTER_CRITICAL(&actionLock);
+    pumpTasksAlive[zone]++;
+    taskEXIT_CRITICAL(&actionLock);
+
+    TLOG(TLOG_PUMP_ENTER, zone);
 
     if (pumpTaskArg->mode == WATERING_AUTO)
     {
-        vTaskDelay(pdMS_TO_TICKS(3000));
+        pump_sleep(zone, 3000);
 
-        uint8_t moisture;
+        planner_plan_t plan;
 
-        while (autoWateringEn)
+        while (appConfig->autoWatering[zone] && !pumpStop[zone])
         {
-            eeprom_read_last_moisture(*pumpTaskArg->spiHandle, &moisture);
+            planner_plan(zone, appConfig->targetMoisture[zone], &plan);
 
-            ESP_LOGI(TAG, "PUMP_TASK: AUTO_WATERING moisture read: %u", moisture);
+            TLOG(TLOG_PUMP_AUTO_PLAN, zone, plan.level, plan.waitS, plan.durationS);
 
-            if (moisture < 50)
+            /* sleep until the predicted crossing, a sample that brings it forward wakes the task */
+            if (plan.waitS > 0)
             {
-                uint8_t activeTimeS = (((50 - moisture) / 10) + 1) * 10;
-
-                watering = true;
-                rmaker_update_watering_status(watering);
-
-                ESP_LOGI(TAG, "PUMP_TASK: AUTO_WATERING for %u seconds", activeTimeS);
+                ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(1000 * plan.waitS));
+                continue;
+            }
 
-                pwm_set_duty(PWM_100_DUTY);
-                vTaskDelay(pdMS_TO_TICKS(1000 * activeTimeS)); // time watering
-                pwm_set_duty(PWM_0_DUTY);
+            TLOG(TLOG_PUMP_AUTO_RUN, zone, plan.durationS);
 
-                watering = false;
-                rmaker_update_watering_status(watering);
-            }
+            uint8_t wateredS = pump_run(zone, plan.durationS);
+            if (wateredS > 0)
+                planner_watered(zone, wateredS, appConfig->waitAfterWateringS);
 
-            vTaskDelay(pdMS_TO_TICKS(WAIT_AFTER_WATERING_S)); // time on hold until next check
+            pump_sleep(zone, 1000 * appConfig->waitAfterWateringS); // time on hold to let the dirt irrigate
         }
     }
 
     else if (pumpTaskArg->mode == WATERING_MANUAL)
     {
-        watering = true;
-        rmaker_update_watering_status(watering);
+        TLOG(TLOG_PUMP_MANUAL_RUN, zone, pumpTaskArg->activeTimeS);
+        latency_mark(LATENCY_PUMP, zone, LATENCY_TASK);
 
-        ESP_LOGI(TAG, "PUMP_TASK: MANUAL_WATERING for %u seconds", pumpTaskArg->activeTimeS);
+        uint8_t wateredS = pump_run(zone, pumpTaskArg->activeTimeS);
+        if (wateredS > 0)
+            planner_watered(zone, wateredS, appConfig->waitAfterWateringS);
 
-        pwm_set_duty(PWM_100_DUTY);
-        vTaskDelay(pdMS_TO_TICKS(1000 * pumpTaskArg->activeTimeS)); // time watering
-        pwm_set_duty(PWM_0_DUTY);
+        pump_sleep(zone, 1000 * appConfig->waitAfterWateringS); // time on hold to let the dirt irrigate
+    }
 
-        watering = false;
-        rmaker_update_watering_status(watering);
+    TLOG(TLOG_PUMP_END, zone);
 
-        vTaskDelay(pdMS_TO_TICKS(WAIT_AFTER_WATERING_S)); // time on hold to let the dirt irrigate
-    }
+    bool stopped;
 
-    ESP_LOGI(TAG, "PUMP_TASK: WATERING CYCLE ENDED");
+    /* the handle and the stop request change together, a stop either finds the task or starts the next one */
+    taskENTER_CRITICAL(&actionLock);
+    if (pumpTaskHandle[zone] == xTaskGetCurrentTaskHandle())
+        pumpTaskHandle[zone] = NULL;
+    pumpTasksAlive[zone]--;
+    stopped = pumpStop[zone];
+    pumpStop[zone] = false;
+    taskEXIT_CRITICAL(&actionLock);
+
+    /* the manual run that stopped this cycle is still pending */
+    if (stopped)
+        action_post(ACTION_MANUAL_WATERING);
 
-    if (xTaskGetCurrentTaskHandle() == pumpTaskHandle)
-        pumpTaskHandle = NULL;
     vTaskDelete(NULL);
 }
 
+/* false when the main loop asked the task to stop, other notifications only shorten one wait */
+static bool pump_sleep(int zone, uint32_t ms)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t ticks = pdMS_TO_TICKS(ms);
+
+    while (!pumpStop[zone])
+    {
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= ticks)
+            return true;
+
+        ulTaskNotifyTake(pdTRUE, ticks - elapsed);
+    }
+
+    return false;
+}
+
+static bool pump_start(int zone, uint8_t mode)
+{
+    pumpTaskArg[zone].mode = mode;
+
+    return mem_task_start(MEM_TASK_PUMP, zone, pump_task, &pumpTaskArg[zone], &pumpTaskHandle[zone]) == ESP_OK;
+}
+
+/* seconds the pump actually ran, a stop request cuts the run short */
+static uint8_t pump_run(int zone, uint8_t activeTimeS)
+{
+    /* the supply only feeds ZONE_MAX_ACTIVE_PUMPS at once, later zones queue here */
+    if (!pwm_pump_acquire(0))
+    {
+        TLOG(TLOG_PUMP_WAIT_SUPPLY, zone, pwm_pumps_active());
+        while (!pwm_pump_acquire(pdMS_TO_TICKS(PUMP_STOP_POLL_MS)))
+            if (pumpStop[zone])
+                return 0;
+    }
+
+    /* both status reports or neither, so the cloud never keeps a stale "watering" */
+    bool report = deadline_admit(DEADLINE_STATUS);
+    int64_t dueUs = deadline_due(DEADLINE_STATUS, esp_timer_get_time());
+
+    watering[zone] = true;
+    if (report)
+    {
+        rmaker_update_watering_status(zone, true);
+        latency_mark(LATENCY_PUMP, zone, LATENCY_PUBLISH);
+        deadline_done(DEADLINE_STATUS, dueUs);
+    }
+
+    int64_t onUs = esp_timer_get_time();
+    int64_t stopUs = onUs + 1000000LL * activeTimeS;
+
+    pumpRuns[zone]++;
+    pwm_set_duty(zone, PWM_100_DUTY);
+    latency_mark(LATENCY_PUMP, zone, LATENCY_ACTUATE);
+    trace_record(TRACE_PUMP_ON, zone, activeTimeS);
+    bool completed = pump_sleep(zone, 1000 * activeTimeS); // time watering
+    pwm_set_duty(zone, PWM_0_DUTY);
+
+    /* a stopped run has no scheduled stop to be late for */
+    int64_t offUs = esp_timer_get_time();
+    int64_t lateUs = completed ? offUs - stopUs : 0;
+    trace_record(TRACE_PUMP_OFF, zone, lateUs > 0 ? lateUs : 0);
+    if (completed)
+    {
+        jitter_record(JITTER_PUMP_STOP, lateUs);
+        deadline_done(DEADLINE_PUMP_STOP, deadline_due(DEADLINE_PUMP_STOP, stopUs));
+    }
+
+    watering[zone] = false;
+    pwm_pump_release();
+
+    if (report)
+    {
+        dueUs = deadline_due(DEADLINE_STATUS, esp_timer_get_time());
+        rmaker_update_watering_status(zone, false);
+        deadline_done(DEADLINE_STATUS, dueUs);
+    }
+
+    return completed ? activeTimeS : (offUs - onUs) / 1000000;
+}
+
 /*---------------------------------------------------------------
         Moisture history Task
 ---------------------------------------------------------------*/
 static void history_task(void *arg)
 {
     history_task_arg_t *historyTaskArg = (history_task_arg_t *)arg;
+    storage_snapshot_t snap;
+
+    /* count and timestamp from the same append, sampling goes on while the dump runs */
+    storage_snapshot(&snap);
+    historyTaskArg->total = snap.count;
+
+    uint32_t first = 0;
+    if (historyTaskArg->last != HISTORY_ALL && historyTaskArg->last < historyTaskArg->total)
+        first = historyTaskArg->total - historyTaskArg->last;
 
-    for (int i = 0; i < TOTAL_ADDRESSES; i++)
+    /* a time range starts at its first record, found from the keyframe index */
+    if (historyTaskArg->since != 0)
     {
-        if (!eeprom_read_moisture(*historyTaskArg->spiHandle, i, &(historyTaskArg->moistures[i])))
-        {
-            historyTaskArg->total = i;
+        int since = storage_seek(&snap, historyTaskArg->since);
+        if (since < 0)
+            first = historyTaskArg->total; // the log moved under the seek
+        else if ((uint32_t)since > first)
+            first = since;
+    }
+
+    /* the flash log holds months, read it a chunk at a time */
+    for (uint32_t i = first; i < historyTaskArg->total; i += HISTORY_CHUNK)
+    {
+        uint32_t left = historyTaskArg->total - i;
+        int read = storage_read(&snap, historyTaskArg->zone, i, historyTaskArg->moistures, left < HISTORY_CHUNK ? left : HISTORY_CHUNK);
+        if (read <= 0 || storage_read_times(&snap, i, historyTaskArg->times, read) != read)
             break;
+
+        for (int j = 0; j < read; j++)
+        {
+            uint32_t timestamp = historyTaskArg->times[j];
+
+            if (historyTaskArg->moistures[j] > 100)
+                continue;
+
+            /* a full dump is larger than the ring, let the drainer catch up instead of dropping lines */
+            tlog_wait_free(portMAX_DELAY);
+
+            TLOG(TLOG_HISTORY_VALUE, historyTaskArg->zone, i + j, historyTaskArg->moistures[j], timestamp);
         }
     }
-
-    eeprom_read_timestamp(*historyTaskArg->spiHandle, &(historyTaskArg->timestamp));
+    deadline_done(DEADLINE_HISTORY, historyTaskArg->dueUs);
 
     if (xTaskGetCurrentTaskHandle() == historyTaskHandle)
         historyTaskHandle = NULL;
@@ -466,35 +1014,837 @@ static void history_task(void *arg)
 }
 
 /*---------------------------------------------------------------
-        Get Data From Terminal Task
+        History Export Task
 ---------------------------------------------------------------*/
-static void get_data_from_terminal_task(void *arg)
+static void export_task(void *arg)
 {
-    char buf;
+    export_task_arg_t *exportTaskArg = (export_task_arg_t *)arg;
 
-    while (1)
+    if (exportTaskArg->target & EXPORT_CONSOLE)
+    {
+        export_history_to_console(exportTaskArg->since);
+    }
+
+    if (exportTaskArg->target & EXPORT_CLOUD)
+    {
+        if (export_history_to_base64(exportFrame, sizeof(exportFrame)) >= 0)
+            rmaker_update_history_export(exportFrame);
+        else
+            ESP_LOGW(TAG, "EXPORT_TASK: history frame not exported");
+    }
+    deadline_done(DEADLINE_EXPORT, exportTaskArg->dueUs);
+
+    if (xTaskGetCurrentTaskHandle() == exportTaskHandle)
+        exportTaskHandle = NULL;
+    vTaskDelete(NULL);
+}
+
+/*---------------------------------------------------------------
+        Benchmark Task
+---------------------------------------------------------------*/
+static void bench_task(void *arg)
+{
+    bench_task_arg_t *benchTaskArg = (bench_task_arg_t *)arg;
+    int64_t start, elapsed, min = INT64_MAX, max = 0, total = 0;
+
+    if (strcmp(benchTaskArg->name, "adc") == 0)
     {
-        buf = getchar();
+        int medians[ZONE_COUNT];
 
-        switch (buf)
+        if (!adc_power_on())
         {
-        case 'h':
-            action |= ACTION_HUMIDITY_HISTORY;
-            xSemaphoreGive(xSemaphore);
-            break;
+            printf("the probes are being characterized\n");
+        }
+        else
+        {
+            esp_err_t err = ESP_OK;
 
-        case 'r':
-            action |= ACTION_MANUAL_SENSOR_READ;
-            xSemaphoreGive(xSemaphore);
-            break;
+            for (int i = 0; i < benchTaskArg->iterations && (err == ESP_OK || err == ESP_ERR_TIMEOUT); i++)
+            {
+                start = esp_timer_get_time();
+                err = adc_sweep(&adcHandle, medians);
+                elapsed = esp_timer_get_time() - start;
+
+                total += elapsed;
+                min = elapsed < min ? elapsed : min;
+                max = elapsed > max ? elapsed : max;
+            }
+            adc_power_off();
+
+            if (err != ESP_OK && err != ESP_ERR_TIMEOUT)
+                printf("adc sweep failed: %s\n", esp_err_to_name(err));
+            else
+                printf("adc sweep (%d zones x %d): n=%d min=%lldus avg=%lldus max=%lldus\n", ZONE_COUNT, FILTER_MEDIAN_N, benchTaskArg->iterations,
+                       min, total / benchTaskArg->iterations, max);
+        }
+    }
+    else if (strcmp(benchTaskArg->name, "storage") == 0)
+    {
+        bench_storage(storage_backend(STORAGE_EEPROM), benchTaskArg->iterations);
+        bench_storage(storage_backend(STORAGE_FLASH), benchTaskArg->iterations);
+    }
+    else if (strcmp(benchTaskArg->name, "netload") == 0)
+    {
+        /* floods the MQTT path so the jitter probes can be read under network load */
+        start = esp_timer_get_time();
+        bench_netload(benchTaskArg->iterations);
+        elapsed = esp_timer_get_time() - start;
+        printf("netload: %d reports queued in %lldus, check 'jitter'\n", benchTaskArg->iterations, elapsed);
+    }
+    else if (strcmp(benchTaskArg->name, "storm") == 0)
+    {
+        /* every step runs the pumps, a storm is a bench test with the pumps on water or disconnected */
+        storm_run(benchTaskArg->iterations, bench_storm_inject, bench_storm_check, actionNames);
+    }
+    else if (strcmp(benchTaskArg->name, "e2e") == 0)
+    {
+        /* runs for the given seconds, the host tool drives the commands and the load */
+        esp_err_t err = latency_serve(latencyUri, benchTaskArg->iterations, bench_netload);
+        if (err != ESP_OK)
+            printf("bench broker failed: %s\n", esp_err_to_name(err));
+    }
+    else
+    {
+        printf("unknown benchmark '%s'\n", benchTaskArg->name);
+    }
+
+    if (xTaskGetCurrentTaskHandle() == benchTaskHandle)
+        benchTaskHandle = NULL;
+    vTaskDelete(NULL);
+}
+
+static void bench_netload(int reports)
+{
+    for (int i = 0; i < reports; i++)
+        rmaker_update_moisture(i % ZONE_COUNT, lastMoisture[i % ZONE_COUNT]);
+}
+
+/* one event of the storm, the zones take turns and one write in four starts a pump */
+static void bench_storm_inject(storm_source_t source, int seq)
+{
+    int zone = seq % ZONE_COUNT;
+    bool pump = seq % 4 == 3;
+    char zoneArg[8];
+
+    switch (source)
+    {
+    case STORM_TIMER:
+        /* what the alarm ISR posts, from task context */
+        alarmUs = esp_timer_get_time();
+        action_post(ACTION_AUTO_SENSOR_READ | ACTION_AUTO_WATERING);
+        break;
+    case STORM_CLOUD:
+        rmaker_inject_write(pump ? RMAKER_PARAM_TRIGGER_PUMP : RMAKER_PARAM_TRIGGER_READING, zone, esp_rmaker_bool(true));
+        break;
+    case STORM_CONSOLE:
+        /* the handlers themselves, esp_console_run belongs to Console_Task and is not reentrant */
+        snprintf(zoneArg, sizeof(zoneArg), "%d", zone);
+        /* 'read' waits for the sample, so the other line re-applies the zone's auto setting */
+        if (pump)
+            cmd_water(3, (char *[]){"water", "1", zoneArg});
+        else
+            cmd_auto(3, (char *[]){"auto", appConfig->autoWatering[zone] ? "on" : "off", zoneArg});
+        break;
+    default:
+        break;
+    }
+}
+
+static uint32_t bench_storm_check(void)
+{
+    uint32_t unsafe = 0;
+    int pumpsOn = 0;
+
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+    {
+        /* watering is set before the output goes on and cleared after it goes off, read it on both sides */
+        bool before = watering[zone];
+        bool on = pwm_get_duty(zone) > 0;
+        bool after = watering[zone];
+
+        if (on && !before && !after)
+            unsafe |= STORM_UNSAFE_PUMP_IDLE;
+        if (on)
+            pumpsOn++;
+        if (pumpTasksAlive[zone] > 1)
+            unsafe |= STORM_UNSAFE_DUPLICATE;
+    }
+
+    if (pumpsOn > ZONE_MAX_ACTIVE_PUMPS)
+        unsafe |= STORM_UNSAFE_SUPPLY;
+
+    return unsafe;
+}
+
+static void bench_storage(const storage_backend_t *backend, int iterations)
+{
+    static uint8_t samples[HISTORY_CHUNK];
+    int64_t start, elapsed, min = INT64_MAX, max = 0, total = 0;
+    uint32_t bytesBefore, erasesBefore, bytesAfter, erasesAfter;
+    uint32_t records;
+    storage_snapshot_t snap;
+
+    if (backend == storage_active())
+    {
+        /* the live log is not touched, appends are timed as the sensor task stores them */
+        storage_stats_t stats;
+        storage_stats(&stats);
+        printf("%s (active): %lu appends avg=%lldus max=%lldus, %lu deferred behind a reader, %lu dropped, %lu read retries\n",
+               backend->name, (unsigned long)stats.appends, stats.appends ? stats.appendTotalUs / stats.appends : 0, stats.appendMaxUs,
+               (unsigned long)stats.deferred, (unsigned long)stats.dropped, (unsigned long)stats.readRetries);
+        storage_snapshot(&snap);
+        records = snap.count;
+    }
+    else
+    {
+        if (backend->open() != ESP_OK)
+        {
+            printf("%s: not available\n", backend->name);
+            return;
+        }
+
+        /* the inactive backend is scratch space, its old log is discarded */
+        backend->wear(&bytesBefore, &erasesBefore);
+
+        /* a reset clears the whole log, it shows bulk write throughput */
+        start = esp_timer_get_time();
+        uint64_t now = time(NULL);
+        backend->reset(now);
+        elapsed = esp_timer_get_time() - start;
+        printf("%s: reset in %lldus\n", backend->name, elapsed);
+
+        memset(samples, STORAGE_NO_SAMPLE, ZONE_COUNT);
+        for (int i = 0; i < iterations; i++)
+        {
+            start = esp_timer_get_time();
+            if (backend->append(samples, now + (uint64_t)(i + 1) * GPTIMER_PERIOD_S, GPTIMER_PERIOD_S) != ESP_OK)
+                break;
+            elapsed = esp_timer_get_time() - start;
+
+            total += elapsed;
+            min = elapsed < min ? elapsed : min;
+            max = elapsed > max ? elapsed : max;
+        }
+        backend->wear(&bytesAfter, &erasesAfter);
+        records = backend->count();
+
+        printf("%s: %lu appends min=%lldus avg=%lldus max=%lldus, %lu bytes written, %lu erases\n", backend->name,
+               (unsigned long)records, min, records ? total / records : 0, max, (unsigned long)(bytesAfter - bytesBefore),
+               (unsigned long)(erasesAfter - erasesBefore));
+    }
 
-        case 'w':
-            autoWateringEn = !autoWateringEn;
-            action |= ACTION_SET_AUTO_WATERING;
-            xSemaphoreGive(xSemaphore);
+    uint32_t read = 0;
+    start = esp_timer_get_time();
+    while (read < records)
+    {
+        int n = backend == storage_active() ? storage_read(&snap, 0, read, samples, sizeof(samples))
+                                            : backend->read_range(0, read, samples, sizeof(samples));
+        if (n <= 0)
             break;
+        read += n;
+    }
+    elapsed = esp_timer_get_time() - start;
+    printf("%s: read %lu samples in %lldus (%lld samples/s)\n", backend->name, (unsigned long)read, elapsed,
+           elapsed > 0 ? (int64_t)read * 1000000 / elapsed : 0);
+
+    /* the most worn cell takes cyclesPerWrap cycles every time capacity records go by */
+    uint64_t recordsPerDay = 86400 / GPTIMER_PERIOD_S;
+    uint64_t days = (uint64_t)backend->endurance * backend->capacity() / (backend->cyclesPerWrap * recordsPerDay);
+    printf("%s: capacity %lu records (%llu days), rated wear-out after ~%llu years of sampling\n", backend->name,
+           (unsigned long)backend->capacity(), (uint64_t)backend->capacity() / recordsPerDay, days / 365);
+}
+
+/*---------------------------------------------------------------
+        OTA Task
+---------------------------------------------------------------*/
+static void ota_task(void *arg)
+{
+    const char *url = (const char *)arg;
+
+    printf("updating from %s\n", url);
+    /* no pinned cert, an https server is checked against the certificate bundle */
+    esp_err_t err = delta_apply_url(url, NULL);
+
+    if (err == ESP_OK)
+    {
+        printf("update written, restarting\n");
+        vTaskDelay(pdMS_TO_TICKS(1000));
+        esp_restart();
+    }
+    else if (err == ESP_ERR_INVALID_VERSION)
+    {
+        printf("the patch was made against another image, serve the full image instead\n");
+    }
+    else
+    {
+        printf("update failed: %s\n", esp_err_to_name(err));
+    }
+
+    otaTaskHandle = NULL;
+    vTaskDelete(NULL);
+}
+
+/*---------------------------------------------------------------
+        Main loop actions
+---------------------------------------------------------------*/
+static void action_post(uint16_t bits)
+{
+    taskENTER_CRITICAL(&actionLock);
+    storm_posted(action, bits);
+    action |= bits;
+    taskEXIT_CRITICAL(&actionLock);
+
+    storm_woken(xSemaphoreGive(xSemaphore) == pdTRUE);
+}
+
+static void action_post_from_isr(uint16_t bits, BaseType_t *pxHigherPriorityTaskWoken)
+{
+    taskENTER_CRITICAL_ISR(&actionLock);
+    storm_posted(action, bits);
+    action |= bits;
+    taskEXIT_CRITICAL_ISR(&actionLock);
+
+    storm_woken(xSemaphoreGiveFromISR(xSemaphore, pxHigherPriorityTaskWoken) == pdTRUE);
+}
+
+static void action_clear(uint16_t bits)
+{
+    taskENTER_CRITICAL(&actionLock);
+    storm_dispatched(action & bits);
+    action &= ~bits;
+    taskEXIT_CRITICAL(&actionLock);
+}
+
+static void manual_watering_post(int zone, uint8_t seconds)
+{
+    taskENTER_CRITICAL(&actionLock);
+    manualZones |= 1 << zone;
+    if (seconds)
+        forcedTimeWatering[zone] = seconds;
+    storm_posted(action, ACTION_MANUAL_WATERING);
+    action |= ACTION_MANUAL_WATERING;
+    taskEXIT_CRITICAL(&actionLock);
+
+    storm_woken(xSemaphoreGive(xSemaphore) == pdTRUE);
+}
+
+/*---------------------------------------------------------------
+        Console Commands
+---------------------------------------------------------------*/
+static void console_register_commands(void)
+{
+    console_register("history", "[last|since <epoch>] [zone]", "Print the moisture history, optionally only the last N values or those from a time on", cmd_history);
+    console_register("export", "[since <epoch>]", "Stream the history as a binary frame (decode with tools/decode_history.py)", cmd_export);
+    console_register("read", NULL, "Trigger a moisture reading of every zone", cmd_read);
+    console_register("water", "[seconds] [zone]", "Force a watering cycle", cmd_water);
+    console_register("auto", "[on|off] [zone]", "Show, set or toggle auto watering", cmd_auto);
+    console_register("config", "[set <key> <value> [zone]|reset|flush]", "Show or change the persisted configuration", cmd_config);
+    console_register("calibrate", "<dry|wet|settle|show|reset> [zone]", "Capture the sensor calibration points or the probe settle time", cmd_calibrate);
+    console_register("stats", NULL, "Print runtime statistics", cmd_stats);
+    console_register("bench", "<adc|storage|netload|storm> [iterations]", "Run a benchmark in the background (storage wipes the inactive backend)", cmd_bench);
+    console_register("jitter", "[reset]", "Print sample start and pump stop latency distributions", cmd_jitter);
+    console_register("deadline", "[reset]", "Print deadline misses per job and the current shed level", cmd_deadline);
+    console_register("latency", "[reset|serve <mqtt-uri> [seconds]]", "Print command latency per stage or serve a bench broker (see tools/latency_bench.py)", cmd_latency);
+    console_register("trace", "[prev]", "Print the flight recorder of this boot or of the previous one", cmd_trace);
+    console_register("ota", "<url>", "Update from a patch or full image served over HTTP (see tools/delta_ota.py)", cmd_ota);
+    console_register("plan", "[zone]", "Print the watering model and the next planned run", cmd_plan);
+    console_register("schedule", "[add <days> <HH:MM> <window> <zone> <Ns|N%>|del <rule>|clear]", "List, add or remove watering rules (days as SMTWTFS, '-' for off)", cmd_schedule);
+    console_register("mem", NULL, "Print the static memory plan with stack and heap margins", cmd_mem);
+    console_register("log", "[text|raw]", "Show tokenized log statistics or switch its output (decode raw with tools/decode_log.py)", cmd_log);
+}
+
+static int cmd_zone_arg(int argc, char **argv, int index)
+{
+    if (argc <= index)
+        return 0;
+
+    int zone = atoi(argv[index]);
+    if (zone < 0 || zone >= ZONE_COUNT)
+    {
+        printf("zone must be between 0 and %d\n", ZONE_COUNT - 1);
+        return -1;
+    }
+    return zone;
+}
+
+static int cmd_history(int argc, char **argv)
+{
+    bool since = argc > 2 && strcmp(argv[1], "since") == 0;
+    int zone = cmd_zone_arg(argc, argv, since ? 3 : 2);
+    if (zone < 0)
+        return 1;
+
+    historyLast = argc > 1 && !since ? atoi(argv[1]) : HISTORY_ALL;
+    historySince = since ? strtoull(argv[2], NULL, 10) : 0;
+    historyZone = zone;
+    action_post(ACTION_HUMIDITY_HISTORY);
+    return 0;
+}
+
+static int cmd_export(int argc, char **argv)
+{
+    if (argc > 1 && (argc < 3 || strcmp(argv[1], "since") != 0))
+    {
+        printf("usage: export [since <epoch>]\n");
+        return 1;
+    }
+
+    exportSince = argc > 2 ? strtoull(argv[2], NULL, 10) : 0;
+    action_post(ACTION_EXPORT_CONSOLE);
+    return 0;
+}
+
+static int cmd_read(int argc, char **argv)
+{
+    uint32_t seq = adc_reading_seq();
+    adc_reading_t readings[ZONE_COUNT];
+
+    /* one broker request either way: served from the cache here, or by the reading the main loop starts or shares */
+    if (!adc_reading_get_fresh(1000 * appConfig->readFreshnessS, readings))
+    {
+        action_post(ACTION_MANUAL_SENSOR_READ);
+
+        /* the slowest estimate: probe settle, then every filter group timing out */
+        uint32_t waitMs = appConfig->sensorSettleMs + FILTER_MAX_TIME_MS + READ_WAIT_MARGIN_MS;
+
+        if (adc_reading_wait(seq, pdMS_TO_TICKS(waitMs), readings) != ESP_OK)
+        {
+            printf("no reading yet\n");
+            return 1;
         }
+    }
+
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+        printf("zone %d moisture: %u%% (raw %d, variance %lu, %d samples, %llds old)\n", zone, readings[zone].percentage,
+               readings[zone].raw, (unsigned long)readings[zone].variance, readings[zone].samples,
+               (esp_timer_get_time() - readings[zone].timeUs) / 1000000);
+    return 0;
+}
+
+static int cmd_water(int argc, char **argv)
+{
+    int seconds = 0;
+    int zone = cmd_zone_arg(argc, argv, 2);
+    if (zone < 0)
+        return 1;
 
-        vTaskDelay(pdMS_TO_TICKS(100));
+    if (watering[zone])
+    {
+        printf("already watering\n");
+        return 1;
     }
+
+    if (argc > 1)
+    {
+        seconds = atoi(argv[1]);
+        if (seconds <= 0 || seconds > 100)
+        {
+            printf("seconds must be between 1 and 100\n");
+            return 1;
+        }
+    }
+
+    manual_watering_post(zone, seconds);
+    return 0;
+}
+
+static int cmd_auto(int argc, char **argv)
+{
+    int zone = cmd_zone_arg(argc, argv, 2);
+    if (zone < 0)
+        return 1;
+
+    uint16_t enable = !appConfig->autoWatering[zone];
+
+    if (argc > 1)
+    {
+        if (strcmp(argv[1], "on") == 0)
+            enable = 1;
+        else if (strcmp(argv[1], "off") == 0)
+            enable = 0;
+        else
+            return 1;
+    }
+
+    config_set_zone(CFG_AUTO_WATERING, zone, enable);
+
+    action_post(ACTION_SET_AUTO_WATERING);
+    return 0;
+}
+
+static int cmd_config(int argc, char **argv)
+{
+    if (argc > 3 && strcmp(argv[1], "set") == 0)
+    {
+        int key = config_find(argv[2]);
+        if (key < 0)
+        {
+            printf("unknown key '%s'\n", argv[2]);
+            return 1;
+        }
+
+        const config_schema_t *entry = config_schema(key);
+        int value = atoi(argv[3]);
+        int zone = cmd_zone_arg(argc, argv, 4);
+        if (zone < 0)
+            return 1;
+        if (zone >= entry->zones)
+        {
+            printf("%s is not a per-zone key\n", entry->key);
+            return 1;
+        }
+        if (value < entry->min || value > entry->max || config_set_zone(key, zone, value) != ESP_OK)
+        {
+            printf("%s must be between %u and %u\n", entry->key, entry->min, entry->max);
+            return 1;
+        }
+    }
+    else if (argc > 1 && strcmp(argv[1], "reset") == 0)
+    {
+        config_reset();
+    }
+    else if (argc > 1 && strcmp(argv[1], "flush") == 0)
+    {
+        config_flush();
+        return 0;
+    }
+    else if (argc > 1)
+    {
+        return 1;
+    }
+
+    if (argc > 1)
+    {
+        for (int zone = 0; zone < ZONE_COUNT; zone++)
+            adc_set_calibration(zone, appConfig->sensorDryRaw[zone], appConfig->sensorWetRaw[zone]);
+        adc_set_settle(appConfig->sensorSettleMs);
+        action_post(ACTION_REPORT_CONFIG);
+    }
+
+    for (int i = 0; i < CFG_TOTAL_KEYS; i++)
+    {
+        const config_schema_t *entry = config_schema(i);
+        for (int zone = 0; zone < entry->zones; zone++)
+        {
+            char name[24];
+
+            if (ZONE_COUNT > 1 && entry->zones > 1)
+                snprintf(name, sizeof(name), "%s[%d]", entry->key, zone);
+            else
+                strlcpy(name, entry->key, sizeof(name));
+
+            printf("%-17s %5u  [%u..%u, default %u]\n", name, config_get_zone(i, zone), entry->min, entry->max, entry->def);
+        }
+    }
+    printf("sampling period: %ds\n", GPTIMER_PERIOD_S);
+    return 0;
+}
+
+static int cmd_calibrate(int argc, char **argv)
+{
+    if (argc < 2)
+        return 1;
+
+    int zone = cmd_zone_arg(argc, argv, 2);
+    if (zone < 0)
+        return 1;
+
+    if (strcmp(argv[1], "dry") == 0 || strcmp(argv[1], "wet") == 0)
+    {
+        /* runs on the console task, the control loop keeps going */
+        int average = adc_get_average(&adcHandle, zone);
+        if (average < 0)
+        {
+            printf("the probes are being characterized\n");
+            return 1;
+        }
+
+        config_set_zone(argv[1][0] == 'd' ? CFG_SENSOR_DRY_RAW : CFG_SENSOR_WET_RAW, zone, average);
+    }
+    else if (strcmp(argv[1], "settle") == 0)
+    {
+        uint16_t settleMs[ZONE_COUNT];
+        uint32_t slowest = 0;
+
+        /* the probes share one switch, the slowest one sets the wait */
+        esp_err_t err = adc_characterize_settle(&adcHandle, settleMs);
+        for (int i = 0; i < ZONE_COUNT && err != ESP_ERR_NOT_SUPPORTED; i++)
+        {
+            printf("zone %d settles in %u ms\n", i, settleMs[i]);
+            slowest = settleMs[i] > slowest ? settleMs[i] : slowest;
+        }
+
+        if (err != ESP_OK)
+        {
+            printf("settle time not changed: %s\n", esp_err_to_name(err));
+            return 1;
+        }
+
+        const config_schema_t *entry = config_schema(CFG_SENSOR_SETTLE);
+        slowest += SENSOR_SETTLE_MARGIN_MS;
+        config_set(CFG_SENSOR_SETTLE, slowest > entry->max ? entry->max : slowest);
+        adc_set_settle(appConfig->sensorSettleMs);
+
+        printf("sensor settle time: %u ms\n", appConfig->sensorSettleMs);
+        return 0;
+    }
+    else if (strcmp(argv[1], "reset") == 0)
+    {
+        config_set_zone(CFG_SENSOR_DRY_RAW, zone, config_schema(CFG_SENSOR_DRY_RAW)->def);
+        config_set_zone(CFG_SENSOR_WET_RAW, zone, config_schema(CFG_SENSOR_WET_RAW)->def);
+    }
+    else if (strcmp(argv[1], "show") != 0)
+    {
+        return 1;
+    }
+
+    adc_set_calibration(zone, appConfig->sensorDryRaw[zone], appConfig->sensorWetRaw[zone]);
+
+    printf("zone %d calibration: dry=%u wet=%u\n", zone, appConfig->sensorDryRaw[zone], appConfig->sensorWetRaw[zone]);
+    return 0;
+}
+
+static int cmd_stats(int argc, char **argv)
+{
+    printf("uptime: %llds\n", esp_timer_get_time() / 1000000);
+    printf("free heap: %lu (min %lu)\n", (unsigned long)esp_get_free_heap_size(),
+           (unsigned long)esp_get_minimum_free_heap_size());
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+    {
+        printf("zone %d: moisture %u%%, pump runs %lu (watering: %s), auto watering %s\n", zone, lastMoisture[zone],
+               (unsigned long)pumpRuns[zone], watering[zone] ? "yes" : "no", appConfig->autoWatering[zone] ? "on" : "off");
+    }
+    printf("history: %lu/%lu records on %s\n", (unsigned long)storage_count(), (unsigned long)storage_capacity(),
+           storage_active()->name);
+    int eepromClockHz;
+    uint32_t eepromDownshifts;
+    eeprom_clock_stats(&eepromClockHz, &eepromDownshifts);
+    printf("eeprom clock: %d kHz (%lu step downs)\n", eepromClockHz / 1000, (unsigned long)eepromDownshifts);
+    uint32_t requests, acquisitions, coalesced, cached;
+    adc_broker_stats(&requests, &acquisitions, &coalesced, &cached);
+    printf("sensor requests: %lu (acquisitions %lu, shared %lu, cached %lu)\n", (unsigned long)requests,
+           (unsigned long)acquisitions, (unsigned long)coalesced, (unsigned long)cached);
+    uint32_t powerCycles;
+    int64_t powerOnUs;
+    adc_power_stats(&powerCycles, &powerOnUs);
+    if (powerCycles > 0)
+        printf("sensor power: %lu cycles, %lld ms on per cycle, %.3f%% duty\n", (unsigned long)powerCycles,
+               powerOnUs / powerCycles / 1000, 100.0 * powerOnUs / esp_timer_get_time());
+    int monitorZones;
+    uint32_t monitorAlarms;
+    adc_alarm_stats(&monitorZones, &monitorAlarms);
+    printf("moisture monitor: %d of %d zones in hardware, %lu alarms\n", monitorZones, ZONE_COUNT, (unsigned long)monitorAlarms);
+    printf("pumps running: %d of %d allowed\n", pwm_pumps_active(), ZONE_MAX_ACTIVE_PUMPS);
+    printf("shed level: %d of %d\n", deadline_level(), DEADLINE_MAX_LEVEL);
+    return 0;
+}
+
+static int cmd_bench(int argc, char **argv)
+{
+    if (argc < 2)
+        return 1;
+
+    if (benchTaskHandle != NULL)
+    {
+        printf("a benchmark is already running\n");
+        return 1;
+    }
+
+    strlcpy(benchTaskArg.name, argv[1], sizeof(benchTaskArg.name));
+    benchTaskArg.iterations = argc > 2 ? atoi(argv[2]) : 100;
+    if (benchTaskArg.iterations <= 0)
+        benchTaskArg.iterations = 100;
+
+    if (mem_task_start(MEM_TASK_BENCH, 0, bench_task, &benchTaskArg, &benchTaskHandle) != ESP_OK)
+    {
+        printf("the benchmark slot is busy, try again\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int cmd_jitter(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0)
+    {
+        jitter_reset();
+        return 0;
+    }
+
+    jitter_print();
+    return 0;
+}
+
+static int cmd_deadline(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0)
+    {
+        deadline_reset();
+        return 0;
+    }
+
+    deadline_print();
+    return 0;
+}
+
+static int cmd_latency(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "reset") == 0)
+    {
+        latency_reset();
+        return 0;
+    }
+
+    if (argc > 2 && strcmp(argv[1], "serve") == 0)
+    {
+        if (benchTaskHandle != NULL)
+        {
+            printf("a benchmark is already running\n");
+            return 1;
+        }
+
+        /* the session runs in the benchmark slot, so it never overlaps another benchmark */
+        strlcpy(latencyUri, argv[2], sizeof(latencyUri));
+        strlcpy(benchTaskArg.name, "e2e", sizeof(benchTaskArg.name));
+        benchTaskArg.iterations = argc > 3 ? atoi(argv[3]) : 600;
+        if (benchTaskArg.iterations <= 0)
+            benchTaskArg.iterations = 600;
+
+        if (mem_task_start(MEM_TASK_BENCH, 0, bench_task, &benchTaskArg, &benchTaskHandle) != ESP_OK)
+        {
+            printf("the benchmark slot is busy, try again\n");
+            return 1;
+        }
+        return 0;
+    }
+
+    if (argc > 1)
+        return 1;
+
+    latency_print();
+    return 0;
+}
+
+static int cmd_trace(int argc, char **argv)
+{
+    trace_print(argc > 1 && strcmp(argv[1], "prev") == 0);
+    return 0;
+}
+
+static int cmd_ota(int argc, char **argv)
+{
+    if (argc < 2)
+        return 1;
+
+    if (otaTaskHandle != NULL)
+    {
+        printf("an update is already running\n");
+        return 1;
+    }
+
+    strlcpy(otaUrl, argv[1], sizeof(otaUrl));
+    if (mem_task_start(MEM_TASK_OTA, 0, ota_task, otaUrl, &otaTaskHandle) != ESP_OK)
+    {
+        printf("the update slot is busy, try again\n");
+        return 1;
+    }
+    return 0;
+}
+
+static int cmd_plan(int argc, char **argv)
+{
+    int zone = cmd_zone_arg(argc, argv, 1);
+    if (zone < 0)
+        return 1;
+
+    planner_model_t model;
+    planner_model(zone, &model);
+
+    int64_t nowS = esp_timer_get_time() / 1000000;
+    printf("zone %d: level %.1f%%, drying %.2f%%/h over %lu samples%s\n", zone, model.level, -model.ratePerH,
+           (unsigned long)model.points, model.settling ? " (settling after a run)" : "");
+    printf("pump response %.2f%%/s from %lu runs\n", model.gain, (unsigned long)model.runs);
+    if (model.dueS > nowS)
+        printf("next plan in %llds\n", model.dueS - nowS);
+    printf("%lu plans, %lu brought forward by a sample\n", (unsigned long)model.plans, (unsigned long)model.early);
+    return 0;
+}
+
+static int cmd_schedule(int argc, char **argv)
+{
+    schedule_rule_t rules[SCHEDULE_MAX_RULES];
+    int count = schedule_get(rules, NULL);
+
+    if (argc == 1)
+    {
+        schedule_print();
+        return 0;
+    }
+
+    if (strcmp(argv[1], "add") == 0 && argc == 7)
+    {
+        char text[SCHEDULE_RULE_TEXT];
+        int length = snprintf(text, sizeof(text), "%s %s %s %s %s", argv[2], argv[3], argv[4], argv[5], argv[6]);
+
+        if (length >= sizeof(text) || count >= SCHEDULE_MAX_RULES || schedule_parse(text, &rules[count], 1) != 1)
+        {
+            printf("invalid rule or %d rules already set\n", SCHEDULE_MAX_RULES);
+            return 1;
+        }
+        count++;
+    }
+    else if (strcmp(argv[1], "del") == 0 && argc == 3)
+    {
+        int rule = atoi(argv[2]);
+        if (rule < 0 || rule >= count)
+        {
+            printf("no rule %d\n", rule);
+            return 1;
+        }
+        memmove(&rules[rule], &rules[rule + 1], (count - rule - 1) * sizeof(schedule_rule_t));
+        count--;
+    }
+    else if (strcmp(argv[1], "clear") == 0)
+    {
+        count = 0;
+    }
+    else
+    {
+        return 1;
+    }
+
+    esp_err_t err = schedule_set(rules, count);
+    if (err != ESP_OK)
+    {
+        printf("could not store the rules: %s\n", esp_err_to_name(err));
+        return 1;
+    }
+
+    action_post(ACTION_REPORT_CONFIG);
+    return 0;
+}
+
+static int cmd_mem(int argc, char **argv)
+{
+    mem_print();
+    return 0;
+}
+
+static int cmd_log(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        if (strcmp(argv[1], "raw") == 0)
+            tlog_set_raw(true);
+        else if (strcmp(argv[1], "text") == 0)
+            tlog_set_raw(false);
+        else
+            return 1;
+    }
+
+    tlog_stats_t stats;
+    tlog_stats(&stats);
+    printf("log: %s output, %lu events, %lu dropped, ring high water %lu/%d\n", tlog_get_raw() ? "raw" : "text",
+           (unsigned long)stats.written, (unsigned long)stats.dropped, (unsigned long)stats.highWater, TLOG_RING_SIZE);
+    return 0;
 }
@@ -0,0 +1,233 @@
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/timers.h"
+
+#include "esp_diagnostics_metrics.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "app_mem.h"
+
+#define MEM_STACK_FILL 0xa5 // tskSTACK_FILL_BYTE, FreeRTOS paints every new stack with it
+#define MEM_TLS_INDEX (configNUM_THREAD_LOCAL_STORAGE_POINTERS - 1)
+
+_Static_assert(configNUM_THREAD_LOCAL_STORAGE_POINTERS >= 2, "index 0 belongs to pthread, see sdkconfig.defaults");
+
+struct mem_slot_t
+{
+    StaticTask_t tcb;
+    StackType_t *stack;
+    mem_task_t task;
+    TaskFunction_t function;
+    void *arg;
+    volatile bool busy; // from start until the kernel is done with the TCB
+};
+typedef struct mem_slot_t mem_slot_t;
+
+struct mem_plan_t
+{
+    const char *name;
+    int instances;
+    uint32_t stackBytes;
+    UBaseType_t priority;
+    BaseType_t core;
+    StackType_t *stacks;
+    mem_slot_t *slots;
+};
+typedef struct mem_plan_t mem_plan_t;
+
+static void mem_task_entry(void *arg);
+static void mem_task_reclaimed(int index, void *arg);
+static uint32_t mem_stack_free(const mem_slot_t *slot);
+static uint32_t mem_task_free(mem_task_t task);
+static void mem_timer_cb(TimerHandle_t timer);
+
+#define MEM_TASK_STORAGE(task, name, instances, stackBytes, priority, core)                                         \
+    static StackType_t task##_stacks[(instances) * (stackBytes) / sizeof(StackType_t)] __attribute__((aligned(16))); \
+    static mem_slot_t task##_slots[instances];
+#define MEM_TASK_PLAN(task, name, instances, stackBytes, priority, core) \
+    [task] = {name, instances, stackBytes, priority, core, task##_stacks, task##_slots},
+#define MEM_TASK_BYTES(task, name, instances, stackBytes, priority, core) +(instances) * (stackBytes)
+#define MEM_STACK_TOTAL (0 MEM_TASKS(MEM_TASK_BYTES))
+
+MEM_TASKS(MEM_TASK_STORAGE)
+
+static const mem_plan_t plan[MEM_TOTAL_TASKS] = {MEM_TASKS(MEM_TASK_PLAN)};
+
+static volatile uint32_t minFree[MEM_TOTAL_TASKS]; // lowest free stack over every run of every instance, UINT32_MAX until one ran
+
+static TaskHandle_t mainTask = NULL; // its stack comes from the system, only watched
+static StaticTimer_t reportTimerBuffer;
+static TimerHandle_t reportTimer = NULL;
+
+static const char *TAG = "ASE-PROJECT-MEM";
+
+/*---------------------------------------------------------------
+        Memory Plan Initialization
+---------------------------------------------------------------*/
+void mem_init(void)
+{
+    for (int task = 0; task < MEM_TOTAL_TASKS; task++)
+    {
+        minFree[task] = UINT32_MAX;
+
+        for (int i = 0; i < plan[task].instances; i++)
+        {
+            plan[task].slots[i].stack = plan[task].stacks + i * plan[task].stackBytes / sizeof(StackType_t);
+            plan[task].slots[i].task = task;
+        }
+    }
+
+    mainTask = xTaskGetCurrentTaskHandle();
+
+    reportTimer = xTimerCreateStatic("Mem_Report", pdMS_TO_TICKS(1000 * MEM_REPORT_PERIOD_S), pdTRUE, NULL, mem_timer_cb,
+                                     &reportTimerBuffer);
+    xTimerStart(reportTimer, 0);
+
+    ESP_LOGI(TAG, "%d bytes of static task stacks", MEM_STACK_TOTAL);
+}
+
+/*---------------------------------------------------------------
+        Task Slots
+---------------------------------------------------------------*/
+esp_err_t mem_task_start(mem_task_t task, int instance, TaskFunction_t function, void *arg, TaskHandle_t *handle)
+{
+    const mem_plan_t *entry = &plan[task];
+    mem_slot_t *slot = &entry->slots[instance];
+
+    /* a task that deleted itself stays on the termination list until the idle task runs */
+    for (int waited = 0; slot->busy; waited++)
+    {
+        if (waited >= MEM_RECLAIM_WAIT_MS)
+        {
+            ESP_LOGE(TAG, "%s slot %d still in use", entry->name, instance);
+            return ESP_ERR_TIMEOUT;
+        }
+        vTaskDelay(pdMS_TO_TICKS(1));
+    }
+
+    slot->busy = true;
+    slot->function = function;
+    slot->arg = arg;
+
+    /* a static TCB is its own handle, publish it before the task can run like xTaskCreate does */
+    *handle = (TaskHandle_t)&slot->tcb;
+    xTaskCreateStaticPinnedToCore(mem_task_entry, entry->name, entry->stackBytes, slot, entry->priority, slot->stack, &slot->tcb,
+                                  entry->core);
+
+    return ESP_OK;
+}
+
+static void mem_task_entry(void *arg)
+{
+    mem_slot_t *slot = (mem_slot_t *)arg;
+
+    /* called by the kernel once the TCB is released, every app task deletes itself */
+    vTaskSetThreadLocalStoragePointerAndDelCallback(NULL, MEM_TLS_INDEX, slot, mem_task_reclaimed);
+
+    slot->function(slot->arg);
+    vTaskDelete(NULL);
+}
+
+static void mem_task_reclaimed(int index, void *arg)
+{
+    mem_slot_t *slot = (mem_slot_t *)arg;
+    uint32_t left = mem_stack_free(slot);
+
+    if (left < minFree[slot->task])
+        minFree[slot->task] = left;
+
+    slot->busy = false;
+}
+
+static uint32_t mem_stack_free(const mem_slot_t *slot)
+{
+    const uint8_t *stack = (const uint8_t *)slot->stack;
+    uint32_t left = 0;
+
+    /* stacks grow down, the bottom still holding the paint was never touched */
+    while (left < plan[slot->task].stackBytes && stack[left] == MEM_STACK_FILL)
+        left++;
+
+    return left;
+}
+
+static uint32_t mem_task_free(mem_task_t task)
+{
+    uint32_t left = minFree[task];
+
+    for (int i = 0; i < plan[task].instances; i++)
+    {
+        if (plan[task].slots[i].busy)
+        {
+            uint32_t live = mem_stack_free(&plan[task].slots[i]);
+            left = live < left ? live : left;
+        }
+    }
+
+    return left;
+}
+
+/*---------------------------------------------------------------
+        Telemetry
+---------------------------------------------------------------*/
+void mem_report(void)
+{
+    static bool registered = false;
+
+    /* heap free, minimum and largest block are uploaded by the insights heap metrics */
+    if (!registered)
+    {
+        registered = esp_diag_metrics_register("memory", "main_stack", "main free stack", "app.stack", ESP_DIAG_DATA_TYPE_UINT) == ESP_OK;
+        for (int task = 0; task < MEM_TOTAL_TASKS && registered; task++)
+            esp_diag_metrics_register("memory", plan[task].name, plan[task].name, "app.stack", ESP_DIAG_DATA_TYPE_UINT);
+    }
+
+    for (int task = 0; task < MEM_TOTAL_TASKS; task++)
+    {
+        uint32_t left = mem_task_free(task);
+        if (left == UINT32_MAX)
+            continue;
+
+        if (registered)
+            esp_diag_metrics_add_uint(plan[task].name, left);
+        if (left < MEM_STACK_MARGIN)
+            ESP_LOGW(TAG, "%s has %lu of %lu stack bytes left", plan[task].name, (unsigned long)left,
+                     (unsigned long)plan[task].stackBytes);
+    }
+
+    if (registered)
+        esp_diag_metrics_add_uint("main_stack", uxTaskGetStackHighWaterMark(mainTask));
+
+    size_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_8BIT);
+    if (largest < MEM_HEAP_LARGEST_MIN)
+        ESP_LOGW(TAG, "heap fragmented, largest block %zu of %zu free", largest, heap_caps_get_free_size(MALLOC_CAP_8BIT));
+}
+
+void mem_print(void)
+{
+    printf("%-14s %5s %7s %9s\n", "task", "slots", "stack", "min free");
+    for (int task = 0; task < MEM_TOTAL_TASKS; task++)
+    {
+        uint32_t left = mem_task_free(task);
+
+        if (left == UINT32_MAX)
+            printf("%-14s %5d %7lu %9s\n", plan[task].name, plan[task].instances, (unsigned long)plan[task].stackBytes, "-");
+        else
+            printf("%-14s %5d %7lu %9lu\n", plan[task].name, plan[task].instances, (unsigned long)plan[task].stackBytes,
+                   (unsigned long)left);
+    }
+    printf("%-14s %5s %7s %9u\n", "main", "-", "system", uxTaskGetStackHighWaterMark(mainTask));
+
+    printf("static stacks: %d bytes\n", MEM_STACK_TOTAL);
+    printf("heap: %zu free, %zu minimum ever, largest block %zu\n", heap_caps_get_free_size(MALLOC_CAP_8BIT),
+           heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT), heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+}
+
+static void mem_timer_cb(TimerHandle_t timer)
+{
+    mem_report();
+}
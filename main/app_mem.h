@@ -0,0 +1,49 @@
+#pragma once
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_err.h"
+
+#include "app_tasks.h"
+#include "app_zones.h"
+
+#define MEM_RECLAIM_WAIT_MS 100     // longest wait for the idle task to release a slot a task just left
+#define MEM_REPORT_PERIOD_S 60      // stack metrics upload period
+#define MEM_STACK_MARGIN 512        // free stack bytes below which a task is reported
+#define MEM_HEAP_LARGEST_MIN 16384  // largest free block below which fragmentation is reported
+
+/*
+ * Static memory plan. Every app task runs on a stack and TCB reserved at
+ * build time, so a fragmented heap can never keep a sample or a pump from
+ * starting. Stack sizes are in bytes, as ESP-IDF counts them; check the
+ * margins with `mem` or the insights metrics before changing one. The
+ * sizes leave about 1.5 KiB over the deepest path: the RainMaker report
+ * in the sensor task, the planner and status report in a pump task and
+ * printf in the history dump, whose buffers live in its static argument.
+ *
+ * X(task, name, instances, stack bytes, priority, core)
+ */
+#define MEM_TASKS(X)                                                                          \
+    X(MEM_TASK_SENSOR, "Sensor_Task", 1, 6144, TASK_PRIO_SENSOR, TASK_CORE_CONTROL)          \
+    X(MEM_TASK_PUMP, "Pump_Task", ZONE_COUNT, 4096, TASK_PRIO_PUMP, TASK_CORE_CONTROL)       \
+    X(MEM_TASK_HISTORY, "History_Task", 1, 4096, TASK_PRIO_HISTORY, TASK_CORE_NETWORK)       \
+    X(MEM_TASK_EXPORT, "Export_Task", 1, 4096, TASK_PRIO_EXPORT, TASK_CORE_NETWORK)          \
+    X(MEM_TASK_BENCH, "Bench_Task", 1, 4096, TASK_PRIO_BENCH, TASK_CORE_NETWORK)             \
+    X(MEM_TASK_OTA, "Ota_Task", 1, 6144, TASK_PRIO_OTA, TASK_CORE_NETWORK)                   \
+    X(MEM_TASK_CONSOLE, "Console_Task", 1, 4096, TASK_PRIO_CONSOLE, TASK_CORE_NETWORK)       \
+    X(MEM_TASK_LOG, "Tlog_Task", 1, 3072, TASK_PRIO_LOG, TASK_CORE_NETWORK)
+
+#define MEM_TASK_ENUM(task, name, instances, stackBytes, priority, core) task,
+
+enum mem_task_t
+{
+    MEM_TASKS(MEM_TASK_ENUM)
+    MEM_TOTAL_TASKS,
+};
+typedef enum mem_task_t mem_task_t;
+
+void mem_init(void);
+esp_err_t mem_task_start(mem_task_t task, int instance, TaskFunction_t function, void *arg, TaskHandle_t *handle);
+void mem_report(void);
+void mem_print(void);
@@ -0,0 +1,283 @@
+#include <math.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_timer.h"
+
+#include "app_planner.h"
+
+#define US_PER_H 3600e6
+#define PLAN_MIN_GAIN 0.05 // % per pump second, below it a run could not be sized
+#define PLAN_MIN_RATE 0.01 // %/h of drying below which no crossing is predicted
+
+struct planner_zone_t
+{
+    /* weighted sums of the dry-down segment, t in hours from the newest sample */
+    double s0, s1, s2, sm, stm;
+    int64_t lastUs;
+    uint32_t points;
+    double ratePerH; // kept from the previous segment until the current one is long enough
+    double level;    // at lastUs
+
+    /* pump response, rise = gain * seconds */
+    double sdd, sdr;
+    uint32_t runs;
+
+    /* run whose effect is not measured yet */
+    bool settling;
+    int64_t settleUntilUs;
+    int64_t wateredUs;
+    double before; // level the zone would have had without the run
+    uint8_t duration;
+
+    uint8_t target;
+    int64_t dueUs;
+    bool crossing; // dueUs is a predicted crossing, not the re-plan bound
+    uint32_t plans;
+    uint32_t early;
+};
+typedef struct planner_zone_t planner_zone_t;
+
+static double planner_level(const planner_zone_t *z, int64_t nowUs);
+static uint32_t planner_wait(const planner_zone_t *z, int64_t nowUs);
+static uint8_t planner_duration(const planner_zone_t *z, uint8_t target, double level);
+
+static planner_zone_t zones[ZONE_COUNT];
+/* a mutex, not a spinlock: the updates run double-precision exp and divisions that would keep interrupts masked */
+static SemaphoreHandle_t plannerLock = NULL;
+static StaticSemaphore_t plannerLockBuffer;
+
+/*---------------------------------------------------------------
+        Planner Initialization
+---------------------------------------------------------------*/
+void planner_init(void)
+{
+    memset(zones, 0, sizeof(zones));
+    plannerLock = xSemaphoreCreateMutexStatic(&plannerLockBuffer);
+
+    /* one imaginary 20 s run at the prior gain, the first real runs outweigh it quickly */
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+    {
+        zones[zone].sdd = 20.0 * 20.0;
+        zones[zone].sdr = PLAN_GAIN_PRIOR * zones[zone].sdd;
+    }
+}
+
+/*---------------------------------------------------------------
+        Model Updates
+---------------------------------------------------------------*/
+bool planner_sample(int zone, uint8_t moisture)
+{
+    planner_zone_t *z = &zones[zone];
+    int64_t nowUs = esp_timer_get_time();
+    bool early = false;
+
+    xSemaphoreTake(plannerLock, portMAX_DELAY);
+
+    /* the soil keeps taking water in after the pump stops, such samples fit neither line */
+    if (z->settling && nowUs < z->settleUntilUs)
+    {
+        xSemaphoreGive(plannerLock);
+        return false;
+    }
+
+    if (z->settling)
+    {
+        /* rise over the dry-down the run interrupted */
+        double rise = moisture - (z->before + z->ratePerH * (nowUs - z->wateredUs) / US_PER_H);
+
+        z->sdd = PLAN_GAIN_FORGET * z->sdd + (double)z->duration * z->duration;
+        z->sdr = PLAN_GAIN_FORGET * z->sdr + z->duration * rise;
+        z->runs++;
+        z->settling = false;
+
+        /* a new segment starts at the watered level */
+        z->s0 = z->s1 = z->s2 = z->sm = z->stm = 0;
+        z->points = 0;
+    }
+
+    if (z->points > 0)
+    {
+        double dt = (nowUs - z->lastUs) / US_PER_H;
+        double decay = exp(-(nowUs - z->lastUs) / (1e6 * PLAN_WINDOW_S));
+
+        /* move the origin to the new sample, the older ones end up at negative times */
+        z->s2 = (z->s2 - 2 * dt * z->s1 + dt * dt * z->s0) * decay;
+        z->s1 = (z->s1 - dt * z->s0) * decay;
+        z->stm = (z->stm - dt * z->sm) * decay;
+        z->s0 *= decay;
+        z->sm *= decay;
+    }
+
+    z->s0 += 1;
+    z->sm += moisture;
+    z->points++;
+    z->lastUs = nowUs;
+
+    /* the segment's own slope once it spans enough time, the previous one until then */
+    double den = z->s0 * z->s2 - z->s1 * z->s1;
+    double minVariance = (PLAN_MIN_SPAN_S / 3600.0) * (PLAN_MIN_SPAN_S / 3600.0) / 12; // of evenly spread sample times
+    if (z->points >= PLAN_MIN_POINTS && den > minVariance * z->s0 * z->s0)
+        z->ratePerH = (z->s0 * z->stm - z->s1 * z->sm) / den;
+    z->level = (z->sm - z->ratePerH * z->s1) / z->s0;
+
+    /* wake the pump task when the crossing moved earlier than the time it sleeps until */
+    if (z->dueUs != 0 && nowUs + 1000000LL * (planner_wait(z, nowUs) + PLAN_EARLY_S) < z->dueUs)
+    {
+        z->dueUs = 0;
+        z->early++;
+        early = true;
+    }
+
+    xSemaphoreGive(plannerLock);
+
+    return early;
+}
+
+void planner_watered(int zone, uint8_t durationS, uint16_t settleS)
+{
+    planner_zone_t *z = &zones[zone];
+    int64_t nowUs = esp_timer_get_time();
+
+    xSemaphoreTake(plannerLock, portMAX_DELAY);
+
+    /* a run before any sample has nothing to measure against */
+    if (z->points > 0 || z->settling)
+    {
+        z->before = z->settling ? z->before + z->ratePerH * (nowUs - z->wateredUs) / US_PER_H : planner_level(z, nowUs);
+        z->duration = z->settling ? z->duration + durationS : durationS;
+        z->wateredUs = nowUs;
+        z->settleUntilUs = nowUs + 1000000LL * settleS;
+        z->settling = true;
+    }
+    z->dueUs = 0;
+
+    xSemaphoreGive(plannerLock);
+}
+
+/*---------------------------------------------------------------
+        Predictions
+---------------------------------------------------------------*/
+void planner_plan(int zone, uint8_t target, planner_plan_t *plan)
+{
+    planner_zone_t *z = &zones[zone];
+    int64_t nowUs = esp_timer_get_time();
+
+    xSemaphoreTake(plannerLock, portMAX_DELAY);
+
+    z->target = target;
+    z->plans++;
+
+    uint32_t waitS = planner_wait(z, nowUs);
+    double level = planner_level(z, nowUs);
+
+    /* sized for the level at the crossing, the target itself when it lies ahead */
+    double atRun = waitS > 0 && level > target ? target : level;
+
+    plan->waitS = waitS;
+    plan->durationS = planner_duration(z, target, atRun);
+    plan->level = level < 0 ? 0 : level > 100 ? 100 : (uint8_t)lround(level);
+
+    z->dueUs = waitS > 0 ? nowUs + 1000000LL * waitS : 0;
+    z->crossing = waitS > 0 && waitS < PLAN_MAX_WAIT_S;
+
+    xSemaphoreGive(plannerLock);
+}
+
+/* run length to bring the zone up to the target now, the pump task's plan is left alone */
+bool planner_size(int zone, uint8_t target, planner_plan_t *plan)
+{
+    const planner_zone_t *z = &zones[zone];
+    int64_t nowUs = esp_timer_get_time();
+    bool known;
+
+    xSemaphoreTake(plannerLock, portMAX_DELAY);
+
+    /* the level is only trusted from a settled sample on */
+    known = z->points > 0 && !z->settling;
+    double level = planner_level(z, nowUs);
+
+    plan->waitS = 0;
+    plan->durationS = level < target ? planner_duration(z, target, level) : 0;
+    plan->level = level < 0 ? 0 : level > 100 ? 100 : (uint8_t)lround(level);
+
+    xSemaphoreGive(plannerLock);
+
+    return known;
+}
+
+void planner_model(int zone, planner_model_t *model)
+{
+    const planner_zone_t *z = &zones[zone];
+    int64_t nowUs = esp_timer_get_time();
+
+    xSemaphoreTake(plannerLock, portMAX_DELAY);
+
+    model->level = planner_level(z, nowUs);
+    model->ratePerH = z->ratePerH;
+    model->gain = z->sdr / z->sdd;
+    model->points = z->points;
+    model->runs = z->runs;
+    model->dueS = z->dueUs / 1000000;
+    model->plans = z->plans;
+    model->early = z->early;
+    model->settling = z->settling;
+
+    xSemaphoreGive(plannerLock);
+}
+
+/* earliest crossing a pump task sleeps until, us since boot, 0 when none */
+int64_t planner_next_crossing(void)
+{
+    int64_t dueUs = 0;
+
+    xSemaphoreTake(plannerLock, portMAX_DELAY);
+
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+    {
+        const planner_zone_t *z = &zones[zone];
+
+        if (z->dueUs != 0 && z->crossing && (dueUs == 0 || z->dueUs < dueUs))
+            dueUs = z->dueUs;
+    }
+
+    xSemaphoreGive(plannerLock);
+
+    return dueUs;
+}
+
+static double planner_level(const planner_zone_t *z, int64_t nowUs)
+{
+    return z->level + z->ratePerH * (nowUs - z->lastUs) / US_PER_H;
+}
+
+static uint8_t planner_duration(const planner_zone_t *z, uint8_t target, double level)
+{
+    double gain = z->sdr / z->sdd;
+    gain = gain < PLAN_MIN_GAIN ? PLAN_MIN_GAIN : gain;
+
+    double seconds = ceil((target + PLAN_BAND - level) / gain);
+    seconds = seconds < PLAN_MIN_PUMP_S ? PLAN_MIN_PUMP_S : seconds;
+    seconds = seconds > PLAN_MAX_PUMP_S ? PLAN_MAX_PUMP_S : seconds;
+
+    return (uint8_t)seconds;
+}
+
+static uint32_t planner_wait(const planner_zone_t *z, int64_t nowUs)
+{
+    /* nothing to extrapolate from until a settled sample arrives, that sample wakes the task */
+    if (z->points == 0 || z->settling)
+        return PLAN_MAX_WAIT_S;
+
+    double level = planner_level(z, nowUs);
+    if (level < z->target)
+        return 0;
+    if (z->ratePerH > -PLAN_MIN_RATE)
+        return PLAN_MAX_WAIT_S;
+
+    double waitS = (level - z->target) / -z->ratePerH * 3600;
+    return waitS > PLAN_MAX_WAIT_S ? PLAN_MAX_WAIT_S : (uint32_t)waitS;
+}
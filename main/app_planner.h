@@ -0,0 +1,56 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "app_zones.h"
+
+#define PLAN_WINDOW_S (6 * 3600)  // dry-down samples older than this weigh less than 1/e
+#define PLAN_MIN_POINTS 30        // samples in a dry-down segment before its slope replaces the previous one
+#define PLAN_MIN_SPAN_S 900       // and the time they must cover
+#define PLAN_GAIN_PRIOR 0.5       // % per pump second until a run has been measured
+#define PLAN_GAIN_FORGET 0.8      // weight left to older runs at each new one
+#define PLAN_BAND 5               // % above the target a run aims for, so it does not refire at once
+#define PLAN_MIN_PUMP_S 5
+#define PLAN_MAX_PUMP_S 255
+#define PLAN_MAX_WAIT_S (30 * 60) // longest sleep between two plans, bounds a wrong or missing model
+#define PLAN_EARLY_S 60           // a sample moving the crossing earlier than this wakes the pump task
+#define PLAN_SAMPLE_LEAD_MS 500   // an extra sample is stored and fitted this long before a crossing
+
+/*
+ * Predictive watering. Per zone, a least-squares line through the samples
+ * since the last run gives the smoothed moisture and the dry-down rate, and
+ * a line through the origin of (pump seconds, rise) over the past runs gives
+ * the pump response. Both are kept as exponentially weighted running sums,
+ * so each sample and each run is O(1) and nothing is re-read from history.
+ * A predicted crossing that falls between two periodic samples gets an
+ * extra sample just before it, so the run is sized on a measured level.
+ */
+struct planner_plan_t
+{
+    uint32_t waitS;    // 0 when the zone is below the target now
+    uint8_t durationS; // pump time once due
+    uint8_t level;     // smoothed moisture %
+};
+typedef struct planner_plan_t planner_plan_t;
+
+struct planner_model_t
+{
+    float level;      // smoothed moisture % now
+    float ratePerH;   // dry-down slope, negative while drying, 0 while unknown
+    float gain;       // % per pump second
+    uint32_t points;  // samples in the current dry-down segment
+    uint32_t runs;    // runs measured for the gain
+    int64_t dueS;     // planned wake, s since boot, 0 when no task waits on it
+    uint32_t plans;   // times the pump task woke up to plan
+    uint32_t early;   // wakes brought forward by a sample
+    bool settling;    // soil still responding to the last run
+};
+typedef struct planner_model_t planner_model_t;
+
+void planner_init(void);
+bool planner_sample(int zone, uint8_t moisture);
+void planner_plan(int zone, uint8_t target, planner_plan_t *plan);
+bool planner_size(int zone, uint8_t target, planner_plan_t *plan);
+void planner_watered(int zone, uint8_t durationS, uint16_t settleS);
+void planner_model(int zone, planner_model_t *model);
+int64_t planner_next_crossing(void);
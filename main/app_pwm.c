@@ -1,11 +1,18 @@
+#include "freertos/semphr.h"
+
 #include "app_pwm.h"
+#include "app_zones.h"
+
+/* one token per pump the supply can feed at once */
+static SemaphoreHandle_t pumpTokens = NULL;
+static StaticSemaphore_t pumpTokensBuffer;
 
 /*---------------------------------------------------------------
         PWM Creation
 ---------------------------------------------------------------*/
 void pwm_init(void)
 {
-    // Prepare and then apply the PWM timer configuration
+    // Prepare and then apply the PWM timer configuration, shared by every zone
     ledc_timer_config_t pwm_timer = {
         .speed_mode = PWM_MODE,
         .timer_num = PWM_TIMER,
@@ -14,23 +21,52 @@ void pwm_init(void)
         .clk_cfg = LEDC_AUTO_CLK};
     ESP_ERROR_CHECK(ledc_timer_config(&pwm_timer));
 
-    // Prepare and then apply the PWM channel configuration
-    ledc_channel_config_t pwm_channel = {
-        .speed_mode = PWM_MODE,
-        .channel = PWM_CHANNEL,
-        .timer_sel = PWM_TIMER,
-        .intr_type = LEDC_INTR_DISABLE,
-        .gpio_num = PWM_OUTPUT_IO,
-        .duty = PWM_0_DUTY, // Set duty to 0%
-        .hpoint = 0};
-    ESP_ERROR_CHECK(ledc_channel_config(&pwm_channel));
+    // Prepare and then apply one PWM channel configuration per zone
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+    {
+        ledc_channel_config_t pwm_channel = {
+            .speed_mode = PWM_MODE,
+            .channel = zoneTable->pumpChannel[zone],
+            .timer_sel = PWM_TIMER,
+            .intr_type = LEDC_INTR_DISABLE,
+            .gpio_num = zoneTable->pumpGpio[zone],
+            .duty = PWM_0_DUTY, // Set duty to 0%
+            .hpoint = 0};
+        ESP_ERROR_CHECK(ledc_channel_config(&pwm_channel));
+    }
+
+    pumpTokens = xSemaphoreCreateCountingStatic(ZONE_MAX_ACTIVE_PUMPS, ZONE_MAX_ACTIVE_PUMPS, &pumpTokensBuffer);
 }
 
-void pwm_set_duty(uint16_t duty)
+void pwm_set_duty(int zone, uint16_t duty)
 {
     if (duty > PWM_100_DUTY)
         duty = PWM_100_DUTY;
 
-    ESP_ERROR_CHECK(ledc_set_duty(PWM_MODE, PWM_CHANNEL, duty));
-    ESP_ERROR_CHECK(ledc_update_duty(PWM_MODE, PWM_CHANNEL));
-}
\ No newline at end of file
+    ESP_ERROR_CHECK(ledc_set_duty(PWM_MODE, zoneTable->pumpChannel[zone], duty));
+    ESP_ERROR_CHECK(ledc_update_duty(PWM_MODE, zoneTable->pumpChannel[zone]));
+}
+
+/* duty the channel outputs now, the pump is on for anything but 0 */
+uint32_t pwm_get_duty(int zone)
+{
+    return ledc_get_duty(PWM_MODE, zoneTable->pumpChannel[zone]);
+}
+
+/*---------------------------------------------------------------
+        Pump Supply Policy
+---------------------------------------------------------------*/
+bool pwm_pump_acquire(TickType_t timeout)
+{
+    return xSemaphoreTake(pumpTokens, timeout) == pdTRUE;
+}
+
+void pwm_pump_release(void)
+{
+    xSemaphoreGive(pumpTokens);
+}
+
+int pwm_pumps_active(void)
+{
+    return ZONE_MAX_ACTIVE_PUMPS - uxSemaphoreGetCount(pumpTokens);
+}
@@ -1,9 +1,10 @@
+#include <stdbool.h>
+
+#include "freertos/FreeRTOS.h"
 #include "driver/ledc.h"
 
 #define PWM_TIMER LEDC_TIMER_0
 #define PWM_MODE LEDC_LOW_SPEED_MODE
-#define PWM_OUTPUT_IO (19) // Define the output GPIO
-#define PWM_CHANNEL LEDC_CHANNEL_0
 #define PWM_DUTY_RES LEDC_TIMER_13_BIT // Set duty resolution to 13 bits
 #define PWM_0_DUTY (0)
 #define PWM_25_DUTY (2047)
@@ -13,4 +14,8 @@
 #define PWM_FREQUENCY (5000) // Frequency in Hertz. Set frequency at 5 kHz
 
 void pwm_init();
-void pwm_set_duty(uint16_t duty);
\ No newline at end of file
+void pwm_set_duty(int zone, uint16_t duty);
+uint32_t pwm_get_duty(int zone);
+bool pwm_pump_acquire(TickType_t timeout);
+void pwm_pump_release(void);
+int pwm_pumps_active(void);
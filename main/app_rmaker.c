@@ -1,23 +1,55 @@
+#include <stdint.h>
+#include <stdio.h>
 #include <string.h>
 
+#include "cJSON.h"
 #include "esp_log.h"
 
+#include "app_config.h"
+#include "app_delta.h"
+#include "app_schedule.h"
 #include "app_rmaker.h"
-
-void rmaker_add_auto_watering_switch(esp_rmaker_node_t *node, void *auto_watering_write_cb);
-void rmaker_add_current_moisture(esp_rmaker_node_t *node, void *current_moisture_cb);
-void rmaker_add_manual_watering(esp_rmaker_node_t *node, void *manual_watering_cb);
-
-static esp_rmaker_device_t *autoWateringSwitchDevice;
-static esp_rmaker_device_t *currentMoistureInfoDevice;
-static esp_rmaker_device_t *manualWateringDevice;
+#include "app_tlog.h"
+#include "app_trace.h"
+
+void rmaker_add_auto_watering_switch(esp_rmaker_node_t *node, int zone);
+void rmaker_add_current_moisture(esp_rmaker_node_t *node, int zone);
+void rmaker_add_manual_watering(esp_rmaker_node_t *node, int zone);
+void rmaker_add_history_export(esp_rmaker_node_t *node);
+void rmaker_add_schedule(esp_rmaker_node_t *node);
+static const char *rmaker_zone_name(char *buffer, size_t size, const char *name, int zone);
+static esp_rmaker_param_t *rmaker_param_add(const esp_rmaker_device_t *device, rmaker_param_id_t param, int zone,
+                                            esp_rmaker_param_val_t val, uint8_t properties);
+static esp_err_t rmaker_write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
+                                 const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx);
+static const esp_rmaker_device_t *rmaker_find_device(const char *name, int *zone);
+
+/* one device of each kind per zone, the zone index is the device private data */
+static esp_rmaker_device_t *autoWateringSwitchDevice[ZONE_COUNT];
+static esp_rmaker_device_t *currentMoistureInfoDevice[ZONE_COUNT];
+static esp_rmaker_device_t *manualWateringDevice[ZONE_COUNT];
+static esp_rmaker_device_t *historyExportDevice;
+static esp_rmaker_device_t *scheduleDevice;
+
+#define RMAKER_PARAM_NAME(param, name, type) [param] = name,
+#define RMAKER_PARAM_TYPE(param, name, type) [param] = type,
+
+static const char *paramNames[RMAKER_TOTAL_PARAMS] = {RMAKER_PARAMS(RMAKER_PARAM_NAME)};
+static const char *paramTypes[RMAKER_TOTAL_PARAMS] = {RMAKER_PARAMS(RMAKER_PARAM_TYPE)};
+
+/* handles resolved once while the devices are built, History parameters use zone 0 */
+static esp_rmaker_param_t *params[RMAKER_TOTAL_PARAMS][ZONE_COUNT];
+static rmaker_handler_t handlers[RMAKER_TOTAL_PARAMS];
 
 static const char *TAG = "ASE-PROJECT-RMAKER";
 
-void rmaker_init(void *auto_watering_write_cb, void *current_moisture_cb, void *manual_watering_cb)
+void rmaker_init(const rmaker_handler_t *writeHandlers, int count)
 {
     esp_err_t err;
 
+    for (int i = 0; i < count; i++)
+        handlers[writeHandlers[i].param] = writeHandlers[i];
+
     /* Initialize Wi-Fi. Note that, this should be called before esp_rmaker_init() */
     app_wifi_init();
 
@@ -35,15 +67,26 @@ void rmaker_init(void *auto_watering_write_cb, void *current_moisture_cb, void *
         abort();
     }
 
-    rmaker_add_auto_watering_switch(node, auto_watering_write_cb);
+    /* diagnostics upload, it also carries the flight recorder of the previous boot */
+    app_insights_enable();
+
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+    {
+        rmaker_add_auto_watering_switch(node, zone);
+
+        rmaker_add_current_moisture(node, zone);
 
-    rmaker_add_current_moisture(node, current_moisture_cb);
+        rmaker_add_manual_watering(node, zone);
+    }
+
+    rmaker_add_history_export(node);
 
-    rmaker_add_manual_watering(node, manual_watering_cb);
+    rmaker_add_schedule(node);
 
     /* Enable OTA */
     esp_rmaker_ota_config_t ota_config = {
         .server_cert = ESP_RMAKER_OTA_DEFAULT_SERVER_CERT,
+        .ota_cb = delta_rmaker_ota_cb, // takes both patches and full images
     };
     esp_rmaker_ota_enable(&ota_config, OTA_USING_TOPICS);
 
@@ -74,96 +117,337 @@ void rmaker_init(void *auto_watering_write_cb, void *current_moisture_cb, void *
     tzset();
 }
 
-void rmaker_add_auto_watering_switch(esp_rmaker_node_t *node, void *auto_watering_write_cb)
+static const char *rmaker_zone_name(char *buffer, size_t size, const char *name, int zone)
+{
+    /* single-zone boards keep the original names */
+    if (ZONE_COUNT == 1)
+        return name;
+
+    snprintf(buffer, size, "%s %d", name, zone + 1);
+    return buffer;
+}
+
+void rmaker_add_auto_watering_switch(esp_rmaker_node_t *node, int zone)
 {
-    autoWateringSwitchDevice = esp_rmaker_device_create("Auto Watering", ESP_RMAKER_DEVICE_SWITCH, NULL);
+    char zoneName[32];
 
-    esp_rmaker_device_add_cb(autoWateringSwitchDevice, auto_watering_write_cb, NULL);
+    esp_rmaker_device_t *device = esp_rmaker_device_create(rmaker_zone_name(zoneName, sizeof(zoneName), "Auto Watering", zone), ESP_RMAKER_DEVICE_SWITCH, (void *)(intptr_t)zone);
+    autoWateringSwitchDevice[zone] = device;
 
-    esp_rmaker_device_add_param(autoWateringSwitchDevice, esp_rmaker_name_param_create("Name", "Auto Watering"));
+    esp_rmaker_device_add_cb(device, rmaker_write_cb, NULL);
 
-    esp_rmaker_param_t *powerParam = esp_rmaker_power_param_create(ESP_RMAKER_DEF_POWER_NAME, DEFAULT_AUTO_WATERING_POWER);
-    esp_rmaker_device_add_param(autoWateringSwitchDevice, powerParam);
-    esp_rmaker_device_assign_primary_param(autoWateringSwitchDevice, powerParam);
+    esp_rmaker_device_add_param(device, esp_rmaker_name_param_create("Name", rmaker_zone_name(zoneName, sizeof(zoneName), "Auto Watering", zone)));
 
-    esp_rmaker_node_add_device(node, autoWateringSwitchDevice);
+    esp_rmaker_param_t *powerParam = esp_rmaker_power_param_create(paramNames[RMAKER_PARAM_AUTO_WATERING], appConfig->autoWatering[zone]);
+    esp_rmaker_device_add_param(device, powerParam);
+    esp_rmaker_device_assign_primary_param(device, powerParam);
+    params[RMAKER_PARAM_AUTO_WATERING][zone] = powerParam;
+
+    esp_rmaker_node_add_device(node, device);
 }
 
-void rmaker_add_current_moisture(esp_rmaker_node_t *node, void *current_moisture_cb)
+void rmaker_add_current_moisture(esp_rmaker_node_t *node, int zone)
 {
-    currentMoistureInfoDevice = esp_rmaker_device_create("Current Moisture", NULL, NULL);
+    char zoneName[32];
+
+    esp_rmaker_device_t *device = esp_rmaker_device_create(rmaker_zone_name(zoneName, sizeof(zoneName), "Current Moisture", zone), NULL, (void *)(intptr_t)zone);
+    currentMoistureInfoDevice[zone] = device;
 
-    esp_rmaker_device_add_cb(currentMoistureInfoDevice, current_moisture_cb, NULL);
+    esp_rmaker_device_add_cb(device, rmaker_write_cb, NULL);
 
-    esp_rmaker_device_add_param(currentMoistureInfoDevice, esp_rmaker_name_param_create("name", "Moisture Sensor"));
+    esp_rmaker_device_add_param(device, esp_rmaker_name_param_create("name", rmaker_zone_name(zoneName, sizeof(zoneName), "Moisture Sensor", zone)));
 
-    esp_rmaker_param_t *moistureParam = esp_rmaker_param_create("Moisture (%)", "MoistureSensor", esp_rmaker_int(0), PROP_FLAG_READ | PROP_FLAG_TIME_SERIES);
+    esp_rmaker_param_t *moistureParam = rmaker_param_add(device, RMAKER_PARAM_MOISTURE, zone, esp_rmaker_int(0), PROP_FLAG_READ | PROP_FLAG_TIME_SERIES);
     esp_rmaker_param_add_ui_type(moistureParam, ESP_RMAKER_UI_TEXT);
-    esp_rmaker_device_add_param(currentMoistureInfoDevice, moistureParam);
-    esp_rmaker_device_assign_primary_param(currentMoistureInfoDevice, moistureParam);
+    esp_rmaker_device_assign_primary_param(device, moistureParam);
 
-    esp_rmaker_param_t *triggerParam = esp_rmaker_param_create("trigger reading", "TriggerReading", esp_rmaker_bool(false), PROP_FLAG_READ | PROP_FLAG_WRITE);
+    esp_rmaker_param_t *triggerParam = rmaker_param_add(device, RMAKER_PARAM_TRIGGER_READING, zone, esp_rmaker_bool(false), PROP_FLAG_READ | PROP_FLAG_WRITE);
     esp_rmaker_param_add_ui_type(triggerParam, ESP_RMAKER_UI_TRIGGER);
-    esp_rmaker_device_add_param(currentMoistureInfoDevice, triggerParam);
 
-    esp_rmaker_node_add_device(node, currentMoistureInfoDevice);
+    esp_rmaker_node_add_device(node, device);
 }
 
-void rmaker_add_manual_watering(esp_rmaker_node_t *node, void *manual_watering_cb)
+void rmaker_add_manual_watering(esp_rmaker_node_t *node, int zone)
 {
-    manualWateringDevice = esp_rmaker_device_create("Manual Watering", NULL, NULL);
+    char zoneName[32];
+
+    esp_rmaker_device_t *device = esp_rmaker_device_create(rmaker_zone_name(zoneName, sizeof(zoneName), "Manual Watering", zone), NULL, (void *)(intptr_t)zone);
+    manualWateringDevice[zone] = device;
 
-    esp_rmaker_device_add_cb(manualWateringDevice, manual_watering_cb, NULL);
+    esp_rmaker_device_add_cb(device, rmaker_write_cb, NULL);
 
-    esp_rmaker_device_add_param(manualWateringDevice, esp_rmaker_name_param_create("name", "Watering"));
+    esp_rmaker_device_add_param(device, esp_rmaker_name_param_create("name", rmaker_zone_name(zoneName, sizeof(zoneName), "Watering", zone)));
 
-    esp_rmaker_param_t *statusParam = esp_rmaker_param_create("status", "Status", esp_rmaker_str("Disabled"), PROP_FLAG_READ);
+    esp_rmaker_param_t *statusParam = rmaker_param_add(device, RMAKER_PARAM_STATUS, zone, esp_rmaker_str("Disabled"), PROP_FLAG_READ);
     esp_rmaker_param_add_ui_type(statusParam, ESP_RMAKER_UI_TEXT);
-    esp_rmaker_device_add_param(manualWateringDevice, statusParam);
-    esp_rmaker_device_assign_primary_param(manualWateringDevice, statusParam);
+    esp_rmaker_device_assign_primary_param(device, statusParam);
 
-    esp_rmaker_param_t *timeParam = esp_rmaker_param_create("time irrigating (seconds)", "Time", esp_rmaker_int(5), PROP_FLAG_READ | PROP_FLAG_WRITE);
+    const config_schema_t *timeSchema = config_schema(CFG_TIME_WATERING);
+    esp_rmaker_param_t *timeParam = rmaker_param_add(device, RMAKER_PARAM_TIME_WATERING, zone, esp_rmaker_int(appConfig->timeWatering[zone]), PROP_FLAG_READ | PROP_FLAG_WRITE);
     esp_rmaker_param_add_ui_type(timeParam, ESP_RMAKER_UI_SLIDER);
-    esp_rmaker_param_add_bounds(timeParam, esp_rmaker_int(5), esp_rmaker_int(100), esp_rmaker_int(1));
-    esp_rmaker_device_add_param(manualWateringDevice, timeParam);
+    esp_rmaker_param_add_bounds(timeParam, esp_rmaker_int(timeSchema->min), esp_rmaker_int(timeSchema->max), esp_rmaker_int(1));
+
+    esp_rmaker_param_t *triggerParam = rmaker_param_add(device, RMAKER_PARAM_TRIGGER_PUMP, zone, esp_rmaker_bool(false), PROP_FLAG_READ | PROP_FLAG_WRITE);
+    esp_rmaker_param_add_ui_type(triggerParam, ESP_RMAKER_UI_TRIGGER);
+
+    esp_rmaker_node_add_device(node, device);
+}
+
+void rmaker_add_history_export(esp_rmaker_node_t *node)
+{
+    historyExportDevice = esp_rmaker_device_create("History", NULL, NULL);
+
+    esp_rmaker_device_add_cb(historyExportDevice, rmaker_write_cb, NULL);
+
+    esp_rmaker_device_add_param(historyExportDevice, esp_rmaker_name_param_create("name", "History"));
+
+    /* base64 of the binary history frame, see app_export.h */
+    rmaker_param_add(historyExportDevice, RMAKER_PARAM_HISTORY_FRAME, 0, esp_rmaker_str(""), PROP_FLAG_READ);
 
-    esp_rmaker_param_t *triggerParam = esp_rmaker_param_create("trigger pump", "Trigger", esp_rmaker_bool(false), PROP_FLAG_READ | PROP_FLAG_WRITE);
+    esp_rmaker_param_t *triggerParam = rmaker_param_add(historyExportDevice, RMAKER_PARAM_TRIGGER_EXPORT, 0, esp_rmaker_bool(false), PROP_FLAG_READ | PROP_FLAG_WRITE);
     esp_rmaker_param_add_ui_type(triggerParam, ESP_RMAKER_UI_TRIGGER);
-    esp_rmaker_device_add_param(manualWateringDevice, triggerParam);
 
-    esp_rmaker_node_add_device(node, manualWateringDevice);
+    esp_rmaker_node_add_device(node, historyExportDevice);
 }
 
-void rmaker_update_moisture(uint8_t value)
+void rmaker_add_schedule(esp_rmaker_node_t *node)
 {
-    esp_rmaker_param_update_and_report(esp_rmaker_device_get_param_by_type(currentMoistureInfoDevice, "MoistureSensor"), esp_rmaker_int(value));
+    static char rules[SCHEDULE_TEXT_SIZE];
+    schedule_rule_t stored[SCHEDULE_MAX_RULES];
+
+    scheduleDevice = esp_rmaker_device_create("Schedule", NULL, NULL);
+
+    esp_rmaker_device_add_cb(scheduleDevice, rmaker_write_cb, NULL);
+
+    esp_rmaker_device_add_param(scheduleDevice, esp_rmaker_name_param_create("name", "Schedule"));
+
+    /* the whole rule set in the text form of app_schedule.h, a write replaces it */
+    schedule_format(stored, schedule_get(stored, NULL), rules, sizeof(rules));
+    esp_rmaker_param_t *rulesParam = rmaker_param_add(scheduleDevice, RMAKER_PARAM_SCHEDULE, 0, esp_rmaker_str(rules), PROP_FLAG_READ | PROP_FLAG_WRITE);
+    esp_rmaker_param_add_ui_type(rulesParam, ESP_RMAKER_UI_TEXT);
+    esp_rmaker_device_assign_primary_param(scheduleDevice, rulesParam);
+
+    esp_rmaker_node_add_device(node, scheduleDevice);
+}
+
+static esp_rmaker_param_t *rmaker_param_add(const esp_rmaker_device_t *device, rmaker_param_id_t param, int zone,
+                                            esp_rmaker_param_val_t val, uint8_t properties)
+{
+    esp_rmaker_param_t *handle = esp_rmaker_param_create(paramNames[param], paramTypes[param], val, properties);
+
+    esp_rmaker_device_add_param(device, handle);
+    params[param][zone] = handle;
+
+    return handle;
+}
+
+/*---------------------------------------------------------------
+        Typed Setters
+---------------------------------------------------------------*/
+esp_err_t rmaker_report_int(rmaker_param_id_t param, int zone, int value)
+{
+    return esp_rmaker_param_update_and_report(params[param][zone], esp_rmaker_int(value));
+}
+
+esp_err_t rmaker_report_bool(rmaker_param_id_t param, int zone, bool value)
+{
+    return esp_rmaker_param_update_and_report(params[param][zone], esp_rmaker_bool(value));
+}
+
+esp_err_t rmaker_report_str(rmaker_param_id_t param, int zone, const char *value)
+{
+    return esp_rmaker_param_update_and_report(params[param][zone], esp_rmaker_str(value));
+}
+
+esp_err_t rmaker_set_str(rmaker_param_id_t param, int zone, const char *value)
+{
+    return esp_rmaker_param_update(params[param][zone], esp_rmaker_str(value));
 }
 
-void rmaker_update_watering_status(bool watering)
+const esp_rmaker_param_val_t *rmaker_get_value(rmaker_param_id_t param, int zone)
 {
+    return esp_rmaker_param_get_val(params[param][zone]);
+}
+
+void rmaker_update_moisture(int zone, uint8_t value)
+{
+    trace_record(TRACE_PUBLISH_MOISTURE, zone, value);
+    rmaker_report_int(RMAKER_PARAM_MOISTURE, zone, value);
+}
+
+void rmaker_update_watering_status(int zone, bool watering)
+{
+    trace_record(TRACE_PUBLISH_STATUS, zone, watering);
     if (watering)
     {
-        esp_rmaker_param_update_and_report(esp_rmaker_device_get_param_by_type(manualWateringDevice, "Status"), esp_rmaker_str("Watering the plant..."));
-        rmaker_warn_user("Watering the plant...");
+        char zoneName[32];
+
+        rmaker_report_str(RMAKER_PARAM_STATUS, zone, "Watering the plant...");
+        rmaker_warn_user(ZONE_COUNT == 1 ? "Watering the plant..." : (char *)rmaker_zone_name(zoneName, sizeof(zoneName), "Watering zone", zone));
     }
     else
     {
-        esp_rmaker_param_update_and_report(esp_rmaker_device_get_param_by_type(manualWateringDevice, "Status"), esp_rmaker_str("Disabled"));
+        rmaker_report_str(RMAKER_PARAM_STATUS, zone, "Disabled");
     }
 }
 
 void rmaker_warn_user(char *str)
 {
+    trace_record(TRACE_ALERT, 0, 0);
     ESP_ERROR_CHECK(esp_rmaker_raise_alert(str));
 }
 
-void rmaker_get_watering_status(char *status)
+void rmaker_get_watering_status(int zone, char *status)
+{
+    /* Status lives on the Manual Watering device */
+    strcpy(status, rmaker_get_value(RMAKER_PARAM_STATUS, zone)->val.s);
+}
+
+void rmaker_update_auto_watering(int zone, bool value)
+{
+    trace_record(TRACE_PUBLISH_AUTO, zone, value);
+    rmaker_report_bool(RMAKER_PARAM_AUTO_WATERING, zone, value);
+}
+
+void rmaker_update_time_watering(int zone, uint16_t seconds)
+{
+    trace_record(TRACE_PUBLISH_TIME, zone, seconds);
+    rmaker_report_int(RMAKER_PARAM_TIME_WATERING, zone, seconds);
+}
+
+void rmaker_update_history_export(const char *frame)
 {
-    esp_rmaker_param_val_t *val = esp_rmaker_param_get_val(esp_rmaker_device_get_param_by_type(currentMoistureInfoDevice, "Status"));
-    strcpy(status, (val->val).s);
+    trace_record(TRACE_PUBLISH_EXPORT, 0, strlen(frame));
+
+    /* local update only, the frame is pulled through local control instead of being pushed over MQTT */
+    rmaker_set_str(RMAKER_PARAM_HISTORY_FRAME, 0, frame);
 }
 
-void rmaker_update_auto_watering(bool value)
+void rmaker_update_schedule(const char *rules)
 {
-    esp_rmaker_param_update_and_report(esp_rmaker_device_get_param_by_name(autoWateringSwitchDevice, ESP_RMAKER_DEF_POWER_NAME), esp_rmaker_bool(value));
-}
\ No newline at end of file
+    rmaker_report_str(RMAKER_PARAM_SCHEDULE, 0, rules);
+}
+/*---------------------------------------------------------------
+        Parameter Writes
+---------------------------------------------------------------*/
+static esp_err_t rmaker_write_cb(const esp_rmaker_device_t *device, const esp_rmaker_param_t *param,
+                                 const esp_rmaker_param_val_t val, void *priv_data, esp_rmaker_write_ctx_t *ctx)
+{
+    int zone = (int)(intptr_t)priv_data;
+
+    if (ctx)
+        TLOG(TLOG_RMAKER_WRITE, ctx->src);
+
+    /* every parameter handle was stored when it was created, no name lookup on the write path */
+    for (int id = 0; id < RMAKER_TOTAL_PARAMS; id++)
+    {
+        if (params[id][zone] != param)
+            continue;
+
+        if (handlers[id].write == NULL)
+            return ESP_ERR_NOT_SUPPORTED;
+        if (val.type != handlers[id].type)
+            return ESP_ERR_INVALID_ARG;
+
+        return handlers[id].write(zone, val);
+    }
+
+    /* a rename from the app only has to be kept and reported back */
+    if (strcmp(esp_rmaker_param_get_type(param), ESP_RMAKER_PARAM_NAME) == 0)
+        return esp_rmaker_param_update_and_report(param, val);
+
+    return ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t rmaker_write_params(const char *data, size_t len, esp_rmaker_req_src_t src)
+{
+    esp_err_t err = ESP_OK;
+
+    /* {"<device>": {"<param>": <value>, ...}, ...} as on the params/remote topic */
+    cJSON *root = cJSON_ParseWithLength(data, len);
+    if (root == NULL)
+        return ESP_ERR_INVALID_ARG;
+
+    cJSON *deviceJson;
+    cJSON_ArrayForEach(deviceJson, root)
+    {
+        int zone;
+        const esp_rmaker_device_t *device = rmaker_find_device(deviceJson->string, &zone);
+
+        if (device == NULL)
+        {
+            err = ESP_ERR_NOT_FOUND;
+            continue;
+        }
+
+        cJSON *paramJson;
+        cJSON_ArrayForEach(paramJson, deviceJson)
+        {
+            esp_rmaker_param_t *param = esp_rmaker_device_get_param_by_name(device, paramJson->string);
+            if (param == NULL)
+            {
+                err = ESP_ERR_NOT_FOUND;
+                continue;
+            }
+
+            /* the value takes the type the parameter was created with */
+            esp_rmaker_param_val_t val = *esp_rmaker_param_get_val(param);
+            if (val.type == RMAKER_VAL_TYPE_BOOLEAN && cJSON_IsBool(paramJson))
+                val.val.b = cJSON_IsTrue(paramJson);
+            else if (val.type == RMAKER_VAL_TYPE_INTEGER && cJSON_IsNumber(paramJson))
+                val.val.i = paramJson->valueint;
+            else if (val.type == RMAKER_VAL_TYPE_FLOAT && cJSON_IsNumber(paramJson))
+                val.val.f = paramJson->valuedouble;
+            else if (val.type == RMAKER_VAL_TYPE_STRING && cJSON_IsString(paramJson))
+                val.val.s = paramJson->valuestring;
+            else
+            {
+                err = ESP_ERR_INVALID_ARG;
+                continue;
+            }
+
+            esp_rmaker_write_ctx_t ctx = {
+                .src = src,
+            };
+            if (rmaker_write_cb(device, param, val, (void *)(intptr_t)zone, &ctx) != ESP_OK)
+                err = ESP_FAIL;
+        }
+    }
+
+    cJSON_Delete(root);
+    return err;
+}
+
+static const esp_rmaker_device_t *rmaker_find_device(const char *name, int *zone)
+{
+    for (*zone = 0; *zone < ZONE_COUNT; (*zone)++)
+    {
+        if (strcmp(name, esp_rmaker_device_get_name(autoWateringSwitchDevice[*zone])) == 0)
+            return autoWateringSwitchDevice[*zone];
+        if (strcmp(name, esp_rmaker_device_get_name(currentMoistureInfoDevice[*zone])) == 0)
+            return currentMoistureInfoDevice[*zone];
+        if (strcmp(name, esp_rmaker_device_get_name(manualWateringDevice[*zone])) == 0)
+            return manualWateringDevice[*zone];
+    }
+
+    *zone = 0;
+    if (strcmp(name, esp_rmaker_device_get_name(historyExportDevice)) == 0)
+        return historyExportDevice;
+    if (strcmp(name, esp_rmaker_device_get_name(scheduleDevice)) == 0)
+        return scheduleDevice;
+
+    return NULL;
+}
+
+/* a write as the device callback gets it, without the cloud or the JSON parser (stress benchmarks) */
+esp_err_t rmaker_inject_write(rmaker_param_id_t param, int zone, esp_rmaker_param_val_t val)
+{
+    esp_rmaker_write_ctx_t ctx = {
+        .src = ESP_RMAKER_REQ_SRC_LOCAL,
+    };
+
+    if (params[param][zone] == NULL)
+        return ESP_ERR_INVALID_STATE;
+
+    return rmaker_write_cb(NULL, params[param][zone], val, (void *)(intptr_t)zone, &ctx);
+}
@@ -13,11 +13,61 @@
 #include <app_wifi.h>
 #include <app_insights.h>
 
-#define DEFAULT_AUTO_WATERING_POWER false
+#include "app_zones.h"
 
-void rmaker_init(void *auto_watering_write_cb, void *current_moisture_cb, void *manual_watering_cb);
-void rmaker_update_moisture(uint8_t value);
-void rmaker_update_watering_status(bool watering);
-void rmaker_get_watering_status(char *status);
+/*
+ * Parameter registry. Every parameter the app reads or writes is created
+ * once at rmaker_init and its handle kept in a table indexed by this id and
+ * the zone, so updates never look a parameter up by string. Writes from the
+ * cloud are dispatched on the handle to the handler registered for the id,
+ * after checking the value has the handler's type.
+ *
+ * X(param, name, type) with the name and type RainMaker knows it by
+ */
+#define RMAKER_PARAMS(X)                                                             \
+    X(RMAKER_PARAM_AUTO_WATERING, ESP_RMAKER_DEF_POWER_NAME, ESP_RMAKER_PARAM_POWER) \
+    X(RMAKER_PARAM_MOISTURE, "Moisture (%)", "MoistureSensor")                       \
+    X(RMAKER_PARAM_TRIGGER_READING, "trigger reading", "TriggerReading")             \
+    X(RMAKER_PARAM_STATUS, "status", "Status")                                       \
+    X(RMAKER_PARAM_TIME_WATERING, "time irrigating (seconds)", "Time")               \
+    X(RMAKER_PARAM_TRIGGER_PUMP, "trigger pump", "Trigger")                          \
+    X(RMAKER_PARAM_HISTORY_FRAME, "export", "HistoryFrame")                          \
+    X(RMAKER_PARAM_TRIGGER_EXPORT, "trigger export", "TriggerExport")                \
+    X(RMAKER_PARAM_SCHEDULE, "rules", "WateringSchedule")
+
+#define RMAKER_PARAM_ENUM(param, name, type) param,
+
+enum rmaker_param_id_t
+{
+    RMAKER_PARAMS(RMAKER_PARAM_ENUM)
+    RMAKER_TOTAL_PARAMS,
+};
+typedef enum rmaker_param_id_t rmaker_param_id_t;
+
+/* zone is 0 for the parameters of the single History device */
+typedef esp_err_t (*rmaker_write_fn_t)(int zone, esp_rmaker_param_val_t val);
+
+struct rmaker_handler_t
+{
+    rmaker_param_id_t param;
+    esp_rmaker_val_type_t type; // writes of another type are refused before the handler runs
+    rmaker_write_fn_t write;
+};
+typedef struct rmaker_handler_t rmaker_handler_t;
+
+void rmaker_init(const rmaker_handler_t *handlers, int count);
+esp_err_t rmaker_report_int(rmaker_param_id_t param, int zone, int value);
+esp_err_t rmaker_report_bool(rmaker_param_id_t param, int zone, bool value);
+esp_err_t rmaker_report_str(rmaker_param_id_t param, int zone, const char *value);
+esp_err_t rmaker_set_str(rmaker_param_id_t param, int zone, const char *value);
+const esp_rmaker_param_val_t *rmaker_get_value(rmaker_param_id_t param, int zone);
+void rmaker_update_moisture(int zone, uint8_t value);
+void rmaker_update_watering_status(int zone, bool watering);
+void rmaker_get_watering_status(int zone, char *status);
 void rmaker_warn_user(char *str);
-void rmaker_update_auto_watering(bool value);
\ No newline at end of file
+void rmaker_update_auto_watering(int zone, bool value);
+void rmaker_update_time_watering(int zone, uint16_t seconds);
+void rmaker_update_history_export(const char *frame);
+void rmaker_update_schedule(const char *rules);
+esp_err_t rmaker_write_params(const char *data, size_t len, esp_rmaker_req_src_t src);
+esp_err_t rmaker_inject_write(rmaker_param_id_t param, int zone, esp_rmaker_param_val_t val);
\ No newline at end of file
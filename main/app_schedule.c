@@ -0,0 +1,527 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "nvs.h"
+
+#include "app_schedule.h"
+#include "app_tlog.h"
+
+struct schedule_entry_t
+{
+    schedule_rule_t rule;
+    schedule_status_t status; // status.nextS is the heap key, a retry moves it within the window
+    int64_t windowStartS;
+    int64_t windowEndS;
+};
+typedef struct schedule_entry_t schedule_entry_t;
+
+/* survives resets (not power loss), a window is trusted only for the rule it was recorded for */
+struct schedule_rtc_t
+{
+    uint32_t magic;
+    schedule_rule_t rules[SCHEDULE_MAX_RULES];
+    int64_t lastS[SCHEDULE_MAX_RULES];
+};
+typedef struct schedule_rtc_t schedule_rtc_t;
+
+static void schedule_load(const schedule_rule_t *rules, int count);
+static void schedule_compile(int64_t nowS, int64_t offsetS);
+static int64_t schedule_next_window(const schedule_rule_t *rule, int64_t fromS);
+static void schedule_push(int index);
+static int schedule_pop(void);
+static void schedule_arm(int64_t nowUs);
+static void schedule_timer_cb(void *arg);
+static bool schedule_valid(const schedule_rule_t *rule);
+
+static const char *dayLetters = "SMTWTFS";
+
+static schedule_entry_t entries[SCHEDULE_MAX_RULES];
+static int ruleCount = 0;
+static uint8_t heap[SCHEDULE_MAX_RULES]; // entry indexes, min-heap on status.nextS
+static int heapSize = 0;
+static bool compiled = false;
+static int64_t compiledOffsetS = 0; // wall clock minus monotonic clock at the last compile
+
+/* written by schedule_set, applied by the main loop */
+static schedule_rule_t pendingRules[SCHEDULE_MAX_RULES];
+static int pendingCount = -1;
+
+static esp_timer_handle_t timer = NULL; // only the main loop arms it
+static void (*wakeLoop)(void) = NULL;
+static portMUX_TYPE scheduleLock = portMUX_INITIALIZER_UNLOCKED;
+
+static RTC_NOINIT_ATTR schedule_rtc_t rtc;
+
+static const char *TAG = "ASE-PROJECT-SCHEDULE";
+
+/*---------------------------------------------------------------
+        Schedule Initialization
+---------------------------------------------------------------*/
+void schedule_init(void)
+{
+    schedule_rule_t rules[SCHEDULE_MAX_RULES];
+    size_t size = sizeof(rules);
+    int count = 0;
+    nvs_handle_t nvsHandle;
+
+    if (nvs_open(SCHEDULE_NVS_NAMESPACE, NVS_READONLY, &nvsHandle) == ESP_OK)
+    {
+        if (nvs_get_blob(nvsHandle, SCHEDULE_NVS_KEY, rules, &size) == ESP_OK && size % sizeof(schedule_rule_t) == 0)
+            count = size / sizeof(schedule_rule_t);
+        nvs_close(nvsHandle);
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (!schedule_valid(&rules[i]))
+        {
+            ESP_LOGW(TAG, "stored rule %d is invalid, schedule disabled", i);
+            count = 0;
+        }
+    }
+
+    /* after power-on the RTC memory holds noise */
+    if (rtc.magic != SCHEDULE_RTC_MAGIC || esp_reset_reason() == ESP_RST_POWERON)
+    {
+        memset(&rtc, 0, sizeof(rtc));
+        rtc.magic = SCHEDULE_RTC_MAGIC;
+    }
+
+    schedule_load(rules, count);
+
+    ESP_LOGI(TAG, "%d rules", count);
+}
+
+/* arms the timer, wake runs in the timer task and has the main loop call schedule_run */
+void schedule_start(void (*wake)(void))
+{
+    const esp_timer_create_args_t args = {
+        .callback = schedule_timer_cb,
+        .name = "schedule",
+    };
+
+    ESP_ERROR_CHECK(esp_timer_create(&args, &timer));
+    wakeLoop = wake;
+
+    /* the first run compiles the rules once the clock is set */
+    wake();
+}
+
+/*---------------------------------------------------------------
+        Schedule Execution
+---------------------------------------------------------------*/
+void schedule_run(schedule_fire_fn_t fire)
+{
+    schedule_rule_t rules[SCHEDULE_MAX_RULES];
+    struct timeval now;
+    int count;
+
+    taskENTER_CRITICAL(&scheduleLock);
+    count = pendingCount;
+    if (count >= 0)
+        memcpy(rules, pendingRules, count * sizeof(schedule_rule_t));
+    pendingCount = -1;
+    taskEXIT_CRITICAL(&scheduleLock);
+
+    if (count >= 0)
+        schedule_load(rules, count);
+
+    gettimeofday(&now, NULL);
+    int64_t nowS = now.tv_sec;
+    int64_t nowUs = 1000000LL * now.tv_sec + now.tv_usec;
+
+    if (nowS < SCHEDULE_MIN_EPOCH)
+    {
+        compiled = false;
+        schedule_arm(nowUs);
+        return;
+    }
+
+    /* a clock sync or a manual set moves every window */
+    int64_t offsetS = nowS - esp_timer_get_time() / 1000000;
+    if (!compiled || llabs(offsetS - compiledOffsetS) > SCHEDULE_CLOCK_STEP_S)
+        schedule_compile(nowS, offsetS);
+
+    while (heapSize > 0 && entries[heap[0]].status.nextS <= nowS)
+    {
+        int index = schedule_pop();
+        schedule_entry_t *entry = &entries[index];
+
+        schedule_result_t result = fire(index, &entry->rule, nowS - entry->windowStartS);
+
+        if (result == SCHEDULE_BUSY && nowS + SCHEDULE_RETRY_S < entry->windowEndS)
+        {
+            taskENTER_CRITICAL(&scheduleLock);
+            entry->status.nextS = nowS + SCHEDULE_RETRY_S;
+            taskEXIT_CRITICAL(&scheduleLock);
+
+            schedule_push(index);
+            continue;
+        }
+
+        if (result == SCHEDULE_BUSY)
+            TLOG(TLOG_SCHEDULE_MISSED, index, entry->rule.zone);
+
+        /* the next window opens after this one, however late this one ran */
+        int64_t nextS = schedule_next_window(&entry->rule, entry->windowStartS + 1);
+
+        taskENTER_CRITICAL(&scheduleLock);
+        if (result == SCHEDULE_RAN)
+            entry->status.runs++;
+        else if (result == SCHEDULE_SKIPPED)
+            entry->status.skipped++;
+        else
+            entry->status.missed++;
+        if (result != SCHEDULE_BUSY)
+        {
+            entry->status.lastS = entry->windowStartS;
+            rtc.lastS[index] = entry->windowStartS;
+        }
+        entry->windowStartS = nextS;
+        entry->windowEndS = nextS + 60LL * entry->rule.windowMin;
+        entry->status.nextS = nextS;
+        taskEXIT_CRITICAL(&scheduleLock);
+
+        schedule_push(index);
+    }
+
+    schedule_arm(nowUs);
+}
+
+/* takes a new rule set, rules unchanged at the same index keep their status */
+static void schedule_load(const schedule_rule_t *rules, int count)
+{
+    taskENTER_CRITICAL(&scheduleLock);
+    for (int i = 0; i < count; i++)
+    {
+        if (i < ruleCount && memcmp(&entries[i].rule, &rules[i], sizeof(schedule_rule_t)) == 0)
+            continue;
+
+        memset(&entries[i], 0, sizeof(entries[i]));
+        entries[i].rule = rules[i];
+
+        /* a reset inside a window must not water twice */
+        if (memcmp(&rtc.rules[i], &rules[i], sizeof(schedule_rule_t)) == 0)
+            entries[i].status.lastS = rtc.lastS[i];
+
+        rtc.rules[i] = rules[i];
+        rtc.lastS[i] = entries[i].status.lastS;
+    }
+    ruleCount = count;
+    heapSize = 0;
+    compiled = false;
+    taskEXIT_CRITICAL(&scheduleLock);
+}
+
+/* every rule's next window, a window open now is due at once unless the rule already ran in it */
+static void schedule_compile(int64_t nowS, int64_t offsetS)
+{
+    taskENTER_CRITICAL(&scheduleLock);
+    heapSize = 0;
+    taskEXIT_CRITICAL(&scheduleLock);
+
+    for (int i = 0; i < ruleCount; i++)
+    {
+        schedule_entry_t *entry = &entries[i];
+        int64_t fromS = nowS - 60LL * entry->rule.windowMin + 1;
+        if (entry->status.lastS >= fromS)
+            fromS = entry->status.lastS + 1;
+
+        int64_t startS = schedule_next_window(&entry->rule, fromS);
+
+        taskENTER_CRITICAL(&scheduleLock);
+        entry->windowStartS = startS;
+        entry->windowEndS = startS + 60LL * entry->rule.windowMin;
+        entry->status.nextS = startS;
+        taskEXIT_CRITICAL(&scheduleLock);
+
+        schedule_push(i);
+    }
+
+    compiledOffsetS = offsetS;
+    compiled = true;
+}
+
+/* first window opening at or after fromS, at most eight days are tried */
+static int64_t schedule_next_window(const schedule_rule_t *rule, int64_t fromS)
+{
+    time_t from = fromS;
+    struct tm day;
+
+    localtime_r(&from, &day);
+
+    for (int d = 0; d < 8; d++)
+    {
+        struct tm tm = day;
+        tm.tm_mday += d;
+        tm.tm_hour = rule->startMin / 60;
+        tm.tm_min = rule->startMin % 60;
+        tm.tm_sec = 0;
+        tm.tm_isdst = -1; // mktime picks the offset of that day
+
+        int64_t startS = mktime(&tm);
+        if (startS >= fromS && (rule->days & (1 << tm.tm_wday)))
+            return startS;
+    }
+
+    return INT64_MAX; // no day set, refused by schedule_valid
+}
+
+/*---------------------------------------------------------------
+        Timer Queue
+---------------------------------------------------------------*/
+static void schedule_push(int index)
+{
+    taskENTER_CRITICAL(&scheduleLock);
+    int child = heapSize++;
+    while (child > 0)
+    {
+        int parent = (child - 1) / 2;
+        if (entries[heap[parent]].status.nextS <= entries[index].status.nextS)
+            break;
+        heap[child] = heap[parent];
+        child = parent;
+    }
+    heap[child] = index;
+    taskEXIT_CRITICAL(&scheduleLock);
+}
+
+static int schedule_pop(void)
+{
+    taskENTER_CRITICAL(&scheduleLock);
+    int top = heap[0];
+    int last = heap[--heapSize];
+    int parent = 0;
+    while (2 * parent + 1 < heapSize)
+    {
+        int child = 2 * parent + 1;
+        if (child + 1 < heapSize && entries[heap[child + 1]].status.nextS < entries[heap[child]].status.nextS)
+            child++;
+        if (entries[last].status.nextS <= entries[heap[child]].status.nextS)
+            break;
+        heap[parent] = heap[child];
+        parent = child;
+    }
+    heap[parent] = last;
+    taskEXIT_CRITICAL(&scheduleLock);
+
+    return top;
+}
+
+/* one shot at the head of the queue, never longer than SCHEDULE_MAX_SLEEP_S so a clock step is noticed */
+static void schedule_arm(int64_t nowUs)
+{
+    int64_t delayUs = 1000000LL * SCHEDULE_MAX_SLEEP_S;
+
+    if (compiled && heapSize > 0)
+    {
+        int64_t dueUs = 1000000LL * entries[heap[0]].status.nextS - nowUs;
+        if (dueUs < delayUs)
+            delayUs = dueUs;
+    }
+    if (delayUs < 1000)
+        delayUs = 1000;
+
+    esp_timer_stop(timer); // fails when it already fired
+    ESP_ERROR_CHECK(esp_timer_start_once(timer, delayUs));
+}
+
+static void schedule_timer_cb(void *arg)
+{
+    wakeLoop();
+}
+
+/*---------------------------------------------------------------
+        Rule Set
+---------------------------------------------------------------*/
+esp_err_t schedule_set(const schedule_rule_t *rules, int count)
+{
+    nvs_handle_t nvsHandle;
+
+    if (count < 0 || count > SCHEDULE_MAX_RULES)
+        return ESP_ERR_INVALID_SIZE;
+    for (int i = 0; i < count; i++)
+        if (!schedule_valid(&rules[i]))
+            return ESP_ERR_INVALID_ARG;
+
+    esp_err_t err = nvs_open(SCHEDULE_NVS_NAMESPACE, NVS_READWRITE, &nvsHandle);
+    if (err != ESP_OK)
+        return err;
+
+    if (count > 0)
+        err = nvs_set_blob(nvsHandle, SCHEDULE_NVS_KEY, rules, count * sizeof(schedule_rule_t));
+    else if ((err = nvs_erase_key(nvsHandle, SCHEDULE_NVS_KEY)) == ESP_ERR_NVS_NOT_FOUND)
+        err = ESP_OK;
+    if (err == ESP_OK)
+        err = nvs_commit(nvsHandle);
+    nvs_close(nvsHandle);
+
+    if (err != ESP_OK)
+        return err;
+
+    taskENTER_CRITICAL(&scheduleLock);
+    memcpy(pendingRules, rules, count * sizeof(schedule_rule_t));
+    pendingCount = count;
+    taskEXIT_CRITICAL(&scheduleLock);
+
+    /* the loop applies it and re-arms the timer */
+    if (wakeLoop != NULL)
+        wakeLoop();
+
+    return ESP_OK;
+}
+
+/* the rule set as applied by the main loop */
+int schedule_get(schedule_rule_t *rules, schedule_status_t *status)
+{
+    int count;
+
+    taskENTER_CRITICAL(&scheduleLock);
+    count = pendingCount >= 0 ? pendingCount : ruleCount;
+    for (int i = 0; i < count; i++)
+    {
+        if (rules)
+            rules[i] = pendingCount >= 0 ? pendingRules[i] : entries[i].rule;
+        if (status)
+            status[i] = pendingCount >= 0 ? (schedule_status_t){0} : entries[i].status;
+    }
+    taskEXIT_CRITICAL(&scheduleLock);
+
+    return count;
+}
+
+static bool schedule_valid(const schedule_rule_t *rule)
+{
+    if (rule->days == 0 || rule->days > 0x7F || rule->zone >= ZONE_COUNT)
+        return false;
+    if (rule->startMin >= 24 * 60 || rule->windowMin < 1 || rule->windowMin > 24 * 60)
+        return false;
+
+    /* exactly one of a duration and a target */
+    return (rule->durationS > 0) != (rule->target > 0) && rule->target <= 100;
+}
+
+/*---------------------------------------------------------------
+        Text Form
+---------------------------------------------------------------*/
+/* number of rules parsed, -1 on the first malformed or invalid one */
+int schedule_parse(const char *text, schedule_rule_t *rules, int max)
+{
+    char copy[SCHEDULE_TEXT_SIZE];
+    char *save = NULL;
+    int count = 0;
+
+    if (strlcpy(copy, text, sizeof(copy)) >= sizeof(copy))
+        return -1;
+
+    for (char *token = strtok_r(copy, ";", &save); token != NULL; token = strtok_r(NULL, ";", &save))
+    {
+        char days[8], unit;
+        int hours, minutes, window, zone, value, end = 0;
+
+        while (isspace((unsigned char)*token))
+            token++;
+        if (*token == '\0')
+            continue;
+
+        if (count >= max)
+            return -1;
+        if (sscanf(token, "%7s %d:%d %d %d %d%c %n", days, &hours, &minutes, &window, &zone, &value, &unit, &end) != 7 ||
+            token[end] != '\0' || strlen(days) != 7)
+            return -1;
+        if (hours < 0 || hours > 23 || minutes < 0 || minutes > 59 || window < 1 || window > 24 * 60 || zone < 0 ||
+            zone >= ZONE_COUNT || value < 1 || value > 255)
+            return -1;
+
+        schedule_rule_t *rule = &rules[count];
+        memset(rule, 0, sizeof(*rule));
+
+        for (int d = 0; d < 7; d++)
+        {
+            if (days[d] == '-')
+                continue;
+            if (toupper((unsigned char)days[d]) != dayLetters[d])
+                return -1;
+            rule->days |= 1 << d;
+        }
+
+        rule->zone = zone;
+        rule->startMin = 60 * hours + minutes;
+        rule->windowMin = window;
+        if (unit == 's')
+            rule->durationS = value;
+        else if (unit == '%')
+            rule->target = value;
+        else
+            return -1;
+
+        if (!schedule_valid(rule))
+            return -1;
+        count++;
+    }
+
+    return count;
+}
+
+void schedule_format(const schedule_rule_t *rules, int count, char *text, size_t size)
+{
+    size_t length = 0;
+
+    text[0] = '\0';
+    for (int i = 0; i < count && length < size; i++)
+    {
+        char days[8];
+        for (int d = 0; d < 7; d++)
+            days[d] = rules[i].days & (1 << d) ? dayLetters[d] : '-';
+        days[7] = '\0';
+
+        length += snprintf(text + length, size - length, "%s%s %02u:%02u %u %u %u%c", i ? "; " : "", days,
+                           rules[i].startMin / 60, rules[i].startMin % 60, rules[i].windowMin, rules[i].zone,
+                           rules[i].durationS ? rules[i].durationS : rules[i].target, rules[i].durationS ? 's' : '%');
+    }
+}
+
+/*---------------------------------------------------------------
+        Schedule Report
+---------------------------------------------------------------*/
+void schedule_print(void)
+{
+    schedule_rule_t rules[SCHEDULE_MAX_RULES];
+    schedule_status_t status[SCHEDULE_MAX_RULES];
+    int count = schedule_get(rules, status);
+
+    if (count == 0)
+    {
+        printf("no rules\n");
+        return;
+    }
+
+    printf("%-4s %-26s %-16s %6s %7s %6s\n", "rule", "definition", "next window", "runs", "skipped", "missed");
+    for (int i = 0; i < count; i++)
+    {
+        char text[SCHEDULE_RULE_TEXT];
+        char next[20] = "clock unset";
+
+        schedule_format(&rules[i], 1, text, sizeof(text));
+        if (status[i].nextS > 0 && status[i].nextS < INT64_MAX)
+        {
+            time_t nextS = status[i].nextS;
+            struct tm tm;
+            localtime_r(&nextS, &tm);
+            strftime(next, sizeof(next), "%a %d %b %H:%M", &tm);
+        }
+
+        printf("%-4d %-26s %-16s %6lu %7lu %6lu\n", i, text, next, (unsigned long)status[i].runs,
+               (unsigned long)status[i].skipped, (unsigned long)status[i].missed);
+    }
+}
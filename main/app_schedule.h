@@ -0,0 +1,77 @@
+#pragma once
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_zones.h"
+
+#define SCHEDULE_MAX_RULES 16
+#define SCHEDULE_NVS_NAMESPACE "app_schedule"
+#define SCHEDULE_NVS_KEY "rules"
+#define SCHEDULE_MAX_SLEEP_S 600      // the queue head is re-checked at least this often, so a clock step is caught
+#define SCHEDULE_CLOCK_STEP_S 60      // wall clock moving this far against the monotonic clock recompiles every deadline
+#define SCHEDULE_RETRY_S 60           // a run that finds its zone busy tries again this much later, within its window
+#define SCHEDULE_MIN_EPOCH 1700000000 // an earlier wall clock was never set, nothing fires
+#define SCHEDULE_RULE_TEXT 32         // one rule as text, "SMTWTFS 23:59 1440 7 255s; "
+#define SCHEDULE_TEXT_SIZE (SCHEDULE_MAX_RULES * SCHEDULE_RULE_TEXT)
+#define SCHEDULE_RTC_MAGIC 0x48435357 // "WSCH"
+
+/*
+ * Watering schedule. A rule opens a window on the days it names, at a local
+ * time, and starts one run in that window: a fixed number of pump seconds,
+ * or up to a target moisture (skipped when the zone is already there). A
+ * run that finds its zone watering, or without a settled moisture level
+ * for its target, is retried until the window closes.
+ *
+ * The rules are compiled to the absolute time of their next window and kept
+ * in a min-heap. One one-shot timer is armed for the head, so nothing is
+ * evaluated between fires; a fire pops the rule and pushes its following
+ * window. Runs start from the main loop on the node's own clock, without
+ * the cloud. The rule set is persisted in NVS and the last window each rule
+ * ran in survives resets in RTC memory, so a reboot does not water twice.
+ *
+ * Text form, one rule per ';': "<days> <HH:MM> <window min> <zone> <N>s|<N>%"
+ * with days as SMTWTFS and '-' for the days off, e.g. "-M-W-F- 06:30 60 0 20s".
+ */
+struct schedule_rule_t
+{
+    uint8_t days;       // bit 0 Sunday to bit 6 Saturday, as tm_wday
+    uint8_t zone;
+    uint16_t startMin;  // local time the window opens, minutes after midnight
+    uint16_t windowMin; // window length, 1 to 1440
+    uint8_t durationS;  // pump seconds, 0 for a moisture rule
+    uint8_t target;     // % a moisture rule waters up to, 0 for a duration rule
+};
+typedef struct schedule_rule_t schedule_rule_t;
+
+struct schedule_status_t
+{
+    int64_t nextS;    // epoch seconds of the next window, 0 while the clock is unset
+    int64_t lastS;    // window the rule last ran in, 0 if never
+    uint32_t runs;    // runs started
+    uint32_t skipped; // moisture already at the target
+    uint32_t missed;  // window closed while the zone was busy or its level unknown
+};
+typedef struct schedule_status_t schedule_status_t;
+
+enum schedule_result_t
+{
+    SCHEDULE_RAN,
+    SCHEDULE_SKIPPED, // moisture already at the target
+    SCHEDULE_BUSY,    // zone watering or its level unknown, retried within the window
+};
+typedef enum schedule_result_t schedule_result_t;
+
+/* starts the run from the main loop, lateS counts from the window opening */
+typedef schedule_result_t (*schedule_fire_fn_t)(int rule, const schedule_rule_t *entry, uint32_t lateS);
+
+void schedule_init(void);
+void schedule_start(void (*wake)(void));
+void schedule_run(schedule_fire_fn_t fire);
+esp_err_t schedule_set(const schedule_rule_t *rules, int count);
+int schedule_get(schedule_rule_t *rules, schedule_status_t *status);
+int schedule_parse(const char *text, schedule_rule_t *rules, int max);
+void schedule_format(const schedule_rule_t *rules, int count, char *text, size_t size);
+void schedule_print(void);
@@ -0,0 +1,690 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_eeprom.h"
+#include "app_flash_log.h"
+#include "app_storage.h"
+#include "app_trace.h"
+
+static void storage_fill_gap(uint64_t now);
+static void storage_head_init(void);
+static void storage_index(void);
+static uint32_t storage_record_time(uint64_t timestamp);
+static esp_err_t storage_push(const uint8_t samples[ZONE_COUNT], uint32_t time);
+static void storage_restart(uint32_t time);
+static void storage_persist(void);
+static esp_err_t storage_medium_append(const uint8_t samples[ZONE_COUNT], uint32_t time);
+static void storage_write_begin(void);
+static void storage_write_end(void);
+static uint32_t storage_read_begin(void);
+static bool storage_read_retry(uint32_t seq);
+
+static const storage_backend_t *const backends[] = {
+    [STORAGE_EEPROM] = &storageEeprom,
+    [STORAGE_FLASH] = &storageFlash,
+};
+
+static const storage_backend_t *active = NULL;
+static int activeIndex = STORAGE_EEPROM;
+static SemaphoreHandle_t storageLock = NULL;
+static StaticSemaphore_t storageLockBuffer;
+static storage_stats_t stats;
+
+/* the head readers see, the newest records and the keyframe times by absolute index, all under headSeq */
+static storage_snapshot_t head;
+static uint8_t recent[STORAGE_RECENT_RECORDS][ZONE_COUNT];
+static uint32_t recentTime[STORAGE_RECENT_RECORDS]; // epoch seconds, good until 2106
+static uint32_t recentFirst = 0; // oldest absolute index whose ring slot maps onto the log
+static uint32_t keyframes[STORAGE_KEYFRAME_SLOTS];  // time of every keyframeRecords-th absolute index
+static uint32_t keyframeFirst = 0; // keyframes before it no longer line up with the medium
+static uint32_t headSeq = 0;     // odd while a writer changes them
+static portMUX_TYPE headLock = portMUX_INITIALIZER_UNLOCKED; // orders the two writers, the sampler and a reader persisting for it
+
+static uint32_t keyframeRecords = STORAGE_KEYFRAME_RECORDS;
+static uint32_t period = 0;
+static uint32_t lastTime = 0; // newest appended record, sampler only
+
+static uint32_t persisted = 0; // absolute index of the first record not on the medium, under storageLock
+static uint32_t persistedTime = 0; // newest record on the medium, the next delta counts from it
+static uint32_t deferred = 0;
+static uint32_t readRetries = 0;
+static uint32_t dropped = 0;
+
+/* a restart the sampler asked for, done by whoever persists the record at restartAt, all under headSeq */
+static bool restartPending = false;
+static uint32_t restartAt = 0;   // absolute index of the first record of the new log
+static uint32_t restartTime = 0; // time the new log counts from
+
+static const char *TAG = "ASE-PROJECT-STORAGE";
+
+/*---------------------------------------------------------------
+        Storage Initialization
+---------------------------------------------------------------*/
+void storage_init(int backend, uint64_t now, uint32_t periodS)
+{
+    if (backend < 0 || backend >= sizeof(backends) / sizeof(backends[0]))
+        backend = STORAGE_EEPROM;
+
+    active = backends[backend];
+    activeIndex = backend;
+
+    /* unsynced records are spaced by the period, which has to fit one delta */
+    if (periodS > STORAGE_MAX_DELTA)
+    {
+        ESP_LOGE(TAG, "sampling period %lus is longer than a record delta, using %us", (unsigned long)periodS, STORAGE_MAX_DELTA);
+        periodS = STORAGE_MAX_DELTA;
+    }
+    period = periodS;
+    storageLock = xSemaphoreCreateMutexStatic(&storageLockBuffer);
+
+    if (active->open() != ESP_OK)
+    {
+        ESP_LOGE(TAG, "%s backend unavailable, falling back to %s", active->name, storageEeprom.name);
+        active = &storageEeprom;
+        activeIndex = STORAGE_EEPROM;
+        ESP_ERROR_CHECK(active->open());
+    }
+
+    /* the index spans the whole log and the records still in RAM, wider keyframe spacing for large media */
+    while ((active->capacity() + STORAGE_RECENT_RECORDS + keyframeRecords - 1) / keyframeRecords > STORAGE_KEYFRAME_SLOTS)
+        keyframeRecords *= 2;
+
+    /* continue the log of the previous boot when the medium still holds it */
+    bool resume = active->recover() == ESP_OK && active->count() > 0;
+    if (!resume)
+        active->reset(now);
+
+    storage_head_init();
+    if (resume)
+        storage_fill_gap(now);
+
+    ESP_LOGI(TAG, "%s log: %lu of %lu records, keyframe every %lu", active->name, (unsigned long)active->count(),
+             (unsigned long)active->capacity(), (unsigned long)keyframeRecords);
+}
+
+static void storage_fill_gap(uint64_t now)
+{
+    /* without a synced clock the gap is unknown, keep appending right after the head */
+    if (now < STORAGE_MIN_VALID_TIME || lastTime < STORAGE_MIN_VALID_TIME || now < lastTime)
+    {
+        ESP_LOGW(TAG, "clock not usable, history continues without a gap");
+        return;
+    }
+
+    if (now - lastTime <= period)
+        return;
+
+    /* one marker at boot, plus one for every delta the gap would overflow */
+    uint64_t markers = (now - lastTime + STORAGE_MAX_DELTA - 1) / STORAGE_MAX_DELTA;
+    uint32_t room = active->wraps ? active->capacity() : active->capacity() - active->count();
+
+    if (markers >= room)
+    {
+        ESP_LOGI(TAG, "history is older than the log can bridge, starting a new one");
+        active->reset(now);
+        storage_head_init();
+        return;
+    }
+
+    uint8_t samples[ZONE_COUNT];
+    memset(samples, STORAGE_NO_SAMPLE, sizeof(samples));
+
+    ESP_LOGI(TAG, "resuming history after %llus off", now - lastTime);
+    while (now - lastTime > STORAGE_MAX_DELTA)
+        storage_push(samples, lastTime + STORAGE_MAX_DELTA);
+    storage_push(samples, now);
+}
+
+static void storage_head_init(void)
+{
+    head.count = active->count();
+    head.timestamp = active->timestamp();
+    head.appended = head.count;
+    recentFirst = head.appended;
+    keyframeFirst = 0;
+    persisted = head.appended;
+
+    storage_index();
+}
+
+static void storage_index(void)
+{
+    uint16_t deltas[STORAGE_TIME_CHUNK];
+    uint32_t time = head.timestamp;
+    uint32_t count = active->count();
+
+    /* one pass over the deltas at boot, absolute indices start equal to the log's */
+    for (uint32_t i = 0; i < count;)
+    {
+        int read = active->read_deltas(i, deltas, count - i < STORAGE_TIME_CHUNK ? count - i : STORAGE_TIME_CHUNK);
+        if (read <= 0)
+        {
+            ESP_LOGW(TAG, "deltas unreadable from record %lu, index ends there", (unsigned long)i);
+            keyframeFirst = head.appended;
+            break;
+        }
+
+        for (int j = 0; j < read; j++, i++)
+        {
+            time += deltas[j];
+            if (i % keyframeRecords == 0)
+                keyframes[(i / keyframeRecords) % STORAGE_KEYFRAME_SLOTS] = time;
+        }
+    }
+
+    lastTime = time;
+    persistedTime = time;
+}
+
+const storage_backend_t *storage_backend(int backend)
+{
+    return backend >= 0 && backend < sizeof(backends) / sizeof(backends[0]) ? backends[backend] : NULL;
+}
+
+const storage_backend_t *storage_active(void)
+{
+    return active;
+}
+
+/*---------------------------------------------------------------
+        History Access
+---------------------------------------------------------------*/
+esp_err_t storage_append(const uint8_t samples[ZONE_COUNT], uint64_t timestamp)
+{
+    uint32_t time = storage_record_time(timestamp);
+    esp_err_t err;
+
+    /* the first synced time over a log started unsynced, whose times only count periods from nothing */
+    if (time >= STORAGE_MIN_VALID_TIME && lastTime < STORAGE_MIN_VALID_TIME)
+    {
+        ESP_LOGW(TAG, "clock synced, %lu undated records dropped, history restarts at %lu", (unsigned long)head.count,
+                 (unsigned long)time);
+
+        /* the records before it still go to the old log, the medium may be busy with a reader */
+        storage_write_begin();
+        restartPending = true;
+        restartAt = head.appended;
+        restartTime = time;
+        storage_write_end();
+        lastTime = time;
+    }
+
+    /* a gap longer than a delta can carry is bridged with markers */
+    if (time - lastTime > STORAGE_MAX_DELTA)
+    {
+        uint8_t markers[ZONE_COUNT];
+        memset(markers, STORAGE_NO_SAMPLE, sizeof(markers));
+
+        while (time - lastTime > STORAGE_MAX_DELTA)
+            if ((err = storage_push(markers, lastTime + STORAGE_MAX_DELTA)) != ESP_OK)
+                return err;
+    }
+
+    return storage_push(samples, time);
+}
+
+static uint32_t storage_record_time(uint64_t timestamp)
+{
+    /* until the clock is synced records follow the period, a log started unsynced is restarted by the first synced one */
+    if (timestamp < STORAGE_MIN_VALID_TIME)
+        return lastTime + period;
+    if (lastTime < STORAGE_MIN_VALID_TIME)
+        return timestamp;
+
+    /* a clock stepped back never reorders the log */
+    return timestamp > lastTime ? timestamp : lastTime;
+}
+
+static esp_err_t storage_push(const uint8_t samples[ZONE_COUNT], uint32_t time)
+{
+    /* never waits: a reader that kept the medium for a whole ring of records loses the oldest ones */
+    storage_write_begin();
+    memcpy(recent[head.appended % STORAGE_RECENT_RECORDS], samples, ZONE_COUNT);
+    recentTime[head.appended % STORAGE_RECENT_RECORDS] = time;
+    if (head.appended % keyframeRecords == 0)
+        keyframes[(head.appended / keyframeRecords) % STORAGE_KEYFRAME_SLOTS] = time;
+    head.appended++;
+    head.count++;
+    storage_write_end();
+
+    lastTime = time;
+
+    /* written now unless a reader holds the medium, it then writes the record before releasing it */
+    if (xSemaphoreTake(storageLock, 0) == pdTRUE)
+    {
+        storage_persist();
+        xSemaphoreGive(storageLock);
+    }
+    else
+    {
+        deferred++;
+    }
+
+    return ESP_OK;
+}
+
+static void storage_restart(uint32_t time)
+{
+    /* under storageLock, the new log counts from the given time and starts with the next record to persist */
+    esp_err_t err = active->reset(time);
+    if (err != ESP_OK)
+        ESP_LOGE(TAG, "log restart failed: %s", esp_err_to_name(err));
+
+    /* absolute indices carry on, readers holding the old log fail on the epoch */
+    storage_write_begin();
+    head.count = active->count() + (head.appended - persisted);
+    head.timestamp = active->timestamp();
+    head.epoch++;
+    recentFirst = persisted;
+    keyframeFirst = persisted;
+    storage_write_end();
+
+    persistedTime = time;
+}
+
+void storage_snapshot(storage_snapshot_t *snap)
+{
+    uint32_t seq;
+
+    do
+    {
+        seq = storage_read_begin();
+        *snap = head;
+    } while (storage_read_retry(seq));
+}
+
+int storage_read(const storage_snapshot_t *snap, int zone, uint32_t first, uint8_t *samples, uint16_t count)
+{
+    if (first >= snap->count)
+        return 0;
+
+    if (count > snap->count - first)
+        count = snap->count - first;
+
+    uint32_t start = snap->appended - snap->count + first; // absolute index of the first record
+    uint16_t fromMedium;
+    uint32_t epoch, seq;
+
+    /* the newest records come from the ring, copied again when an append lands meanwhile */
+    while (true)
+    {
+        seq = storage_read_begin();
+
+        uint32_t oldest = head.appended - recentFirst < STORAGE_RECENT_RECORDS ? recentFirst : head.appended - STORAGE_RECENT_RECORDS;
+        fromMedium = start >= oldest ? 0 : oldest - start < count ? oldest - start : count;
+        for (uint16_t i = fromMedium; i < count; i++)
+            samples[i] = recent[(start + i) % STORAGE_RECENT_RECORDS][zone];
+        epoch = head.epoch;
+
+        if (!storage_read_retry(seq))
+            break;
+        __atomic_fetch_add(&readRetries, 1, __ATOMIC_RELAXED);
+    }
+
+    if (epoch != snap->epoch)
+        return -1;
+
+    if (fromMedium == 0)
+        return count;
+
+    /* older records are all on the medium, at the same index as in the log */
+    xSemaphoreTake(storageLock, portMAX_DELAY);
+
+    if (head.epoch != snap->epoch)
+    {
+        xSemaphoreGive(storageLock);
+        return -1;
+    }
+
+    int64_t begin = esp_timer_get_time();
+    int read = active->read_range(zone, first, samples, fromMedium);
+    int64_t elapsed = esp_timer_get_time() - begin;
+
+    /* appends that arrived while the medium was busy */
+    storage_persist();
+
+    xSemaphoreGive(storageLock);
+
+    trace_record(TRACE_STORAGE_READ, activeIndex, elapsed);
+
+    return read == fromMedium ? count : read;
+}
+
+int storage_read_times(const storage_snapshot_t *snap, uint32_t first, uint64_t *times, uint16_t count)
+{
+    if (first >= snap->count)
+        return 0;
+
+    if (count > snap->count - first)
+        count = snap->count - first;
+
+    uint32_t oldest = snap->appended - snap->count; // absolute index of record 0
+    uint32_t start = oldest + first;
+    uint32_t anchor;
+    uint64_t anchorTime;
+    uint16_t fromMedium;
+    uint32_t epoch, seq;
+
+    /* recent times come from the ring, older ones are dated from the keyframe before them */
+    while (true)
+    {
+        seq = storage_read_begin();
+
+        uint32_t ringOldest = head.appended - recentFirst < STORAGE_RECENT_RECORDS ? recentFirst : head.appended - STORAGE_RECENT_RECORDS;
+        fromMedium = start >= ringOldest ? 0 : ringOldest - start < count ? ringOldest - start : count;
+        for (uint16_t i = fromMedium; i < count; i++)
+            times[i] = recentTime[(start + i) % STORAGE_RECENT_RECORDS];
+
+        /* before the first usable keyframe the log timestamp anchors record 0's delta */
+        anchor = start / keyframeRecords * keyframeRecords;
+        if (anchor >= oldest && anchor >= keyframeFirst)
+        {
+            anchorTime = keyframes[(anchor / keyframeRecords) % STORAGE_KEYFRAME_SLOTS];
+        }
+        else
+        {
+            anchor = oldest - 1;
+            anchorTime = snap->timestamp;
+        }
+        epoch = head.epoch;
+
+        if (!storage_read_retry(seq))
+            break;
+        __atomic_fetch_add(&readRetries, 1, __ATOMIC_RELAXED);
+    }
+
+    if (epoch != snap->epoch)
+        return -1;
+
+    if (fromMedium == 0)
+        return count;
+
+    xSemaphoreTake(storageLock, portMAX_DELAY);
+
+    if (head.epoch != snap->epoch)
+    {
+        xSemaphoreGive(storageLock);
+        return -1;
+    }
+
+    uint16_t deltas[STORAGE_TIME_CHUNK];
+    uint64_t time = anchorTime;
+    uint32_t next = anchor + 1 - oldest; // log index of the first delta after the anchor
+    uint32_t end = first + fromMedium;
+
+    if (anchor == start)
+        times[0] = anchorTime;
+
+    while (next < end)
+    {
+        int read = active->read_deltas(next, deltas, end - next < STORAGE_TIME_CHUNK ? end - next : STORAGE_TIME_CHUNK);
+        if (read <= 0)
+            break;
+
+        for (int j = 0; j < read; j++, next++)
+        {
+            time += deltas[j];
+            if (next >= first)
+                times[next - first] = time;
+        }
+    }
+
+    /* appends that arrived while the medium was busy */
+    storage_persist();
+
+    xSemaphoreGive(storageLock);
+
+    return next == end ? count : next > first ? next - first : 0;
+}
+
+int storage_seek(const storage_snapshot_t *snap, uint64_t timestamp)
+{
+    uint32_t oldest = snap->appended - snap->count;
+    uint32_t anchor, epoch, seq;
+
+    if (snap->count == 0)
+        return 0;
+
+    /* keyframes are evenly spaced in records, interpolating by time lands next to the right one under steady sampling */
+    do
+    {
+        seq = storage_read_begin();
+
+        uint32_t usable = oldest > keyframeFirst ? oldest : keyframeFirst;
+        uint32_t kFirst = (usable + keyframeRecords - 1) / keyframeRecords;
+        uint32_t kLast = (snap->appended - 1) / keyframeRecords;
+
+        anchor = oldest;
+        if (usable < snap->appended && kFirst <= kLast && keyframes[kFirst % STORAGE_KEYFRAME_SLOTS] < timestamp)
+        {
+            uint32_t n = kLast - kFirst;
+            uint64_t t0 = keyframes[kFirst % STORAGE_KEYFRAME_SLOTS];
+            uint64_t t1 = keyframes[kLast % STORAGE_KEYFRAME_SLOTS];
+            uint32_t k = timestamp < t1 && t1 > t0 ? (timestamp - t0) * n / (t1 - t0) : n;
+
+            /* the last keyframe strictly before the time, records can share a time */
+            while (k > 0 && keyframes[(kFirst + k) % STORAGE_KEYFRAME_SLOTS] >= timestamp)
+                k--;
+            while (k < n && keyframes[(kFirst + k + 1) % STORAGE_KEYFRAME_SLOTS] < timestamp)
+                k++;
+
+            anchor = (kFirst + k) * keyframeRecords;
+        }
+        epoch = head.epoch;
+    } while (storage_read_retry(seq));
+
+    if (epoch != snap->epoch)
+        return -1;
+
+    /* the next keyframe is not before the time, the record is within one interval of the anchor */
+    uint64_t times[STORAGE_TIME_CHUNK];
+    for (uint32_t i = anchor - oldest; i < snap->count;)
+    {
+        int read = storage_read_times(snap, i, times, STORAGE_TIME_CHUNK);
+        if (read <= 0)
+            return -1;
+
+        for (int j = 0; j < read; j++, i++)
+            if (times[j] >= timestamp)
+                return i;
+    }
+
+    return snap->count;
+}
+
+bool storage_last(int zone, uint8_t *moisture)
+{
+    storage_snapshot_t snap;
+    storage_snapshot(&snap);
+
+    if (snap.count == 0 || storage_read(&snap, zone, snap.count - 1, moisture, 1) != 1)
+        return false;
+
+    return *moisture <= 100;
+}
+
+uint32_t storage_count(void)
+{
+    storage_snapshot_t snap;
+    storage_snapshot(&snap);
+
+    return snap.count;
+}
+
+uint32_t storage_capacity(void)
+{
+    return active->capacity();
+}
+
+esp_err_t storage_flush(void)
+{
+    xSemaphoreTake(storageLock, portMAX_DELAY);
+    storage_persist();
+    esp_err_t err = active->flush();
+    xSemaphoreGive(storageLock);
+
+    return err;
+}
+
+void storage_stats(storage_stats_t *out)
+{
+    xSemaphoreTake(storageLock, portMAX_DELAY);
+    *out = stats;
+    xSemaphoreGive(storageLock);
+
+    out->deferred = deferred;
+    out->readRetries = readRetries;
+    out->dropped = __atomic_load_n(&dropped, __ATOMIC_RELAXED);
+}
+
+/*---------------------------------------------------------------
+        Medium Writes
+---------------------------------------------------------------*/
+static void storage_persist(void)
+{
+    /* under storageLock, records reach the medium in append order */
+    while (true)
+    {
+        uint8_t samples[ZONE_COUNT];
+        uint32_t time, appended, restart, seq;
+        bool restartNow;
+
+        /* the sampler never waits for this copy, it is repeated when an append lands meanwhile */
+        do
+        {
+            seq = storage_read_begin();
+            appended = head.appended;
+            memcpy(samples, recent[persisted % STORAGE_RECENT_RECORDS], ZONE_COUNT);
+            time = recentTime[persisted % STORAGE_RECENT_RECORDS];
+            restartNow = restartPending && (int32_t)(persisted - restartAt) >= 0;
+            restart = restartTime;
+        } while (storage_read_retry(seq));
+
+        if (persisted == appended)
+            break;
+
+        /* the ring went round while a reader held the medium, the records it overwrote are lost */
+        if (appended - persisted > STORAGE_RECENT_RECORDS)
+        {
+            uint32_t lost = appended - STORAGE_RECENT_RECORDS - persisted;
+
+            ESP_LOGW(TAG, "%lu records overwritten before they were stored", (unsigned long)lost);
+            __atomic_fetch_add(&dropped, lost, __ATOMIC_RELAXED);
+            persisted += lost;
+
+            storage_write_begin();
+            head.count = active->count() + (head.appended - persisted);
+            head.epoch++;
+            recentFirst = persisted;
+            keyframeFirst = persisted;
+            storage_write_end();
+            continue;
+        }
+
+        if (restartNow)
+        {
+            storage_write_begin();
+            restartPending = false;
+            storage_write_end();
+            storage_restart(restart);
+        }
+
+        uint32_t countBefore = active->count();
+        uint64_t timestampBefore = active->timestamp();
+
+        /* past lost records the gap can be longer than a delta, bridged with markers as the sampler does */
+        uint8_t markers[ZONE_COUNT];
+        memset(markers, STORAGE_NO_SAMPLE, sizeof(markers));
+        while (time - persistedTime > STORAGE_MAX_DELTA && storage_medium_append(markers, persistedTime + STORAGE_MAX_DELTA) == ESP_OK)
+            ;
+
+        int64_t start = esp_timer_get_time();
+        esp_err_t err = storage_medium_append(samples, time);
+        int64_t elapsed = esp_timer_get_time() - start;
+
+        stats.appends++;
+        stats.appendTotalUs += elapsed;
+        if (elapsed > stats.appendMaxUs)
+            stats.appendMaxUs = elapsed;
+
+        trace_record(TRACE_STORAGE_APPEND, activeIndex, elapsed);
+
+        if (err != ESP_OK)
+            ESP_LOGW(TAG, "record %lu not stored: %s", (unsigned long)persisted, esp_err_to_name(err));
+
+        persisted++;
+
+        /* a dropped record, a restart, markers or a dropped oldest sector shift the indices readers hold */
+        bool moved = err != ESP_OK || active->timestamp() != timestampBefore || active->count() != countBefore + 1;
+        uint32_t mediumCount = active->count();
+        uint64_t timestamp = active->timestamp();
+
+        storage_write_begin();
+        head.count = mediumCount + (head.appended - persisted);
+        head.timestamp = timestamp;
+        if (moved)
+            head.epoch++;
+        /* ring slots and keyframes before a dropped record no longer line up with the log */
+        if (err != ESP_OK)
+        {
+            recentFirst = persisted;
+            keyframeFirst = persisted;
+        }
+        storage_write_end();
+    }
+}
+
+static esp_err_t storage_medium_append(const uint8_t samples[ZONE_COUNT], uint32_t time)
+{
+    esp_err_t err = active->append(samples, time, time - persistedTime);
+
+    /* a log that does not wrap starts over once full, the record opens the new one */
+    if (err == ESP_ERR_NO_MEM && !active->wraps && active->count() > 0)
+    {
+        ESP_LOGI(TAG, "%s log full after %lu records, starting a new one", active->name, (unsigned long)active->count());
+        storage_restart(persistedTime);
+        err = active->append(samples, time, time - persistedTime);
+    }
+
+    if (err == ESP_OK)
+        persistedTime = time;
+    return err;
+}
+
+/*---------------------------------------------------------------
+        Head Sequence Lock
+---------------------------------------------------------------*/
+static void storage_write_begin(void)
+{
+    taskENTER_CRITICAL(&headLock);
+    __atomic_store_n(&headSeq, headSeq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+static void storage_write_end(void)
+{
+    __atomic_store_n(&headSeq, headSeq + 1, __ATOMIC_RELEASE);
+    taskEXIT_CRITICAL(&headLock);
+}
+
+static uint32_t storage_read_begin(void)
+{
+    uint32_t seq;
+
+    /* a writer on the other core finishes within a few stores, one on this core cannot be preempted */
+    while ((seq = __atomic_load_n(&headSeq, __ATOMIC_ACQUIRE)) & 1)
+        ;
+
+    return seq;
+}
+
+static bool storage_read_retry(uint32_t seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&headSeq, __ATOMIC_RELAXED) != seq;
+}
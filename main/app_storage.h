@@ -0,0 +1,90 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "app_zones.h"
+
+#define STORAGE_EEPROM 0 // external 25xx EEPROM, see app_eeprom.c
+#define STORAGE_FLASH 1  // "history" data partition, see app_flash_log.c
+
+#define STORAGE_NO_SAMPLE 0xFE // the node was off for this slot
+#define STORAGE_ERASED 0xFF    // never written
+#define STORAGE_MIN_VALID_TIME 1700000000 // earlier clocks are not synced yet
+#define STORAGE_RECENT_RECORDS 64         // newest records kept in RAM, reading them never touches the medium
+#define STORAGE_MAX_DELTA UINT16_MAX      // seconds a record can follow the previous one by, longer gaps get STORAGE_NO_SAMPLE markers
+#define STORAGE_KEYFRAME_RECORDS 64       // records between RAM time index entries, doubled until the whole log fits the index
+#define STORAGE_KEYFRAME_SLOTS 512        // RAM time index entries
+#define STORAGE_TIME_CHUNK 16             // deltas read from the medium per step while dating records
+
+/*
+ * A history log holds one record per sampling pass with one moisture byte
+ * per zone and the seconds since the previous record, the first record
+ * counting from the log timestamp. Records are addressed from the oldest
+ * one. Every STORAGE_KEYFRAME_RECORDS-th record's time is kept in RAM, so
+ * a record is dated, or a time found, from the nearest keyframe with a
+ * scan of at most one keyframe interval of deltas.
+ */
+struct storage_backend_t
+{
+    const char *name;
+    uint32_t endurance;    // program/erase cycles a cell is rated for
+    uint8_t cyclesPerWrap; // cycles the most worn cell takes each time the log fills
+    bool wraps;            // drops the oldest records when full instead of starting a new log
+
+    esp_err_t (*open)(void);
+    esp_err_t (*recover)(void); // rebuild the head from the medium after a reboot
+    esp_err_t (*reset)(uint64_t timestamp);
+    esp_err_t (*append)(const uint8_t samples[ZONE_COUNT], uint64_t timestamp, uint16_t deltaS); // deltaS since the previous record
+    int (*read_range)(int zone, uint32_t first, uint8_t *samples, uint16_t count);
+    int (*read_deltas)(uint32_t first, uint16_t *deltas, uint16_t count);
+    esp_err_t (*flush)(void);
+    uint32_t (*count)(void);
+    uint32_t (*capacity)(void);
+    uint64_t (*timestamp)(void); // time the oldest record's delta counts from
+    void (*wear)(uint32_t *bytesWritten, uint32_t *erases);
+};
+typedef struct storage_backend_t storage_backend_t;
+
+/*
+ * Consistent view of the log head, published by the writer under a sequence
+ * counter so readers never lock it and never see a count from one append
+ * with the timestamp of another. Indices into the log only stay valid while
+ * the epoch is unchanged; it moves when the log restarts or drops its oldest
+ * records, and a read against an older epoch fails instead of returning
+ * shifted samples.
+ */
+struct storage_snapshot_t
+{
+    uint32_t count;     // records in the log, including ones not on the medium yet
+    uint64_t timestamp; // time record 0's delta counts from
+    uint32_t epoch;     // indices are only comparable within one epoch
+    uint32_t appended;  // records appended since boot, the RAM ring is indexed by it
+};
+typedef struct storage_snapshot_t storage_snapshot_t;
+
+struct storage_stats_t
+{
+    uint32_t appends;
+    int64_t appendTotalUs;
+    int64_t appendMaxUs;
+    uint32_t deferred;    // appends that found a reader on the medium and left the write to the next one
+    uint32_t readRetries; // RAM copies repeated because an append landed during them
+    uint32_t dropped;     // records the RAM ring overwrote before a reader released the medium
+};
+typedef struct storage_stats_t storage_stats_t;
+
+void storage_init(int backend, uint64_t now, uint32_t periodS);
+const storage_backend_t *storage_backend(int backend);
+const storage_backend_t *storage_active(void);
+esp_err_t storage_append(const uint8_t samples[ZONE_COUNT], uint64_t timestamp);
+void storage_snapshot(storage_snapshot_t *snap);
+int storage_read(const storage_snapshot_t *snap, int zone, uint32_t first, uint8_t *samples, uint16_t count);
+int storage_read_times(const storage_snapshot_t *snap, uint32_t first, uint64_t *times, uint16_t count);
+int storage_seek(const storage_snapshot_t *snap, uint64_t timestamp);
+bool storage_last(int zone, uint8_t *moisture);
+uint32_t storage_count(void);
+uint32_t storage_capacity(void);
+esp_err_t storage_flush(void);
+void storage_stats(storage_stats_t *stats);
@@ -0,0 +1,253 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+
+#include "app_jitter.h"
+#include "app_storm.h"
+
+struct storm_bit_t
+{
+    uint32_t posts;
+    uint32_t merged;
+    uint32_t dispatched;
+    int64_t firstUs; // first post since the last dispatch, 0 when not pending
+    jitter_stats_t latency;
+};
+typedef struct storm_bit_t storm_bit_t;
+
+struct storm_step_t
+{
+    uint32_t posts;
+    uint32_t merged;
+    uint32_t dispatched;
+    uint32_t wakes;
+    uint32_t lostWakes;
+    uint32_t depthSum;
+    uint32_t depthMax;
+    int64_t lastDispatchUs;
+    jitter_stats_t latency;
+};
+typedef struct storm_step_t storm_step_t;
+
+static void storm_step_print(int rate, int events, int64_t startUs, int64_t injectedUs, const storm_step_t *step,
+                             const uint32_t *unsafe);
+
+static const char *sourceNames[STORM_TOTAL_SOURCES] = {
+    [STORM_TIMER] = "timer",
+    [STORM_CLOUD] = "cloud",
+    [STORM_CONSOLE] = "console",
+};
+
+static const char *unsafeNames[STORM_TOTAL_UNSAFE] = {
+    "pump on while not watering",
+    "duplicate pump task",
+    "supply over budget",
+};
+
+static volatile bool running = false;
+static storm_bit_t bits[STORM_ACTION_BITS];
+static storm_step_t step;
+static portMUX_TYPE stormLock = portMUX_INITIALIZER_UNLOCKED;
+
+/*---------------------------------------------------------------
+        Main Loop Hooks
+---------------------------------------------------------------*/
+void storm_posted(uint16_t pending, uint16_t posted)
+{
+    if (!running)
+        return;
+
+    int64_t nowUs = esp_timer_get_time();
+
+    /* the timer alarm posts from its ISR, the other hooks from tasks */
+    portENTER_CRITICAL_SAFE(&stormLock);
+    for (int bit = 0; bit < STORM_ACTION_BITS; bit++)
+    {
+        if (!(posted & (1 << bit)))
+            continue;
+
+        bits[bit].posts++;
+        step.posts++;
+        if (pending & (1 << bit))
+        {
+            bits[bit].merged++;
+            step.merged++;
+        }
+        else
+        {
+            bits[bit].firstUs = nowUs;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&stormLock);
+}
+
+void storm_woken(bool given)
+{
+    if (!running)
+        return;
+
+    portENTER_CRITICAL_SAFE(&stormLock);
+    if (!given)
+        step.lostWakes++;
+    portEXIT_CRITICAL_SAFE(&stormLock);
+}
+
+void storm_dispatched(uint16_t dispatched)
+{
+    if (!running)
+        return;
+
+    int64_t nowUs = esp_timer_get_time();
+
+    portENTER_CRITICAL_SAFE(&stormLock);
+    for (int bit = 0; bit < STORM_ACTION_BITS; bit++)
+    {
+        /* a bit posted before the storm started has no first post */
+        if (!(dispatched & (1 << bit)) || bits[bit].firstUs == 0)
+            continue;
+
+        jitter_stats_add(&bits[bit].latency, nowUs - bits[bit].firstUs);
+        jitter_stats_add(&step.latency, nowUs - bits[bit].firstUs);
+        bits[bit].firstUs = 0;
+        bits[bit].dispatched++;
+        step.dispatched++;
+        step.lastDispatchUs = nowUs;
+    }
+    portEXIT_CRITICAL_SAFE(&stormLock);
+}
+
+/* one wakeup of the loop, pending is its queue depth in distinct actions */
+void storm_wake(uint16_t pending)
+{
+    if (!running)
+        return;
+
+    uint32_t depth = __builtin_popcount(pending);
+
+    portENTER_CRITICAL_SAFE(&stormLock);
+    step.wakes++;
+    step.depthSum += depth;
+    if (depth > step.depthMax)
+        step.depthMax = depth;
+    portEXIT_CRITICAL_SAFE(&stormLock);
+}
+
+/*---------------------------------------------------------------
+        Storm Run
+---------------------------------------------------------------*/
+void storm_run(int eventsPerStep, storm_inject_fn_t inject, storm_check_fn_t check, const char *const *bitNames)
+{
+    static const int rates[] = STORM_RATES_PER_S;
+    uint32_t unsafeTotal = 0;
+    int saturatedAt = 0;
+
+    portENTER_CRITICAL_SAFE(&stormLock);
+    memset(bits, 0, sizeof(bits));
+    portEXIT_CRITICAL_SAFE(&stormLock);
+
+    printf("%d events per step in bursts of %d, rotating %s, %s and %s\n", eventsPerStep, STORM_BURST,
+           sourceNames[STORM_TIMER], sourceNames[STORM_CLOUD], sourceNames[STORM_CONSOLE]);
+    printf("%7s %7s %6s %6s %6s %6s %9s %6s %6s %9s %9s %s\n", "rate/s", "sent/s", "posts", "merged", "lost", "disp",
+           "disp/s", "depth", "max", "avg lat", "max lat", "unsafe");
+
+    for (int r = 0; r < sizeof(rates) / sizeof(rates[0]); r++)
+    {
+        uint32_t unsafe[STORM_TOTAL_UNSAFE] = {0};
+        int seq = 0;
+
+        portENTER_CRITICAL_SAFE(&stormLock);
+        memset(&step, 0, sizeof(step));
+        for (int bit = 0; bit < STORM_ACTION_BITS; bit++)
+            bits[bit].firstUs = 0;
+        running = true;
+        portEXIT_CRITICAL_SAFE(&stormLock);
+
+        /* bursts of one source after the other, spaced to the step's rate; past one tick per burst it runs flat out */
+        int64_t startUs = esp_timer_get_time();
+        while (seq < eventsPerStep)
+        {
+            for (int i = 0; i < STORM_BURST && seq < eventsPerStep; i++, seq++)
+                inject((seq / STORM_BURST) % STORM_TOTAL_SOURCES, seq);
+
+            uint32_t found = check();
+            for (int u = 0; u < STORM_TOTAL_UNSAFE; u++)
+                unsafe[u] += (found >> u) & 1;
+
+            int64_t nextUs = startUs + 1000000LL * seq / rates[r];
+            int64_t waitUs = nextUs - esp_timer_get_time();
+            if (waitUs >= 1000LL * portTICK_PERIOD_MS)
+                vTaskDelay(waitUs / 1000 / portTICK_PERIOD_MS);
+            else
+                taskYIELD();
+        }
+        int64_t injectedUs = esp_timer_get_time();
+
+        for (int t = 0; t < STORM_DRAIN_MS / STORM_CHECK_PERIOD_MS; t++)
+        {
+            vTaskDelay(pdMS_TO_TICKS(STORM_CHECK_PERIOD_MS));
+
+            uint32_t found = check();
+            for (int u = 0; u < STORM_TOTAL_UNSAFE; u++)
+                unsafe[u] += (found >> u) & 1;
+        }
+
+        storm_step_t copy;
+        portENTER_CRITICAL_SAFE(&stormLock);
+        running = false;
+        copy = step;
+        portEXIT_CRITICAL_SAFE(&stormLock);
+
+        storm_step_print(rates[r], eventsPerStep, startUs, injectedUs, &copy, unsafe);
+
+        if (saturatedAt == 0 && copy.merged > 0)
+            saturatedAt = rates[r];
+        for (int u = 0; u < STORM_TOTAL_UNSAFE; u++)
+            unsafeTotal |= unsafe[u] ? 1 << u : 0;
+    }
+
+    for (int bit = 0; bit < STORM_ACTION_BITS; bit++)
+    {
+        if (bits[bit].posts == 0)
+            continue;
+
+        char name[96];
+        snprintf(name, sizeof(name), "%s: %lu posts, %lu merged, %lu dispatched, latency", bitNames[bit] ? bitNames[bit] : "?",
+                 (unsigned long)bits[bit].posts, (unsigned long)bits[bit].merged, (unsigned long)bits[bit].dispatched);
+        jitter_stats_print(name, &bits[bit].latency);
+    }
+
+    if (saturatedAt)
+        printf("events start merging at %d/s\n", saturatedAt);
+    else
+        printf("no events merged up to %d/s\n", rates[sizeof(rates) / sizeof(rates[0]) - 1]);
+
+    for (int u = 0; u < STORM_TOTAL_UNSAFE; u++)
+        if (unsafeTotal & (1 << u))
+            printf("UNSAFE: %s\n", unsafeNames[u]);
+    printf("storm %s\n", unsafeTotal ? "FAILED" : "passed");
+}
+
+static void storm_step_print(int rate, int events, int64_t startUs, int64_t injectedUs, const storm_step_t *s,
+                             const uint32_t *unsafe)
+{
+    /* throughput over the time the loop was busy, until the last dispatch if it ran past the injection */
+    int64_t injectUs = injectedUs - startUs;
+    int64_t busyUs = (s->lastDispatchUs > injectedUs ? s->lastDispatchUs : injectedUs) - startUs;
+
+    char flags[24] = "-";
+    int length = 0;
+    for (int u = 0; u < STORM_TOTAL_UNSAFE; u++)
+        if (unsafe[u])
+            length += snprintf(flags + length, sizeof(flags) - length, "%s%c%lu", length ? " " : "", "PDS"[u],
+                               (unsigned long)unsafe[u]);
+
+    printf("%7d %7lld %6lu %6lu %6lu %6lu %9lld %6lu %6lu %7lldus %7lldus %s\n", rate,
+           1000000LL * events / (injectUs > 0 ? injectUs : 1), (unsigned long)s->posts, (unsigned long)s->merged,
+           (unsigned long)s->lostWakes, (unsigned long)s->dispatched, 1000000LL * s->dispatched / (busyUs > 0 ? busyUs : 1),
+           (unsigned long)(s->wakes ? s->depthSum / s->wakes : 0), (unsigned long)s->depthMax,
+           s->latency.count ? s->latency.sum / s->latency.count : 0LL, s->latency.max, flags);
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define STORM_RATES_PER_S {20, 50, 100, 200, 500, 1000, 2000, 5000} // injection rate of each step
+#define STORM_BURST 4                                                // events injected back to back
+#define STORM_DRAIN_MS 2000                                          // quiet time after a step for the loop to catch up
+#define STORM_CHECK_PERIOD_MS 10                                     // safety checks while draining
+#define STORM_ACTION_BITS 16
+
+/*
+ * Event-storm harness for the main loop. Storms of timer, cloud-write and
+ * console events are injected at each rate in turn. The loop's action bits
+ * are instrumented while a storm runs: a post whose bit is still pending is
+ * merged, a semaphore give that finds it already given loses a wakeup, and
+ * the time from a bit's first post to its dispatch is its latency. The
+ * safety check runs after every burst and while the loop drains; the
+ * unsafe column counts the checks that found each state (P, D, S).
+ */
+enum storm_source_t
+{
+    STORM_TIMER,   // sampling alarm
+    STORM_CLOUD,   // RainMaker write through the parameter dispatcher
+    STORM_CONSOLE, // command line through the console parser
+    STORM_TOTAL_SOURCES,
+};
+typedef enum storm_source_t storm_source_t;
+
+enum storm_unsafe_t
+{
+    STORM_UNSAFE_PUMP_IDLE = 0x01, // pump output on while its zone is not watering
+    STORM_UNSAFE_DUPLICATE = 0x02, // two pump tasks alive for one zone
+    STORM_UNSAFE_SUPPLY = 0x04,    // more pumps on than the supply feeds
+    STORM_TOTAL_UNSAFE = 3,
+};
+typedef enum storm_unsafe_t storm_unsafe_t;
+
+typedef void (*storm_inject_fn_t)(storm_source_t source, int seq);
+typedef uint32_t (*storm_check_fn_t)(void); // storm_unsafe_t flags of the states found
+
+/* posted and dispatched are called under the loop's action lock, all are no-ops unless a storm runs */
+void storm_posted(uint16_t pending, uint16_t bits);
+void storm_woken(bool given);
+void storm_dispatched(uint16_t bits);
+void storm_wake(uint16_t pending);
+
+void storm_run(int eventsPerStep, storm_inject_fn_t inject, storm_check_fn_t check, const char *const *bitNames);
@@ -0,0 +1,32 @@
+#pragma once
+#include "freertos/FreeRTOS.h"
+
+/*
+ * Task placement and priority plan.
+ *
+ * PRO_CPU keeps the network stack: Wi-Fi (23), lwIP (18), MQTT (5) and the
+ * RainMaker work queue (5), see sdkconfig.defaults for their pinning.
+ * APP_CPU runs the control path (main loop, sensing, actuation) with
+ * priorities above the app-level network tasks, so publish bursts cannot
+ * delay a sample or a pump stop. Background work stays below them on PRO_CPU.
+ */
+#if CONFIG_FREERTOS_UNICORE
+#define TASK_CORE_CONTROL 0
+#define TASK_CORE_NETWORK 0
+#else
+#define TASK_CORE_CONTROL APP_CPU_NUM
+#define TASK_CORE_NETWORK PRO_CPU_NUM
+#endif
+
+/* control path, APP_CPU */
+#define TASK_PRIO_PUMP 12    // pump stop is the tightest deadline
+#define TASK_PRIO_SENSOR 11  // sample start right after the timer alarm
+#define TASK_PRIO_CONTROL 10 // main loop dispatching actions
+
+/* background, PRO_CPU, below MQTT and RainMaker */
+#define TASK_PRIO_HISTORY 4
+#define TASK_PRIO_EXPORT 4
+#define TASK_PRIO_CONSOLE 3
+#define TASK_PRIO_BENCH 2
+#define TASK_PRIO_OTA 2 // console update, the RainMaker one runs in its own task
+#define TASK_PRIO_LOG 1 // tokenized log drainer, output only goes out when nothing else runs
@@ -0,0 +1,293 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "app_mem.h"
+#include "app_tlog.h"
+
+struct tlog_record_t
+{
+    atomic_uint seq;      // ring position it holds, +1 once written, +TLOG_RING_SIZE once drained
+    uint32_t timestampUs; // low word of esp_timer_get_time()
+    uint16_t token;
+    uint8_t argc;
+    uint32_t args[TLOG_MAX_ARGS];
+};
+typedef struct tlog_record_t tlog_record_t;
+
+struct tlog_format_t
+{
+    esp_log_level_t level;
+    const char *format;
+};
+typedef struct tlog_format_t tlog_format_t;
+
+_Static_assert((TLOG_RING_SIZE & (TLOG_RING_SIZE - 1)) == 0, "TLOG_RING_SIZE must be a power of two");
+
+static void tlog_task(void *arg);
+static void tlog_render(const tlog_record_t *record, int64_t nowUs);
+static void tlog_format(char *message, size_t size, const char *format, const uint32_t args[TLOG_MAX_ARGS]);
+
+#define TLOG_FORMAT_ENTRY(token, level, format) [token] = {level, format},
+
+static const tlog_format_t formats[TLOG_TOTAL_TOKENS] = {TLOG_FORMATS(TLOG_FORMAT_ENTRY)};
+
+static tlog_record_t ring[TLOG_RING_SIZE];
+static atomic_uint head = 0; // next position handed to a writer
+static uint32_t tail = 0;    // next position to drain, drainer only
+static atomic_uint written = 0;
+static atomic_uint dropped = 0;
+static uint32_t highWater = 0;
+static bool raw = false;
+
+static TaskHandle_t tlogTaskHandle = NULL;
+static SemaphoreHandle_t drained = NULL;
+static StaticSemaphore_t drainedBuffer;
+
+static const char *TAG = "ASE-PROJECT-TLOG";
+
+/*---------------------------------------------------------------
+        Tokenized Log Initialization
+---------------------------------------------------------------*/
+void tlog_init(void)
+{
+    for (uint32_t i = 0; i < TLOG_RING_SIZE; i++)
+        atomic_init(&ring[i].seq, i);
+
+    drained = xSemaphoreCreateBinaryStatic(&drainedBuffer);
+
+    ESP_LOGI(TAG, "%d formats, %d record ring", TLOG_TOTAL_TOKENS, TLOG_RING_SIZE);
+
+    ESP_ERROR_CHECK(mem_task_start(MEM_TASK_LOG, 0, tlog_task, NULL, &tlogTaskHandle));
+}
+
+/*---------------------------------------------------------------
+        Producers
+---------------------------------------------------------------*/
+bool tlog_event(tlog_token_t token, int argc, const uint32_t args[TLOG_MAX_ARGS])
+{
+    unsigned pos = atomic_load_explicit(&head, memory_order_relaxed);
+    tlog_record_t *record;
+
+    /* claim a slot, lock-free so any task or ISR on either core can log */
+    while (1)
+    {
+        record = &ring[pos & (TLOG_RING_SIZE - 1)];
+        int diff = (int)(atomic_load_explicit(&record->seq, memory_order_acquire) - pos);
+
+        if (diff == 0)
+        {
+            if (atomic_compare_exchange_weak_explicit(&head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            /* the drainer is a whole ring behind, drop rather than stall the caller */
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return false;
+        }
+        else
+        {
+            pos = atomic_load_explicit(&head, memory_order_relaxed);
+        }
+    }
+
+    record->timestampUs = (uint32_t)esp_timer_get_time();
+    record->token = token;
+    record->argc = argc;
+    memcpy(record->args, args, sizeof(record->args));
+
+    atomic_store_explicit(&record->seq, pos + 1, memory_order_release);
+    atomic_fetch_add_explicit(&written, 1, memory_order_relaxed);
+    return true;
+}
+
+uint32_t tlog_free(void)
+{
+    return TLOG_RING_SIZE - (atomic_load_explicit(&head, memory_order_relaxed) - tail);
+}
+
+bool tlog_wait_free(TickType_t timeout)
+{
+    TimeOut_t timeOut;
+
+    vTaskSetTimeOutState(&timeOut);
+
+    /* the drainer gives the semaphore after every pass that freed slots */
+    while (tlog_free() == 0)
+    {
+        if (xTaskCheckForTimeOut(&timeOut, &timeout) == pdTRUE)
+            return false;
+        xSemaphoreTake(drained, timeout);
+    }
+    return true;
+}
+
+/*---------------------------------------------------------------
+        Drainer
+---------------------------------------------------------------*/
+static void tlog_task(void *arg)
+{
+    while (1)
+    {
+        vTaskDelay(pdMS_TO_TICKS(TLOG_DRAIN_PERIOD_MS));
+
+        uint32_t pending = atomic_load_explicit(&head, memory_order_relaxed) - tail;
+        uint32_t start = tail;
+        if (pending > highWater)
+            highWater = pending;
+
+        while (1)
+        {
+            tlog_record_t *record = &ring[tail & (TLOG_RING_SIZE - 1)];
+
+            /* a claimed slot may still be filled in, it is picked up on the next pass */
+            if (atomic_load_explicit(&record->seq, memory_order_acquire) != tail + 1)
+                break;
+
+            tlog_render(record, esp_timer_get_time());
+
+            atomic_store_explicit(&record->seq, tail + TLOG_RING_SIZE, memory_order_release);
+            tail++;
+        }
+
+        if (tail != start)
+            xSemaphoreGive(drained);
+    }
+}
+
+static void tlog_render(const tlog_record_t *record, int64_t nowUs)
+{
+    const uint32_t *a = record->args;
+
+    if (record->token >= TLOG_TOTAL_TOKENS)
+        return;
+
+    /* records are drained long before the 32-bit stamp wraps, extend it from the current time */
+    int64_t timestampMs = (nowUs - (uint32_t)((uint32_t)nowUs - record->timestampUs)) / 1000;
+
+    if (raw)
+    {
+        /* tools/decode_log.py renders these lines with the format table */
+        printf("#TL %u %lld %u", record->token, timestampMs, record->argc);
+        for (int i = 0; i < record->argc; i++)
+            printf(" %lx", (unsigned long)a[i]);
+        printf("\n");
+        return;
+    }
+
+    const tlog_format_t *entry = &formats[record->token];
+    char message[128];
+
+    tlog_format(message, sizeof(message), entry->format, a);
+    esp_log_write(entry->level, TAG, "%c (%lld) %s: %s\n", "NEWIDV"[entry->level], timestampMs, TAG, message);
+}
+
+/*
+ * Renders a format from the table one conversion at a time, each with a literal
+ * format so the compiler checks it. Takes the subset tools/decode_log.py reads:
+ * '-' and '0' flags, a width, l/h modifiers ignored and d, i, u, x, X, c and %.
+ */
+static void tlog_format(char *message, size_t size, const char *format, const uint32_t args[TLOG_MAX_ARGS])
+{
+    size_t len = 0;
+    int next = 0;
+
+    while (*format && len + 1 < size)
+    {
+        if (*format != '%')
+        {
+            message[len++] = *format++;
+            continue;
+        }
+        format++;
+
+        bool zero = false;
+        bool left = false;
+        for (; *format == '-' || *format == '0'; format++)
+        {
+            if (*format == '-')
+                left = true;
+            else
+                zero = true;
+        }
+
+        int width = 0;
+        for (; *format >= '0' && *format <= '9'; format++)
+            width = width * 10 + (*format - '0');
+        while (*format == 'l' || *format == 'h')
+            format++;
+
+        char conversion = *format;
+        if (conversion == '\0')
+            break;
+        format++;
+
+        if (conversion == '%')
+        {
+            message[len++] = '%';
+            continue;
+        }
+
+        /* a negative width left-justifies, a missing argument prints as 0 like the decoder */
+        uint32_t value = next < TLOG_MAX_ARGS ? args[next++] : 0;
+        width = left ? -width : width;
+        int n;
+
+        switch (conversion)
+        {
+        case 'd':
+        case 'i':
+            n = snprintf(message + len, size - len, zero ? "%0*ld" : "%*ld", width, (long)(int32_t)value);
+            break;
+        case 'u':
+            n = snprintf(message + len, size - len, zero ? "%0*lu" : "%*lu", width, (unsigned long)value);
+            break;
+        case 'x':
+            n = snprintf(message + len, size - len, zero ? "%0*lx" : "%*lx", width, (unsigned long)value);
+            break;
+        case 'X':
+            n = snprintf(message + len, size - len, zero ? "%0*lX" : "%*lX", width, (unsigned long)value);
+            break;
+        case 'c':
+            n = snprintf(message + len, size - len, "%*c", width, (int)(value & 0xFF));
+            break;
+        default:
+            n = snprintf(message + len, size - len, "%%%c", conversion);
+            break;
+        }
+
+        if (n > 0)
+            len += n;
+    }
+
+    /* snprintf stops at the end of the buffer, len may point past it */
+    message[len < size ? len : size - 1] = '\0';
+}
+
+/*---------------------------------------------------------------
+        Settings and Statistics
+---------------------------------------------------------------*/
+void tlog_set_raw(bool enable)
+{
+    raw = enable;
+}
+
+bool tlog_get_raw(void)
+{
+    return raw;
+}
+
+void tlog_stats(tlog_stats_t *stats)
+{
+    stats->written = atomic_load_explicit(&written, memory_order_relaxed);
+    stats->dropped = atomic_load_explicit(&dropped, memory_order_relaxed);
+    stats->highWater = highWater;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "freertos/FreeRTOS.h"
+
+#include "esp_log.h"
+
+#define TLOG_RING_SIZE 256 // records, power of two
+#define TLOG_MAX_ARGS 4
+#define TLOG_DRAIN_PERIOD_MS 50
+
+/*
+ * Format table of the control-path log sites. Only the token and the raw
+ * arguments are recorded, the drainer task renders them later or prints
+ * them raw for tools/decode_log.py, which parses this list. Arguments are
+ * 32-bit words: formats may only use 32-bit integer conversions (%d %u %x
+ * %lu %c), pass enums instead of strings. Append new entries at the end so
+ * captures stay decodable.
+ */
+#define TLOG_FORMATS(X)                                                                                    \
+    X(TLOG_MANUAL_READ_CACHED, ESP_LOG_INFO, "MANUAL_SENSOR_READ: zone %d %u from cache")                  \
+    X(TLOG_AUTO_WATERING_SET, ESP_LOG_INFO, "AUTO_WATERING zone %d SET TO %u")                             \
+    X(TLOG_AUTO_WATERING_ENTER, ESP_LOG_INFO, "ENTERING AUTO_WATERING zone %d")                            \
+    X(TLOG_MANUAL_WATERING_ENTER, ESP_LOG_INFO, "ENTERING MANUAL_WATERING zone %d")                        \
+    X(TLOG_RMAKER_WRITE, ESP_LOG_INFO, "Received write request via : source %d")                           \
+    X(TLOG_RMAKER_AUTO_WATERING, ESP_LOG_INFO, "RECEIVED_AUTO_WATERING_EN zone %d: %u")                    \
+    X(TLOG_SENSOR_STORED, ESP_LOG_INFO, "SENSOR_TASK: AUTO_SENSOR_READ stored (%u%% in zone 0)")           \
+    X(TLOG_SENSOR_FULL, ESP_LOG_WARN, "SENSOR_TASK: sample not stored")                                    \
+    X(TLOG_SENSOR_CLOUD, ESP_LOG_INFO, "SENSOR_TASK: zone %d %d UPDATED IN THE CLOUD")                     \
+    X(TLOG_PUMP_ENTER, ESP_LOG_INFO, "PUMP_TASK: zone %d ENTERING")                                        \
+    X(TLOG_PUMP_AUTO_READ, ESP_LOG_INFO, "PUMP_TASK: zone %d AUTO_WATERING moisture read: %u")             \
+    X(TLOG_PUMP_AUTO_RUN, ESP_LOG_INFO, "PUMP_TASK: zone %d AUTO_WATERING for %u seconds")                 \
+    X(TLOG_PUMP_MANUAL_RUN, ESP_LOG_INFO, "PUMP_TASK: zone %d MANUAL_WATERING for %u seconds")             \
+    X(TLOG_PUMP_END, ESP_LOG_INFO, "PUMP_TASK: zone %d WATERING CYCLE ENDED")                              \
+    X(TLOG_PUMP_WAIT_SUPPLY, ESP_LOG_INFO, "PUMP_TASK: zone %d waiting for the supply (%d pumps running)") \
+    X(TLOG_HISTORY_VALUE, ESP_LOG_INFO, "HISTORY VALUE zone %d [%lu] = %u | time = %lu")                   \
+    X(TLOG_PUMP_AUTO_PLAN, ESP_LOG_INFO, "PUMP_TASK: zone %d at %u%%, next run in %lu s for %u s")          \
+    X(TLOG_PUMP_AUTO_EARLY, ESP_LOG_INFO, "SENSOR_TASK: zone %d dries faster than planned, replanning")    \
+    X(TLOG_DEADLINE_SHED, ESP_LOG_WARN, "DEADLINE: job %d %lu ms late, shed level %d")                     \
+    X(TLOG_SCHEDULE_RUN, ESP_LOG_INFO, "SCHEDULE: rule %d zone %d watering %u s, %lu s into its window")   \
+    X(TLOG_SCHEDULE_SKIP, ESP_LOG_INFO, "SCHEDULE: rule %d zone %d skipped at %u%%, target %u%%")          \
+    X(TLOG_SCHEDULE_MISSED, ESP_LOG_WARN, "SCHEDULE: rule %d zone %d window closed before it could run")   \
+    X(TLOG_SENSOR_ALARM, ESP_LOG_WARN, "ALARM_SENSOR_READ: zone %d crossed its moisture monitor threshold")\
+    X(TLOG_SCHEDULE_WAIT, ESP_LOG_INFO, "SCHEDULE: rule %d zone %d waits for a settled sample")            \
+    X(TLOG_SENSOR_CROSSING, ESP_LOG_INFO, "SENSOR_TASK: extra sample in %lu ms, ahead of a predicted crossing")
+
+#define TLOG_TOKEN_ENUM(token, level, format) token,
+
+enum tlog_token_t
+{
+    TLOG_FORMATS(TLOG_TOKEN_ENUM)
+    TLOG_TOTAL_TOKENS,
+};
+typedef enum tlog_token_t tlog_token_t;
+
+/* records a log event, the arguments are copied as raw words and never formatted here */
+#define TLOG(token, ...)                                                             \
+    tlog_event(token, sizeof((uint32_t[]){0, ##__VA_ARGS__}) / sizeof(uint32_t) - 1, \
+               (const uint32_t[TLOG_MAX_ARGS]){__VA_ARGS__})
+
+struct tlog_stats_t
+{
+    uint32_t written;
+    uint32_t dropped;   // events lost to a full ring
+    uint32_t highWater; // most records waiting at once
+};
+typedef struct tlog_stats_t tlog_stats_t;
+
+void tlog_init(void);
+bool tlog_event(tlog_token_t token, int argc, const uint32_t args[TLOG_MAX_ARGS]);
+uint32_t tlog_free(void);
+bool tlog_wait_free(TickType_t timeout);
+void tlog_set_raw(bool raw);
+bool tlog_get_raw(void);
+void tlog_stats(tlog_stats_t *stats);
@@ -0,0 +1,180 @@
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/timers.h"
+
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_diagnostics.h"
+
+#include "app_trace.h"
+
+struct trace_ring_t
+{
+    uint32_t magic;
+    uint32_t boots;
+    trace_event_t events[TRACE_RING_SIZE];
+};
+typedef struct trace_ring_t trace_ring_t;
+
+_Static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "TRACE_RING_SIZE must be a power of two");
+
+static int trace_collect(const trace_ring_t *source, trace_event_t *events);
+static void trace_print_events(const trace_event_t *events, int count);
+static void trace_report_cb(TimerHandle_t timer);
+
+static const char *typeNames[TRACE_TOTAL_TYPES] = {
+    [TRACE_NONE] = "-",
+    [TRACE_BOOT] = "boot",
+    [TRACE_ACTION] = "action",
+    [TRACE_SAMPLE] = "sample",
+    [TRACE_PUMP_ON] = "pump on",
+    [TRACE_PUMP_OFF] = "pump off",
+    [TRACE_STORAGE_APPEND] = "storage append",
+    [TRACE_STORAGE_READ] = "storage read",
+    [TRACE_PUBLISH_MOISTURE] = "publish moisture",
+    [TRACE_PUBLISH_STATUS] = "publish status",
+    [TRACE_PUBLISH_AUTO] = "publish auto",
+    [TRACE_PUBLISH_TIME] = "publish time",
+    [TRACE_PUBLISH_EXPORT] = "publish export",
+    [TRACE_ALERT] = "alert",
+    [TRACE_SHED_LEVEL] = "shed level",
+    [TRACE_SCHEDULE] = "schedule",
+};
+
+/* left alone by the bootloader, so it still holds the events before a panic or watchdog reset */
+static RTC_NOINIT_ATTR trace_ring_t ring;
+
+static atomic_uint next = 0; // only needed for this boot, the event timestamps carry the order
+
+/* the previous boot's events, oldest first */
+static trace_event_t previous[TRACE_RING_SIZE];
+static int previousCount = 0;
+static esp_reset_reason_t previousReason = ESP_RST_UNKNOWN;
+
+static int reportNext = 0; // next previous-boot event to upload, timer task only
+static StaticTimer_t reportTimerBuffer;
+static TimerHandle_t reportTimer = NULL;
+
+static const char *TAG = "ASE-PROJECT-TRACE";
+
+/*---------------------------------------------------------------
+        Trace Initialization
+---------------------------------------------------------------*/
+void trace_init(void)
+{
+    previousReason = esp_reset_reason();
+
+    /* after power-on the RTC memory holds noise, only trust a ring this firmware set up */
+    if (ring.magic == TRACE_MAGIC && previousReason != ESP_RST_POWERON)
+    {
+        previousCount = trace_collect(&ring, previous);
+
+        ESP_LOGW(TAG, "boot %lu, previous boot ended with reset reason %d, its last %d events:", (unsigned long)ring.boots,
+                 previousReason, previousCount);
+        trace_print_events(previous, previousCount);
+    }
+    else
+    {
+        ring.boots = 0;
+    }
+
+    memset(ring.events, 0, sizeof(ring.events));
+    ring.magic = TRACE_MAGIC;
+    ring.boots++;
+
+    trace_record(TRACE_BOOT, 0, previousReason);
+}
+
+/*---------------------------------------------------------------
+        Recording
+---------------------------------------------------------------*/
+void trace_record(trace_type_t type, int zone, uint32_t value)
+{
+    unsigned index = atomic_fetch_add_explicit(&next, 1, memory_order_relaxed) & (TRACE_RING_SIZE - 1);
+    trace_event_t *event = &ring.events[index];
+
+    /* a reset in the middle leaves at most this one event torn */
+    event->time = (uint32_t)(esp_timer_get_time() >> 10);
+    event->type = type;
+    event->zone = zone;
+    event->value = value > UINT16_MAX ? UINT16_MAX : value;
+}
+
+/*---------------------------------------------------------------
+        Post-mortem Output
+---------------------------------------------------------------*/
+void trace_report(void)
+{
+    if (previousCount == 0)
+        return;
+
+    /* the events closest to the reset matter most, one per period keeps the uploads spread */
+    reportNext = previousCount > TRACE_REPORT_EVENTS ? previousCount - TRACE_REPORT_EVENTS : 0;
+    reportTimer = xTimerCreateStatic("Trace_Report", pdMS_TO_TICKS(TRACE_REPORT_PERIOD_MS), pdTRUE, NULL, trace_report_cb,
+                                     &reportTimerBuffer);
+    xTimerStart(reportTimer, 0);
+}
+
+static void trace_report_cb(TimerHandle_t timer)
+{
+    const trace_event_t *event = &previous[reportNext++];
+
+    /* esp_insights uploads diagnostics events with the next report */
+    ESP_DIAG_EVENT(TAG, "reset %d: %lu ms %s zone %u value %u", previousReason, (unsigned long)(event->time * 1024ULL / 1000),
+                   typeNames[event->type], event->zone, event->value);
+
+    if (reportNext >= previousCount)
+        xTimerStop(timer, 0);
+}
+
+void trace_print(bool previousBoot)
+{
+    static trace_event_t events[TRACE_RING_SIZE];
+
+    if (previousBoot)
+    {
+        printf("previous boot, reset reason %d:\n", previousReason);
+        trace_print_events(previous, previousCount);
+    }
+    else
+    {
+        trace_print_events(events, trace_collect(&ring, events));
+    }
+}
+
+static int trace_collect(const trace_ring_t *source, trace_event_t *events)
+{
+    int count = 0;
+
+    /* writers race on the index, the timestamps give the real order */
+    for (int i = 0; i < TRACE_RING_SIZE; i++)
+    {
+        trace_event_t event = source->events[i];
+        if (event.type == TRACE_NONE || event.type >= TRACE_TOTAL_TYPES)
+            continue;
+
+        int j = count++;
+        while (j > 0 && events[j - 1].time > event.time)
+        {
+            events[j] = events[j - 1];
+            j--;
+        }
+        events[j] = event;
+    }
+
+    return count;
+}
+
+static void trace_print_events(const trace_event_t *events, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        printf("%10lu ms  %-16s zone %u  %u\n", (unsigned long)(events[i].time * 1024ULL / 1000), typeNames[events[i].type],
+               events[i].zone, events[i].value);
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TRACE_RING_SIZE 256    // events, power of two, 8 bytes each in RTC slow memory
+#define TRACE_MAGIC 0x43525446 // "FTRC"
+#define TRACE_REPORT_EVENTS 32     // newest events of the previous boot sent to insights, the rest is only printed
+#define TRACE_REPORT_PERIOD_MS 2000 // between two of them, so the diagnostics buffer is never flooded
+
+enum trace_type_t
+{
+    TRACE_NONE,             // never written since the ring was cleared
+    TRACE_BOOT,
+    TRACE_ACTION,           // value: action bits dispatched by the main loop
+    TRACE_SAMPLE,           // value: moisture %
+    TRACE_PUMP_ON,          // value: seconds
+    TRACE_PUMP_OFF,         // value: stop latency in us
+    TRACE_STORAGE_APPEND,   // zone: backend, value: duration in us
+    TRACE_STORAGE_READ,     // zone: backend, value: duration in us
+    TRACE_PUBLISH_MOISTURE, // value: moisture %
+    TRACE_PUBLISH_STATUS,   // value: watering
+    TRACE_PUBLISH_AUTO,     // value: auto watering
+    TRACE_PUBLISH_TIME,     // value: seconds
+    TRACE_PUBLISH_EXPORT,   // value: frame length
+    TRACE_ALERT,
+    TRACE_SHED_LEVEL, // zone: job that missed, value: new shed level
+    TRACE_SCHEDULE,   // value: rule that started a run
+    TRACE_TOTAL_TYPES,
+};
+typedef enum trace_type_t trace_type_t;
+
+struct trace_event_t
+{
+    uint32_t time; // esp_timer_get_time() >> 10, about ms since boot
+    uint8_t type;
+    uint8_t zone;
+    uint16_t value; // saturated
+};
+typedef struct trace_event_t trace_event_t;
+
+void trace_init(void);
+void trace_record(trace_type_t type, int zone, uint32_t value);
+void trace_report(void);
+void trace_print(bool previous);
@@ -0,0 +1,36 @@
+#include "esp_log.h"
+
+#include "app_zones.h"
+
+/* ESP32 pin map, zone 0 is the original single-sensor wiring */
+static const adc_channel_t boardChannels[ZONE_MAX] = {
+    ADC_CHANNEL_6, // GPIO34
+    ADC_CHANNEL_7, // GPIO35
+    ADC_CHANNEL_4, // GPIO32
+    ADC_CHANNEL_5, // GPIO33
+    ADC_CHANNEL_0, // GPIO36
+    ADC_CHANNEL_3, // GPIO39
+    ADC_CHANNEL_1, // GPIO37
+    ADC_CHANNEL_2, // GPIO38
+};
+static const int boardPumpGpios[ZONE_MAX] = {19, 21, 22, 23, 25, 26, 27, 13};
+
+static zone_table_t zones;
+const zone_table_t *const zoneTable = &zones;
+
+static const char *TAG = "ASE-PROJECT-ZONES";
+
+/*---------------------------------------------------------------
+        Zone Table Initialization
+---------------------------------------------------------------*/
+void zones_init(void)
+{
+    for (int zone = 0; zone < ZONE_COUNT; zone++)
+    {
+        zones.channel[zone] = boardChannels[zone];
+        zones.pumpGpio[zone] = boardPumpGpios[zone];
+        zones.pumpChannel[zone] = LEDC_CHANNEL_0 + zone;
+    }
+
+    ESP_LOGI(TAG, "%d zone(s), at most %d pumps at once", ZONE_COUNT, ZONE_MAX_ACTIVE_PUMPS);
+}
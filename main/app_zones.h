@@ -0,0 +1,30 @@
+#pragma once
+#include <stdint.h>
+
+#include "driver/ledc.h"
+#include "esp_adc/adc_continuous.h"
+
+#define ZONE_MAX 8 // entries in the board pin map
+#ifndef ZONE_COUNT
+#define ZONE_COUNT 1 // zones wired on this board, the first entries of the pin map
+#endif
+#define ZONE_MAX_ACTIVE_PUMPS 2 // pumps allowed to run at once on the shared supply
+
+_Static_assert(ZONE_COUNT >= 1 && ZONE_COUNT <= ZONE_MAX, "ZONE_COUNT must be between 1 and ZONE_MAX");
+
+/*
+ * Per-zone hardware, one array per field so a pass over all zones walks
+ * contiguous memory. Calibration and thresholds are per-zone arrays in
+ * config_t, they are persisted and editable at runtime.
+ */
+struct zone_table_t
+{
+    adc_channel_t channel[ZONE_COUNT];      // ADC1 channel of the moisture probe
+    int pumpGpio[ZONE_COUNT];               // pump driver input
+    ledc_channel_t pumpChannel[ZONE_COUNT]; // LEDC channel driving the pump
+};
+typedef struct zone_table_t zone_table_t;
+
+extern const zone_table_t *const zoneTable;
+
+void zones_init(void);
@@ -0,0 +1,567 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_timer.h"
+
+#include "spi_25xx_eeprom.h"
+
+#define READ 0x03
+#define WRITE 0x02
+#define WRDI 0x04
+#define WREN 0x06
+#define RDSR 0x05
+#define WRSR 0x01
+
+#define WIP_MASK 0x01
+#define WEL_MASK 0x02
+#define BP_MASK 0x0C
+
+#define VERIFY_CHUNK 32  // read-back compared in pieces of this size
+#define PROBE_ADDRESS -1 // pattern tagging every byte with its address
+
+static const spi_25xx_desc_t parts[SPI_25XX_TOTAL_PARTS] = {
+    [SPI_25LC040] = {"25LC040A", 512, 16, 1, 5, 5000000},
+    [SPI_25LC080] = {"25LC080A", 1024, 16, 2, 5, 5000000},
+    [SPI_25LC160] = {"25LC160A", 2048, 16, 2, 5, 5000000},
+    [SPI_25LC320] = {"25LC320A", 4096, 32, 2, 5, 5000000},
+    [SPI_25LC640] = {"25LC640A", 8192, 32, 2, 5, 5000000},
+    [SPI_25LC256] = {"25LC256", 32768, 64, 2, 5, 5000000},
+    [SPI_25LC512] = {"25LC512", 65536, 128, 2, 5, 10000000},
+};
+
+static const int clocks[] = SPI_25XX_CLOCKS_HZ;
+
+static esp_err_t spi_25xx_bus_init(spi_host_device_t masterHostId, const spi_25xx_desc_t *desc, int sckPin, int mosiPin, int misoPin);
+static esp_err_t spi_25xx_add_device(spi_host_device_t masterHostId, const spi_25xx_desc_t *desc, int csPin, int clkSpeedHz,
+                                     spi_25xx_t *pEeprom);
+static esp_err_t spi_25xx_stripe_probe(const spi_25xx_stripe_t *pStripe, uint32_t scratch, const uint8_t *status, uint8_t *expected);
+static esp_err_t spi_25xx_probe_status(const spi_25xx_t *pEeprom, uint8_t status);
+static int spi_25xx_header(const spi_25xx_t *pEeprom, uint8_t instruction, uint32_t address, uint8_t *pHeader);
+static esp_err_t spi_25xx_transmit(const spi_25xx_t *pEeprom, const uint8_t *pTx, size_t txSize, uint8_t *pRx, size_t rxSize);
+
+const spi_25xx_desc_t *spi_25xx_descriptor(spi_25xx_part_t part)
+{
+    return part < SPI_25XX_TOTAL_PARTS ? &parts[part] : NULL;
+}
+
+/* next slower clock of SPI_25XX_CLOCKS_HZ, 0 below the slowest one */
+int spi_25xx_clock_below(int clkSpeedHz)
+{
+    int below = 0;
+
+    for (int i = 0; i < sizeof(clocks) / sizeof(clocks[0]) && clocks[i] < clkSpeedHz; i++)
+        below = clocks[i];
+
+    return below;
+}
+
+esp_err_t spi_25xx_init(spi_host_device_t masterHostId, spi_25xx_part_t part, int csPin, int sckPin, int mosiPin, int misoPin,
+                        int clkSpeedHz, spi_25xx_t *pEeprom)
+{
+    esp_err_t ret;
+
+    if (part >= SPI_25XX_TOTAL_PARTS)
+        return ESP_ERR_INVALID_ARG;
+
+    ret = spi_25xx_bus_init(masterHostId, &parts[part], sckPin, mosiPin, misoPin);
+    if (ret != ESP_OK)
+        return ret;
+
+    ret = spi_25xx_add_device(masterHostId, &parts[part], csPin, clkSpeedHz, pEeprom);
+    if (ret != ESP_OK)
+        spi_bus_free(masterHostId);
+
+    return ret;
+}
+
+esp_err_t spi_25xx_free(spi_host_device_t masterHostId, spi_25xx_t *pEeprom)
+{
+    esp_err_t ret;
+
+    ret = spi_bus_remove_device(pEeprom->devHandle);
+
+    if (ret == ESP_OK)
+        ret = spi_bus_free(masterHostId);
+
+    if (ret == ESP_OK)
+        pEeprom->devHandle = NULL;
+
+    return ret;
+}
+
+/*---------------------------------------------------------------
+        Striping
+---------------------------------------------------------------*/
+esp_err_t spi_25xx_stripe_init(spi_host_device_t masterHostId, spi_25xx_part_t part, const int *csPins, int count, int sckPin,
+                               int mosiPin, int misoPin, int clkSpeedHz, spi_25xx_stripe_t *pStripe)
+{
+    esp_err_t ret;
+
+    if (part >= SPI_25XX_TOTAL_PARTS || count < 1 || count > SPI_25XX_MAX_STRIPE)
+        return ESP_ERR_INVALID_ARG;
+
+    ret = spi_25xx_bus_init(masterHostId, &parts[part], sckPin, mosiPin, misoPin);
+    if (ret != ESP_OK)
+        return ret;
+
+    pStripe->count = 0;
+    for (int i = 0; i < count && ret == ESP_OK; i++)
+    {
+        ret = spi_25xx_add_device(masterHostId, &parts[part], csPins[i], clkSpeedHz, &pStripe->devices[i]);
+        if (ret == ESP_OK)
+            pStripe->count++;
+    }
+
+    if (ret != ESP_OK)
+    {
+        spi_25xx_stripe_free(masterHostId, pStripe);
+        return ret;
+    }
+
+    pStripe->size = parts[part].size * count;
+    pStripe->pageSize = parts[part].pageSize;
+
+    return ESP_OK;
+}
+
+esp_err_t spi_25xx_stripe_free(spi_host_device_t masterHostId, spi_25xx_stripe_t *pStripe)
+{
+    esp_err_t ret = ESP_OK;
+
+    while (pStripe->count > 0 && ret == ESP_OK)
+    {
+        ret = spi_bus_remove_device(pStripe->devices[pStripe->count - 1].devHandle);
+        if (ret == ESP_OK)
+            pStripe->devices[--pStripe->count].devHandle = NULL;
+    }
+
+    if (ret == ESP_OK)
+        ret = spi_bus_free(masterHostId);
+
+    return ret;
+}
+
+esp_err_t spi_25xx_stripe_read(const spi_25xx_stripe_t *pStripe,
+                               uint32_t address, uint8_t *pBuffer, uint32_t size)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (address + size > pStripe->size)
+        return ESP_ERR_INVALID_ARG;
+
+    while (size > 0 && ret == ESP_OK)
+    {
+        uint32_t page = address / pStripe->pageSize;
+        uint32_t offset = address % pStripe->pageSize;
+        uint32_t chunk = pStripe->pageSize - offset;
+        if (chunk > size)
+            chunk = size;
+
+        ret = spi_25xx_read(&pStripe->devices[page % pStripe->count], (page / pStripe->count) * pStripe->pageSize + offset,
+                            pBuffer, chunk);
+
+        address += chunk;
+        pBuffer += chunk;
+        size -= chunk;
+    }
+
+    return ret;
+}
+
+esp_err_t spi_25xx_stripe_write(const spi_25xx_stripe_t *pStripe,
+                                uint32_t address, const uint8_t *pBuffer, uint32_t size)
+{
+    esp_err_t ret = ESP_OK;
+
+    if (address + size > pStripe->size)
+        return ESP_ERR_INVALID_ARG;
+
+    while (size > 0 && ret == ESP_OK)
+    {
+        uint32_t page = address / pStripe->pageSize;
+        uint32_t offset = address % pStripe->pageSize;
+        uint32_t chunk = pStripe->pageSize - offset;
+        if (chunk > size)
+            chunk = size;
+
+        /* only this chip waits for its previous cycle, the others keep programming meanwhile */
+        ret = spi_25xx_write(&pStripe->devices[page % pStripe->count], (page / pStripe->count) * pStripe->pageSize + offset,
+                             pBuffer, chunk);
+
+        address += chunk;
+        pBuffer += chunk;
+        size -= chunk;
+    }
+
+    return ret;
+}
+
+esp_err_t spi_25xx_stripe_verify(const spi_25xx_stripe_t *pStripe,
+                                 uint32_t address, const uint8_t *pExpected, uint32_t size)
+{
+    uint8_t chunk[VERIFY_CHUNK];
+    esp_err_t ret = ESP_OK;
+
+    while (size > 0 && ret == ESP_OK)
+    {
+        uint32_t length = size > sizeof(chunk) ? sizeof(chunk) : size;
+
+        ret = spi_25xx_stripe_read(pStripe, address, chunk, length);
+        if (ret == ESP_OK && memcmp(chunk, pExpected, length) != 0)
+            ret = ESP_ERR_INVALID_CRC;
+
+        address += length;
+        pExpected += length;
+        size -= length;
+    }
+
+    return ret;
+}
+
+/*---------------------------------------------------------------
+        Clock Characterization
+---------------------------------------------------------------*/
+esp_err_t spi_25xx_stripe_set_clock(spi_25xx_stripe_t *pStripe, int clkSpeedHz)
+{
+    esp_err_t ret = ESP_OK;
+
+    for (int i = 0; i < pStripe->count && ret == ESP_OK; i++)
+        ret = spi_25xx_set_clock(&pStripe->devices[i], clkSpeedHz);
+
+    return ret;
+}
+
+/*
+ * Steps the clock up through SPI_25XX_CLOCKS_HZ to the part's rating,
+ * checking the status register and pattern read-back on one scratch page
+ * per chip (scratch starts at a page boundary). The first failure ends the
+ * sweep and the clock one step below the last pass is chosen; the rating
+ * itself is only taken when every step up to it passed. The scratch pages
+ * are overwritten and the stripe is left at the chosen clock.
+ */
+esp_err_t spi_25xx_stripe_characterize(spi_25xx_stripe_t *pStripe, uint32_t scratch, int *pClkSpeedHz)
+{
+    static uint8_t expected[SPI_25XX_MAX_STRIPE * SPI_25XX_MAX_PAGE_SIZE];
+    uint8_t status[SPI_25XX_MAX_STRIPE];
+    uint32_t size = pStripe->count * pStripe->pageSize;
+    int maxClockHz = pStripe->devices[0].desc->maxClockHz;
+    int passed = -1;
+    bool failed = false;
+
+    if (scratch % pStripe->pageSize != 0 || scratch + size > pStripe->size)
+        return ESP_ERR_INVALID_ARG;
+
+    /* the slowest clock is trusted for the reference status and the current scratch contents */
+    esp_err_t ret = spi_25xx_stripe_set_clock(pStripe, clocks[0]);
+    if (ret == ESP_OK)
+        ret = spi_25xx_stripe_read(pStripe, scratch, expected, size);
+    for (int i = 0; i < pStripe->count && ret == ESP_OK; i++)
+    {
+        ret = spi_25xx_read_status(&pStripe->devices[i], &status[i]);
+        status[i] &= ~(WIP_MASK | WEL_MASK);
+    }
+    if (ret != ESP_OK)
+        return ret;
+
+    for (int i = 0; i < sizeof(clocks) / sizeof(clocks[0]) && clocks[i] <= maxClockHz && !failed; i++)
+    {
+        ret = spi_25xx_stripe_set_clock(pStripe, clocks[i]);
+        if (ret != ESP_OK)
+            return ret;
+
+        failed = spi_25xx_stripe_probe(pStripe, scratch, status, expected) != ESP_OK;
+        if (!failed)
+            passed = i;
+    }
+
+    /* the last pass below a failure has no headroom left */
+    int chosen = passed < 0 ? 0 : passed;
+    if (failed && chosen > 0)
+        chosen--;
+
+    *pClkSpeedHz = clocks[chosen];
+    ret = spi_25xx_stripe_set_clock(pStripe, clocks[chosen]);
+
+    return ret == ESP_OK && passed < 0 ? ESP_ERR_INVALID_RESPONSE : ret;
+}
+
+static esp_err_t spi_25xx_stripe_probe(const spi_25xx_stripe_t *pStripe, uint32_t scratch, const uint8_t *status, uint8_t *expected)
+{
+    /* alternating bits both ways, all low, all high, then every byte tagged with its address */
+    static const int patterns[] = {0x55, 0xAA, 0x00, 0xFF, PROBE_ADDRESS};
+    uint32_t size = pStripe->count * pStripe->pageSize;
+    esp_err_t ret = ESP_OK;
+
+    for (int round = 0; round < sizeof(patterns) / sizeof(patterns[0]) && ret == ESP_OK; round++)
+    {
+        for (int i = 0; i < pStripe->count && ret == ESP_OK; i++)
+            ret = spi_25xx_probe_status(&pStripe->devices[i], status[i]);
+
+        /* every read sends its address, so a clean read-back clears the command path before anything is programmed at this clock */
+        if (ret == ESP_OK)
+            ret = spi_25xx_stripe_verify(pStripe, scratch, expected, size);
+        if (ret != ESP_OK)
+            break;
+
+        for (uint32_t j = 0; j < size; j++)
+            expected[j] = patterns[round] == PROBE_ADDRESS ? (uint8_t)((scratch + j) ^ ((scratch + j) >> 8)) : patterns[round];
+
+        ret = spi_25xx_stripe_write(pStripe, scratch, expected, size);
+        if (ret == ESP_OK)
+            ret = spi_25xx_stripe_verify(pStripe, scratch, expected, size);
+    }
+
+    return ret;
+}
+
+/* WEL has to follow WREN and WRDI while the protection bits read back unchanged */
+static esp_err_t spi_25xx_probe_status(const spi_25xx_t *pEeprom, uint8_t status)
+{
+    uint8_t readBack;
+
+    esp_err_t ret = spi_25xx_wait_ready(pEeprom);
+    if (ret == ESP_OK)
+        ret = spi_25xx_write_enable(pEeprom);
+    if (ret == ESP_OK)
+        ret = spi_25xx_read_status(pEeprom, &readBack);
+    if (ret == ESP_OK && readBack != (status | WEL_MASK))
+        ret = ESP_ERR_INVALID_RESPONSE;
+
+    if (ret == ESP_OK)
+        ret = spi_25xx_write_disable(pEeprom);
+    if (ret == ESP_OK)
+        ret = spi_25xx_read_status(pEeprom, &readBack);
+    if (ret == ESP_OK && readBack != status)
+        ret = ESP_ERR_INVALID_RESPONSE;
+
+    return ret;
+}
+
+/*---------------------------------------------------------------
+        Single Chip Access
+---------------------------------------------------------------*/
+esp_err_t spi_25xx_set_clock(spi_25xx_t *pEeprom, int clkSpeedHz)
+{
+    if (clkSpeedHz == pEeprom->clkSpeedHz)
+        return ESP_OK;
+
+    /* the clock divider is fixed when a device is added */
+    esp_err_t ret = spi_bus_remove_device(pEeprom->devHandle);
+    if (ret != ESP_OK)
+        return ret;
+
+    pEeprom->devHandle = NULL;
+    return spi_25xx_add_device(pEeprom->host, pEeprom->desc, pEeprom->csPin, clkSpeedHz, pEeprom);
+}
+
+esp_err_t spi_25xx_read_byte(const spi_25xx_t *pEeprom,
+                             uint32_t address, uint8_t *pData)
+{
+    return spi_25xx_read(pEeprom, address, pData, 1);
+}
+
+esp_err_t spi_25xx_read(const spi_25xx_t *pEeprom,
+                        uint32_t address, uint8_t *pBuffer, uint32_t size)
+{
+    if (address + size > pEeprom->desc->size)
+        return ESP_ERR_INVALID_ARG;
+
+    esp_err_t ret = spi_25xx_wait_ready(pEeprom);
+
+    /* sequential read, the address pointer is re-sent for every page-sized chunk */
+    while (size > 0 && ret == ESP_OK)
+    {
+        uint32_t chunk = size > pEeprom->desc->pageSize ? pEeprom->desc->pageSize : size;
+
+        uint8_t txData[SPI_25XX_MAX_HEADER];
+        int header = spi_25xx_header(pEeprom, READ, address, txData);
+
+        ret = spi_25xx_transmit(pEeprom, txData, header, pBuffer, chunk);
+
+        address += chunk;
+        pBuffer += chunk;
+        size -= chunk;
+    }
+
+    return ret;
+}
+
+esp_err_t spi_25xx_write_byte(const spi_25xx_t *pEeprom,
+                              uint32_t address, uint8_t data)
+{
+    return spi_25xx_write(pEeprom, address, &data, 1);
+}
+
+esp_err_t spi_25xx_write(const spi_25xx_t *pEeprom,
+                         uint32_t address, const uint8_t *pBuffer, uint32_t size)
+{
+    const spi_25xx_desc_t *desc = pEeprom->desc;
+
+    if (address + size > desc->size)
+        return ESP_ERR_INVALID_ARG;
+
+    /* keep the bus for the whole write so page transactions go out back to back */
+    esp_err_t ret = spi_device_acquire_bus(pEeprom->devHandle, portMAX_DELAY);
+    if (ret != ESP_OK)
+        return ret;
+
+    while (size > 0 && ret == ESP_OK)
+    {
+        /* the chip wraps around inside a page, cut the write at the page boundary */
+        uint32_t chunk = desc->pageSize - (address % desc->pageSize);
+        if (chunk > size)
+            chunk = size;
+
+        /* the next page is staged while the previous one is still in its write cycle */
+        uint8_t txData[SPI_25XX_MAX_HEADER + SPI_25XX_MAX_PAGE_SIZE];
+        int header = spi_25xx_header(pEeprom, WRITE, address, txData);
+        memcpy(txData + header, pBuffer, chunk);
+
+        ret = spi_25xx_wait_ready(pEeprom);
+        if (ret == ESP_OK)
+            ret = spi_25xx_write_enable(pEeprom);
+        if (ret == ESP_OK)
+            ret = spi_25xx_transmit(pEeprom, txData, header + chunk, NULL, 0);
+
+        address += chunk;
+        pBuffer += chunk;
+        size -= chunk;
+    }
+
+    spi_device_release_bus(pEeprom->devHandle);
+
+    return ret;
+}
+
+esp_err_t spi_25xx_wait_ready(const spi_25xx_t *pEeprom)
+{
+    /* twice the datasheet write time before giving up on a stuck WIP bit */
+    int64_t deadline = esp_timer_get_time() + 2000LL * pEeprom->desc->writeTimeMs;
+    uint8_t status;
+
+    do
+    {
+        esp_err_t ret = spi_25xx_read_status(pEeprom, &status);
+        if (ret != ESP_OK)
+            return ret;
+
+        if (!(status & WIP_MASK))
+            return ESP_OK;
+    } while (esp_timer_get_time() < deadline);
+
+    return ESP_ERR_TIMEOUT;
+}
+
+esp_err_t spi_25xx_write_enable(const spi_25xx_t *pEeprom)
+{
+    uint8_t txData[1] = {WREN};
+
+    return spi_25xx_transmit(pEeprom, txData, 1, NULL, 0);
+}
+
+esp_err_t spi_25xx_write_disable(const spi_25xx_t *pEeprom)
+{
+    uint8_t txData[1] = {WRDI};
+
+    return spi_25xx_transmit(pEeprom, txData, 1, NULL, 0);
+}
+
+esp_err_t spi_25xx_read_status(const spi_25xx_t *pEeprom, uint8_t *pStatus)
+{
+    uint8_t txData[1] = {RDSR};
+
+    return spi_25xx_transmit(pEeprom, txData, 1, pStatus, 1);
+}
+
+esp_err_t spi_25xx_write_status(const spi_25xx_t *pEeprom, uint8_t status)
+{
+    uint8_t txData[2] = {WRSR, status};
+
+    return spi_25xx_transmit(pEeprom, txData, 2, NULL, 0);
+}
+
+static esp_err_t spi_25xx_bus_init(spi_host_device_t masterHostId, const spi_25xx_desc_t *desc, int sckPin, int mosiPin, int misoPin)
+{
+    /* a whole page goes out in one transaction, pages above the FIFO size need DMA; reads carry no MOSI data phase */
+    int maxTransfer = SPI_25XX_MAX_HEADER + desc->pageSize;
+
+    spi_bus_config_t spiBusConfig = {
+        .mosi_io_num = mosiPin,
+        .miso_io_num = misoPin,
+        .sclk_io_num = sckPin,
+        .max_transfer_sz = maxTransfer,
+        .flags = SPICOMMON_BUSFLAG_MASTER,
+    };
+
+    return spi_bus_initialize(masterHostId, &spiBusConfig, maxTransfer > SOC_SPI_MAXIMUM_BUFFER_SIZE ? SPI_DMA_CH_AUTO : SPI_DMA_DISABLED);
+}
+
+static esp_err_t spi_25xx_add_device(spi_host_device_t masterHostId, const spi_25xx_desc_t *desc, int csPin, int clkSpeedHz,
+                                     spi_25xx_t *pEeprom)
+{
+    spi_device_interface_config_t spiDevConfig = {
+        .command_bits = 0,
+        .address_bits = 0,
+        .dummy_bits = 0,
+        .mode = 0,
+        .clock_source = SPI_CLK_SRC_DEFAULT,
+        .clock_speed_hz = clkSpeedHz,
+        .spics_io_num = csPin,
+        .flags = SPI_DEVICE_HALFDUPLEX,
+        .queue_size = 1,
+    };
+
+    pEeprom->desc = desc;
+    pEeprom->host = masterHostId;
+    pEeprom->csPin = csPin;
+    pEeprom->clkSpeedHz = clkSpeedHz;
+
+    return spi_bus_add_device(masterHostId, &spiDevConfig, &pEeprom->devHandle);
+}
+
+static int spi_25xx_header(const spi_25xx_t *pEeprom, uint8_t instruction, uint32_t address, uint8_t *pHeader)
+{
+    int addressBytes = pEeprom->desc->addressBytes;
+
+    /* parts larger than their address field carry the top address bit in bit 3 of the instruction */
+    if (pEeprom->desc->size > (1UL << (8 * addressBytes)))
+        instruction |= (address >> (8 * addressBytes - 3)) & 0x08;
+
+    pHeader[0] = instruction;
+    for (int i = 0; i < addressBytes; i++)
+        pHeader[1 + i] = address >> (8 * (addressBytes - 1 - i));
+
+    return 1 + addressBytes;
+}
+
+static esp_err_t spi_25xx_transmit(const spi_25xx_t *pEeprom, const uint8_t *pTx, size_t txSize, uint8_t *pRx, size_t rxSize)
+{
+    spi_transaction_ext_t spiTrans;
+    memset(&spiTrans, 0, sizeof(spiTrans));
+
+    if (rxSize == 0)
+    {
+        spiTrans.base.length = txSize * 8;
+        spiTrans.base.tx_buffer = pTx;
+        return spi_device_polling_transmit(pEeprom->devHandle, &spiTrans.base);
+    }
+
+    /* half duplex under DMA rejects a MOSI and a MISO phase in one transaction,
+       the instruction and address of a read go out in the command and address phases */
+    uint64_t address = 0;
+    for (size_t i = 1; i < txSize; i++)
+        address = (address << 8) | pTx[i];
+
+    spiTrans.base.flags = SPI_TRANS_VARIABLE_CMD | SPI_TRANS_VARIABLE_ADDR;
+    spiTrans.base.cmd = pTx[0];
+    spiTrans.base.addr = address;
+    spiTrans.command_bits = 8;
+    spiTrans.address_bits = 8 * (txSize - 1);
+    spiTrans.base.rxlength = rxSize * 8;
+    spiTrans.base.rx_buffer = pRx;
+
+    return spi_device_polling_transmit(pEeprom->devHandle, &spiTrans.base);
+}
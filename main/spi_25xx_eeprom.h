@@ -0,0 +1,109 @@
+#pragma once
+#include "driver/spi_master.h"
+
+#define SPI_25XX_MAX_HEADER 3      // instruction plus up to two address bytes
+#define SPI_25XX_MAX_PAGE_SIZE 128 // largest page in the descriptor table
+#define SPI_25XX_MAX_STRIPE 4      // chips one stripe can span
+
+/* clocks the bring-up steps through, all exact dividers of the 80 MHz APB clock, slowest first */
+#define SPI_25XX_CLOCKS_HZ {1000000, 2000000, 4000000, 5000000, 8000000, 10000000, 16000000, 20000000}
+
+enum spi_25xx_part_t
+{
+    SPI_25LC040,
+    SPI_25LC080,
+    SPI_25LC160,
+    SPI_25LC320,
+    SPI_25LC640,
+    SPI_25LC256,
+    SPI_25LC512,
+    SPI_25XX_TOTAL_PARTS,
+};
+typedef enum spi_25xx_part_t spi_25xx_part_t;
+
+/* geometry from the Microchip datasheets, the A variants where the page size differs */
+struct spi_25xx_desc_t
+{
+    const char *name;
+    uint32_t size;        // bytes
+    uint16_t pageSize;    // bytes one WRITE can program, writes wrap inside a page
+    uint8_t addressBytes; // address bytes after the instruction, A8 goes in the instruction on the 040
+    uint8_t writeTimeMs;  // max write cycle time (Twc)
+    int maxClockHz;       // rated SCK between 2.5 V and 4.5 V
+};
+typedef struct spi_25xx_desc_t spi_25xx_desc_t;
+
+struct spi_25xx_t
+{
+    spi_device_handle_t devHandle;
+    const spi_25xx_desc_t *desc;
+    spi_host_device_t host; // kept to re-add the device at another clock
+    int csPin;
+    int clkSpeedHz;
+};
+typedef struct spi_25xx_t spi_25xx_t;
+
+/*
+ * Identical parts on one bus, one chip-select each. Consecutive pages go to
+ * consecutive chips so a page write is sent while the previous chip is
+ * still in its write cycle.
+ */
+struct spi_25xx_stripe_t
+{
+    spi_25xx_t devices[SPI_25XX_MAX_STRIPE];
+    int count;
+    uint32_t size;     // bytes across all chips
+    uint16_t pageSize; // stripe unit
+};
+typedef struct spi_25xx_stripe_t spi_25xx_stripe_t;
+
+const spi_25xx_desc_t *spi_25xx_descriptor(spi_25xx_part_t part);
+
+int spi_25xx_clock_below(int clkSpeedHz);
+
+esp_err_t spi_25xx_init(spi_host_device_t masterHostId, spi_25xx_part_t part, int csPin, int sckPin, int mosiPin, int misoPin,
+                        int clkSpeedHz, spi_25xx_t *pEeprom);
+
+esp_err_t spi_25xx_free(spi_host_device_t masterHostId, spi_25xx_t *pEeprom);
+
+esp_err_t spi_25xx_stripe_init(spi_host_device_t masterHostId, spi_25xx_part_t part, const int *csPins, int count, int sckPin,
+                               int mosiPin, int misoPin, int clkSpeedHz, spi_25xx_stripe_t *pStripe);
+
+esp_err_t spi_25xx_stripe_free(spi_host_device_t masterHostId, spi_25xx_stripe_t *pStripe);
+
+esp_err_t spi_25xx_stripe_set_clock(spi_25xx_stripe_t *pStripe, int clkSpeedHz);
+
+esp_err_t spi_25xx_stripe_characterize(spi_25xx_stripe_t *pStripe, uint32_t scratch, int *pClkSpeedHz);
+
+esp_err_t spi_25xx_stripe_read(const spi_25xx_stripe_t *pStripe,
+                               uint32_t address, uint8_t *pBuffer, uint32_t size);
+
+esp_err_t spi_25xx_stripe_write(const spi_25xx_stripe_t *pStripe,
+                                uint32_t address, const uint8_t *pBuffer, uint32_t size);
+
+esp_err_t spi_25xx_stripe_verify(const spi_25xx_stripe_t *pStripe,
+                                 uint32_t address, const uint8_t *pExpected, uint32_t size);
+
+esp_err_t spi_25xx_set_clock(spi_25xx_t *pEeprom, int clkSpeedHz);
+
+esp_err_t spi_25xx_read_byte(const spi_25xx_t *pEeprom,
+                             uint32_t address, uint8_t *pData);
+
+esp_err_t spi_25xx_read(const spi_25xx_t *pEeprom,
+                        uint32_t address, uint8_t *pBuffer, uint32_t size);
+
+esp_err_t spi_25xx_write_byte(const spi_25xx_t *pEeprom,
+                              uint32_t address, uint8_t data);
+
+esp_err_t spi_25xx_write(const spi_25xx_t *pEeprom,
+                         uint32_t address, const uint8_t *pBuffer, uint32_t size);
+
+esp_err_t spi_25xx_wait_ready(const spi_25xx_t *pEeprom);
+
+esp_err_t spi_25xx_write_enable(const spi_25xx_t *pEeprom);
+
+esp_err_t spi_25xx_write_disable(const spi_25xx_t *pEeprom);
+
+esp_err_t spi_25xx_read_status(const spi_25xx_t *pEeprom, uint8_t *pStatus);
+
+esp_err_t spi_25xx_write_status(const spi_25xx_t *pEeprom, uint8_t status);
@@ -0,0 +1,254 @@
+#!/usr/bin/env python3
+"""Model the two critical-dry alarm paths on the host (see main/app_adc.h).
+
+One zone dries from --start to --end percent over --dry-hours, is watered back
+and dries again for --days. The periodic path only looks at the filtered
+reading taken every sampling period. The monitor path also compares every
+idle conversion with the threshold sensor_task arms, takes a full reading on
+the first crossing and holds an unconfirmed zone off as adc_alarm_arm does,
+until the first periodic sample after the holdoff re-arms it.
+
+    python3 tools/alarm_model.py --noise 30 --spikes 0.002
+    python3 tools/alarm_model.py --period 1800 --dry-hours 2 --start 30 --end 0    # a sleep-heavy node
+
+The margin, holdoff, filter and alert defaults are read from the firmware
+headers. Exits non-zero when the monitor path raises or clears an alert later
+than the periodic one, or reads more often than the holdoff allows.
+"""
+import argparse
+import math
+import os
+import random
+import re
+import statistics
+import sys
+
+MAIN = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "main")
+DEFINE = re.compile(r"#define (\w+) (?:/\*.*?\*/ )?\(?([0-9]+)(?: \* ([0-9]+))?\)?")
+DEFAULT = re.compile(r'\[CFG_(\w+)\] = \{"\w+", \d+, \d+, (\d+),')
+
+
+def load_defines(*names):
+    values = {}
+    for name in names:
+        with open(os.path.join(MAIN, name)) as f:
+            for symbol, a, b in DEFINE.findall(f.read()):
+                values[symbol] = int(a) * (int(b) if b else 1)
+    with open(os.path.join(MAIN, "app_config.c")) as f:
+        for key, value in DEFAULT.findall(f.read()):
+            values["CFG_" + key] = int(value)
+    return values
+
+
+class Zone:
+    """Probe, estimator and alert state of one zone, as the firmware keeps them."""
+
+    def __init__(self, args, fw):
+        self.args = args
+        self.fw = fw
+        self.state = 0.0
+        self.var = float(fw["SENSOR_ADC_MAX_RAW"] ** 2)
+        self.filterS = None
+        self.warned = False
+
+    def raw(self, percent):
+        return self.args.dry + (self.args.wet - self.args.dry) * percent / 100.0
+
+    def conversion(self, rng, percent):
+        if rng.random() < self.args.spikes:
+            return self.raw(percent) + rng.choice((-1, 1)) * self.args.spike_raw
+        return rng.gauss(self.raw(percent), self.args.noise)
+
+    def percentage(self, raw):
+        # adc_raw_to_percentage, C division truncates
+        percent = int((int(raw) - self.args.dry) * 100 / (self.args.wet - self.args.dry))
+        return min(max(percent, 0), 100)
+
+    def reading(self, rng, t, percent):
+        """adc_estimate: median groups into the Kalman filter until it converges."""
+        fw = self.fw
+        if self.filterS is not None:
+            self.var = min(self.var + fw["FILTER_PROCESS_VAR_PER_S"] * (t - self.filterS), fw["SENSOR_ADC_MAX_RAW"] ** 2)
+        for group in range(fw["FILTER_MAX_GROUPS"]):
+            median = statistics.median(self.conversion(rng, percent) for _ in range(fw["FILTER_MEDIAN_N"]))
+            innovation = median - self.state
+            innovationVar = self.var + fw["FILTER_MEAS_VAR"]
+            if innovation * innovation > fw["FILTER_GATE_SIGMAS"] ** 2 * innovationVar:
+                self.var = float(fw["SENSOR_ADC_MAX_RAW"] ** 2)
+                innovationVar = self.var + fw["FILTER_MEAS_VAR"]
+            gain = self.var / innovationVar
+            self.state += innovation * gain
+            self.var *= 1 - gain
+            if group + 1 >= fw["FILTER_MIN_GROUPS"] and self.var <= fw["FILTER_TARGET_VAR"]:
+                break
+        self.filterS = t
+        return self.percentage(round(self.state))
+
+    def check(self, percent):
+        """sensor_task: raise below alert_low, clear above alert_clear. Returns the change, if any."""
+        if percent < self.args.alert_low and not self.warned:
+            self.warned = True
+            return "raise"
+        if percent > self.args.alert_clear and self.warned:
+            self.warned = False
+            return "clear"
+        return None
+
+    def threshold(self):
+        """adc_alarm_arm: (raw, rising) for the side the alert state waits for."""
+        level = self.args.alert_clear if self.warned else self.args.alert_low
+        threshold = self.args.dry + (self.args.wet - self.args.dry) * level // 100
+        rising = (self.args.dry > self.args.wet) != self.warned
+        margin = self.fw["SENSOR_MONITOR_MARGIN"]
+        return (min(threshold + margin, self.fw["SENSOR_ADC_MAX_RAW"]) if rising else max(threshold - margin, 0)), rising
+
+
+def crossing_chance(args, zone, percent, threshold, rising):
+    """Chance that one second of idle conversions crosses the threshold at least once."""
+    mean = zone.raw(percent)
+    z = (threshold - mean) / args.noise if rising else (mean - threshold) / args.noise
+    inside = 0.5 * (1 + math.erf(z / math.sqrt(2)))
+    spike = args.spike_raw >= (threshold - mean if rising else mean - threshold)
+    inside *= 1 - (args.spikes / 2 if spike else 0)
+    return 1 - inside ** args.monitor_hz
+
+
+def moisture(args, t):
+    cycle = args.dry_hours * 3600
+    return args.start + (args.end - args.start) * (t % cycle) / cycle
+
+
+def true_events(args, duration):
+    """When the soil itself crossed the alert levels, at one second resolution."""
+    events, warned = [], False
+    for t in range(duration):
+        percent = int(moisture(args, t))
+        if percent < args.alert_low and not warned:
+            events.append(("raise", t))
+            warned = True
+        elif percent > args.alert_clear and warned:
+            events.append(("clear", t))
+            warned = False
+    return events
+
+
+def run(args, fw, monitored):
+    # the periodic samples draw the same noise on both paths, only the monitor's own draws differ
+    sampleRng = random.Random(args.seed)
+    alarmRng = random.Random(args.seed + 1)
+    zone = Zone(args, fw)
+    period = args.period
+    holdoff = fw["SENSOR_MONITOR_HOLDOFF_MS"] // 1000
+    duration = int(args.days * 86400)
+    events, readings, alarms, unconfirmed = [], 0, 0, 0
+    armed, firedWarned, holdUntil = False, None, 0
+
+    for t in range(duration):
+        percent = moisture(args, t)
+        reason = None
+
+        if t % period == 0:
+            reason = "sample"
+        elif armed:
+            threshold, rising = zone.threshold()
+            if alarmRng.random() < crossing_chance(args, zone, percent, threshold, rising):
+                armed = False
+                alarms += 1
+                firedWarned = zone.warned
+                reason = "alarm"
+
+        if reason is None:
+            continue
+
+        readings += 1
+        change = zone.check(zone.reading(sampleRng if reason == "sample" else alarmRng, t, percent))
+        if change:
+            events.append((change, t))
+
+        if monitored:
+            # re-armed after every pass, an alarm that left the state alone holds the zone off
+            if firedWarned is not None and zone.warned == firedWarned:
+                unconfirmed += 1
+                holdUntil = t + holdoff
+            firedWarned = None
+            armed = t >= holdUntil
+
+    return events, readings, alarms, unconfirmed
+
+
+def delays(truth, events):
+    """Seconds from every true crossing to its alert change, None when it was missed.
+
+    A change belongs to the crossing whose neighbours it falls between, it is
+    negative when the reading noise got there first.
+    """
+    result = {"raise": [], "clear": []}
+    for i, (kind, t) in enumerate(truth):
+        lo = truth[i - 1][1] if i > 0 else -math.inf
+        hi = truth[i + 1][1] if i + 1 < len(truth) else math.inf
+        seen = [e for k, e in events if k == kind and lo < e < hi]
+        result[kind].append(seen[0] - t if seen else None)
+    return result
+
+
+def main():
+    fw = load_defines("app_adc.h", "app_gptimer.h")
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--days", type=float, default=7)
+    parser.add_argument("--start", type=float, default=40, help="percent right after watering")
+    parser.add_argument("--end", type=float, default=4, help="percent before the next watering")
+    parser.add_argument("--dry-hours", type=float, default=36)
+    parser.add_argument("--dry", type=int, default=3000, help="raw in dry soil")
+    parser.add_argument("--wet", type=int, default=1200, help="raw in water")
+    parser.add_argument("--noise", type=float, default=30, help="raw sigma of one conversion")
+    parser.add_argument("--spikes", type=float, default=0.0, help="share of conversions hit by pump noise")
+    parser.add_argument("--spike-raw", type=float, default=400)
+    parser.add_argument("--monitor-hz", type=float, default=100, help="idle conversions per second of one zone")
+    parser.add_argument("--alert-low", type=int, default=fw["CFG_ALERT_LOW"])
+    parser.add_argument("--alert-clear", type=int, default=fw["CFG_ALERT_CLEAR"])
+    parser.add_argument("--period", type=int, default=fw["GPTIMER_PERIOD_S"], help="sampling period, s")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    duration = int(args.days * 86400)
+    truth = true_events(args, duration)
+    results = {}
+
+    print("%d s sampling period, %d raw margin, %d s holdoff, %d alert crossings" % (
+        args.period, fw["SENSOR_MONITOR_MARGIN"], fw["SENSOR_MONITOR_HOLDOFF_MS"] // 1000, len(truth)))
+    print("%-9s %9s %9s %12s %7s %10s %10s %7s %10s %10s" % (
+        "path", "readings", "alarms", "unconfirmed", "raised", "raise avg", "raise max", "cleared", "clear avg", "clear max"))
+
+    for name, monitored in (("periodic", False), ("monitor", True)):
+        events, readings, alarms, unconfirmed = run(args, fw, monitored)
+        late = delays(truth, events)
+        results[name] = (late, readings, unconfirmed)
+        cells = []
+        for kind in ("raise", "clear"):
+            values = [v for v in late[kind] if v is not None]
+            cells.append("%3d/%-3d" % (len(values), len(late[kind])))
+            cells += ["%9.1fs" % statistics.mean(values), "%9ds" % max(values)] if values else ["%10s" % "-"] * 2
+        print("%-9s %9d %9d %12d %s" % (name, readings, alarms, unconfirmed, " ".join(cells)))
+
+    # the paths draw different noise, a reading either takes can land one period apart
+    failures = []
+    period = args.period
+    periodic, monitor = results["periodic"][0], results["monitor"][0]
+    for kind in ("raise", "clear"):
+        for p, m in zip(periodic[kind], monitor[kind]):
+            if p is not None and (m is None or m > p + period):
+                failures.append("monitor path changed a %s later than the periodic sample" % kind)
+                break
+
+    # every unconfirmed alarm is followed by a holdoff, confirmed ones change the state at most once per crossing
+    bound = duration // (fw["SENSOR_MONITOR_HOLDOFF_MS"] // 1000) + 1
+    if results["monitor"][2] > bound:
+        failures.append("%d unconfirmed alarms, the holdoff allows %d" % (results["monitor"][2], bound))
+
+    for failure in failures:
+        print("FAIL: " + failure)
+    return 1 if failures else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,99 @@
+#!/usr/bin/env python3
+"""Decode a binary history frame exported by the node (see main/app_export.h).
+
+Accepts either a console capture containing EXPORT: lines, or the base64
+string read from the "export" parameter of the History device.
+
+    idf.py monitor | tee capture.txt      # then type 'e'
+    python3 tools/decode_history.py capture.txt
+    python3 tools/decode_history.py --b64 "QVNFSAEAFAA..."
+"""
+import argparse
+import base64
+import struct
+import sys
+from datetime import datetime
+
+MAGIC = 0x48455341
+VERSIONS = (1, 2, 3)
+HEADER = struct.Struct("<IBBHQH")
+
+
+def crc16(data, crc=0xFFFF):
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else crc << 1
+            crc &= 0xFFFF
+    return crc
+
+
+def frame_from_console(lines):
+    b64 = ""
+    for line in lines:
+        line = line.strip()
+        start = line.find("EXPORT:")
+        if line.endswith("EXPORT-BEGIN"):
+            b64 = ""
+        elif start >= 0:
+            b64 += line[start + len("EXPORT:"):]
+    return base64.b64decode(b64)
+
+
+def decode(frame):
+    if len(frame) < HEADER.size + 2:
+        raise ValueError("frame too short (%d bytes)" % len(frame))
+
+    magic, version, zones, interval, base, count = HEADER.unpack_from(frame)
+    if magic != MAGIC:
+        raise ValueError("bad magic 0x%08x" % magic)
+    if version not in VERSIONS:
+        raise ValueError("unsupported version %d" % version)
+    if version == 1:
+        zones = 1
+
+    samples_end = HEADER.size + zones * count
+    # version 3 dates every record with its delta, older frames are evenly spaced
+    end = samples_end + (2 * count if version >= 3 else 0)
+    if len(frame) < end + 2:
+        raise ValueError("truncated frame, expected %d records" % count)
+
+    (crc,) = struct.unpack_from("<H", frame, end)
+    if crc != crc16(frame[:end]):
+        raise ValueError("crc mismatch")
+
+    if version >= 3:
+        times, t = [], base
+        for (delta,) in struct.iter_unpack("<H", frame[samples_end:end]):
+            t += delta
+            times.append(t)
+    else:
+        times = [base + i * interval for i in range(count)]
+
+    samples = frame[HEADER.size:samples_end]
+    # 0xFE and 0xFF mark slots the node has no sample for
+    return [(times[i], zone, samples[zone * count + i])
+            for i in range(count) for zone in range(zones) if samples[zone * count + i] <= 100]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", nargs="?", help="console capture file (default: stdin)")
+    parser.add_argument("--b64", help="base64 frame from the History device")
+    args = parser.parse_args()
+
+    if args.b64:
+        frame = base64.b64decode(args.b64)
+    elif args.capture:
+        with open(args.capture, errors="replace") as f:
+            frame = frame_from_console(f)
+    else:
+        frame = frame_from_console(sys.stdin)
+
+    print("timestamp,date,zone,moisture")
+    for timestamp, zone, moisture in decode(frame):
+        print("%d,%s,%d,%d" % (timestamp, datetime.fromtimestamp(timestamp).isoformat(), zone, moisture))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,75 @@
+#!/usr/bin/env python3
+"""Render the raw tokenized log printed after 'log raw' (see main/app_tlog.h).
+
+Formats come from the TLOG_FORMATS table in main/app_tlog.h, so use the
+header of the firmware that produced the capture. Other lines pass through.
+
+    idf.py monitor | tee capture.txt      # then type 'log raw'
+    python3 tools/decode_log.py capture.txt
+"""
+import argparse
+import os
+import re
+import sys
+
+HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "main", "app_tlog.h")
+ENTRY = re.compile(r'X\((\w+),\s*ESP_LOG_(\w+),\s*"((?:[^"\\]|\\.)*)"\)')
+RECORD = re.compile(r"#TL (\d+) (\d+) (\d+)((?: [0-9a-f]+)*)")
+CONVERSION = re.compile(r"%([-+ #0]*\d*)(?:l|h|hh)?([diuxXc%])")
+
+
+def load_formats(path):
+    with open(path) as f:
+        text = f.read()
+    # table order is the token value
+    return [(level, fmt.encode().decode("unicode_escape")) for _, level, fmt in ENTRY.findall(text)]
+
+
+def signed(value):
+    return value - (1 << 32) if value & 0x80000000 else value
+
+
+def render(fmt, args):
+    args = iter(args)
+
+    def convert(match):
+        flags, kind = match.groups()
+        if kind == "%":
+            return "%"
+        value = next(args, 0)
+        if kind in "di":
+            value = signed(value)
+        elif kind == "c":
+            return chr(value & 0xFF)
+        return ("%" + flags + ("d" if kind == "u" else kind)) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("capture", nargs="?", help="console capture, stdin if omitted")
+    parser.add_argument("--formats", default=HEADER, help="app_tlog.h holding the format table")
+    options = parser.parse_args()
+
+    formats = load_formats(options.formats)
+    source = open(options.capture, errors="replace") if options.capture else sys.stdin
+
+    for line in source:
+        match = RECORD.search(line)
+        if not match:
+            sys.stdout.write(line)
+            continue
+
+        token, timestamp, argc = int(match.group(1)), int(match.group(2)), int(match.group(3))
+        args = [int(a, 16) for a in match.group(4).split()][:argc]
+        if token >= len(formats):
+            print("? (%d) unknown token %d %s" % (timestamp, token, args))
+            continue
+
+        level, fmt = formats[token]
+        print("%s (%d) %s" % (level[0], timestamp, render(fmt, args)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,193 @@
+#!/usr/bin/env python3
+"""Build and check delta OTA patches (see main/app_delta.h).
+
+The base must be the exact image the device runs, usually the
+build/<project>.bin kept from the release it was flashed with.
+
+    python3 tools/delta_ota.py diff old.bin build/project.bin update.patch
+    python3 tools/delta_ota.py apply old.bin update.patch rebuilt.bin
+    python3 tools/delta_ota.py info update.patch
+
+The patch is pushed like a full image through RainMaker OTA, or served
+locally and fetched from the console:
+
+    python3 -m http.server 8070      # in the patch directory
+    ota http://<host>:8070/update.patch
+"""
+import argparse
+import hashlib
+import struct
+import sys
+
+MAGIC = 0x50445341
+VERSION = 1
+HEADER = struct.Struct("<IB3xII32s32s")
+
+OP_END = 0x00
+OP_COPY = 0x01
+OP_INSERT = 0x02
+
+BLOCK = 32  # match key length
+STEP = 8  # base offsets indexed, every match of BLOCK + STEP bytes is found
+MIN_COPY = 16  # a copy costs 9 bytes, shorter matches stay literal
+
+
+def match_length(base, b, target, t):
+    """Length of the common run of base[b:] and target[t:]."""
+    n = 0
+    limit = min(len(base) - b, len(target) - t)
+    while n < limit:
+        m = min(256, limit - n)
+        if base[b + n : b + n + m] == target[t + n : t + n + m]:
+            n += m
+            continue
+        while base[b + n] == target[t + n]:
+            n += 1
+        break
+    return n
+
+
+def diff(base, target):
+    index = {}
+    for offset in range(0, len(base) - BLOCK + 1, STEP):
+        index.setdefault(base[offset : offset + BLOCK], offset)
+
+    ops = []
+    literal = 0  # start of the pending literal run
+    t = 0
+    while t <= len(target) - BLOCK:
+        b = index.get(target[t : t + BLOCK])
+        if b is None:
+            t += 1
+            continue
+
+        back = 0
+        while t - back > literal and b - back > 0 and target[t - back - 1] == base[b - back - 1]:
+            back += 1
+        length = back + BLOCK + match_length(base, b + BLOCK, target, t + BLOCK)
+        if length < MIN_COPY:
+            t += 1
+            continue
+
+        if t - back > literal:
+            ops.append((OP_INSERT, target[literal : t - back]))
+        ops.append((OP_COPY, b - back, length))
+        t = t - back + length
+        literal = t
+
+    if literal < len(target):
+        ops.append((OP_INSERT, target[literal:]))
+    return ops
+
+
+def encode(base, target, ops):
+    out = bytearray(
+        HEADER.pack(MAGIC, VERSION, len(base), len(target), hashlib.sha256(base).digest(), hashlib.sha256(target).digest())
+    )
+    for op in ops:
+        if op[0] == OP_COPY:
+            out += struct.pack("<BII", OP_COPY, op[1], op[2])
+        else:
+            out += struct.pack("<BI", OP_INSERT, len(op[1])) + op[1]
+    out.append(OP_END)
+    return bytes(out)
+
+
+def decode(patch):
+    """Yields the header, then the ops, checking the layout like the device does."""
+    magic, version, base_size, target_size, base_sha, target_sha = HEADER.unpack_from(patch)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("not a version %d patch" % VERSION)
+    yield base_size, target_size, base_sha, target_sha
+
+    pos = HEADER.size
+    while True:
+        op = patch[pos]
+        pos += 1
+        if op == OP_END:
+            break
+        if op == OP_COPY:
+            offset, length = struct.unpack_from("<II", patch, pos)
+            pos += 8
+            yield OP_COPY, offset, length
+        elif op == OP_INSERT:
+            (length,) = struct.unpack_from("<I", patch, pos)
+            pos += 4
+            yield OP_INSERT, patch[pos : pos + length]
+            pos += length
+        else:
+            raise ValueError("bad opcode 0x%02x at %d" % (op, pos - 1))
+    if pos != len(patch):
+        raise ValueError("data after the end of the patch")
+
+
+def apply(base, patch):
+    ops = decode(patch)
+    base_size, target_size, base_sha, target_sha = next(ops)
+    if hashlib.sha256(base[:base_size]).digest() != base_sha:
+        raise ValueError("patch base does not match this image, a full image is needed")
+
+    out = bytearray()
+    for op in ops:
+        if op[0] == OP_COPY:
+            if op[1] + op[2] > base_size:
+                raise ValueError("copy outside the base image")
+            out += base[op[1] : op[1] + op[2]]
+        else:
+            out += op[1]
+    if len(out) != target_size or hashlib.sha256(out).digest() != target_sha:
+        raise ValueError("rebuilt image does not match the target hash")
+    return bytes(out)
+
+
+def read(path):
+    with open(path, "rb") as f:
+        return f.read()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    commands = parser.add_subparsers(dest="command", required=True)
+    command = commands.add_parser("diff", help="make a patch from base to target")
+    command.add_argument("base")
+    command.add_argument("target")
+    command.add_argument("patch")
+    command = commands.add_parser("apply", help="rebuild the target like the device would")
+    command.add_argument("base")
+    command.add_argument("patch")
+    command.add_argument("output")
+    command = commands.add_parser("info", help="print the patch header and op counts")
+    command.add_argument("patch")
+    options = parser.parse_args()
+
+    try:
+        if options.command == "diff":
+            base, target = read(options.base), read(options.target)
+            patch = encode(base, target, diff(base, target))
+            apply(base, patch)  # never ship a patch that does not rebuild the target
+            with open(options.patch, "wb") as f:
+                f.write(patch)
+            print("%d byte patch for a %d byte image (%.1f%%)" % (len(patch), len(target), 100.0 * len(patch) / len(target)))
+        elif options.command == "apply":
+            target = apply(read(options.base), read(options.patch))
+            with open(options.output, "wb") as f:
+                f.write(target)
+            print("rebuilt %d bytes, hash verified" % len(target))
+        else:
+            ops = decode(read(options.patch))
+            base_size, target_size, base_sha, target_sha = next(ops)
+            copies = inserts = copied = inserted = 0
+            for op in ops:
+                if op[0] == OP_COPY:
+                    copies, copied = copies + 1, copied + op[2]
+                else:
+                    inserts, inserted = inserts + 1, inserted + len(op[1])
+            print("base   %d bytes sha256 %s" % (base_size, base_sha.hex()))
+            print("target %d bytes sha256 %s" % (target_size, target_sha.hex()))
+            print("%d copies (%d bytes), %d inserts (%d bytes)" % (copies, copied, inserts, inserted))
+    except ValueError as e:
+        sys.exit("error: %s" % e)
+
+
+if __name__ == "__main__":
+    main()
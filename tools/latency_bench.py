@@ -0,0 +1,171 @@
+#!/usr/bin/env python3
+"""Measure command latency through a local MQTT broker (see main/app_latency.h).
+
+The node takes RainMaker writes from the broker on its own topics instead of
+the cloud, and sends back the time of every stage each command went through.
+Start a broker on the host, then the bench session on the node's console:
+
+    mosquitto -p 1883 -v
+    latency serve mqtt://<host ip>:1883 1200      # on the node, prints its node id
+    python3 tools/latency_bench.py <host ip> --node <node id> --slo pump=250 read=1500
+
+Every command runs idle and then under background load (moisture reports
+flooding the RainMaker path). Pump commands set the zone's watering time to
+--pump-seconds first, which the node persists. Needs paho-mqtt.
+"""
+import argparse
+import json
+import math
+import queue
+import sys
+import time
+
+import paho.mqtt.client as mqtt
+
+STAGES = ["receive", "callback", "dispatch", "task", "actuate", "publish"]
+LAST_STAGE = {"pump": "actuate", "read": "publish"}
+COMMANDS = {
+    # device, parameter, value
+    "pump": ("Manual Watering", "trigger pump", True),
+    "read": ("Current Moisture", "trigger reading", True),
+}
+
+
+def device_name(name, zone, zones):
+    # single-zone boards keep the original names, see rmaker_zone_name()
+    return name if zones == 1 else "%s %d" % (name, zone + 1)
+
+
+def percentile(values, p):
+    # nearest rank
+    values = sorted(values)
+    return values[max(0, math.ceil(p / 100.0 * len(values)) - 1)]
+
+
+class Bench:
+    def __init__(self, args):
+        self.args = args
+        self.records = queue.Queue()
+        self.remote = "node/%s/params/remote" % args.node
+        self.load = "node/%s/bench/load" % args.node
+
+        try:
+            self.client = mqtt.Client(mqtt.CallbackAPIVersion.VERSION2)
+        except AttributeError:
+            self.client = mqtt.Client()
+        self.client.on_message = lambda client, userdata, msg: self.records.put((time.monotonic(), msg.payload))
+        self.client.connect(args.broker, args.port)
+        self.client.subscribe("node/%s/bench/latency" % args.node, qos=1)
+        self.client.loop_start()
+
+    def write(self, device, param, value):
+        payload = {device_name(device, self.args.zone, self.args.zones): {param: value}}
+        return self.client.publish(self.remote, json.dumps(payload), qos=1)
+
+    def set_load(self, reports_per_s):
+        self.client.publish(self.load, str(reports_per_s), qos=1).wait_for_publish()
+
+    def run(self, cmd):
+        """One command, returns the device stage offsets and the host round trip in ms, or None."""
+        while not self.records.empty():
+            self.records.get_nowait()
+
+        device, param, value = COMMANDS[cmd]
+        sent = time.monotonic()
+        self.write(device, param, value)
+
+        deadline = sent + self.args.timeout
+        while time.monotonic() < deadline:
+            try:
+                arrived, payload = self.records.get(timeout=deadline - time.monotonic())
+            except queue.Empty:
+                break
+            record = json.loads(payload)
+            if record.get("cmd") != cmd:
+                continue
+            stages = {name: us / 1000.0 for name, us in zip(STAGES, record["us"]) if us >= 0}
+            return stages, (arrived - sent) * 1000.0
+        return None
+
+    def close(self):
+        self.client.loop_stop()
+        self.client.disconnect()
+
+
+def report(mode, cmd, results, lost):
+    print("%s %s: %d completed, %d lost" % (mode, cmd, len(results), lost))
+    if not results:
+        return
+    print("  %-10s %5s %9s %9s %9s %9s" % ("stage", "n", "p50 ms", "p95 ms", "p99 ms", "max ms"))
+    for name in STAGES[1:] + ["host"]:
+        values = [host if name == "host" else stages[name] for stages, host in results if name == "host" or name in stages]
+        if not values:
+            continue
+        print("  %-10s %5d %9.2f %9.2f %9.2f %9.2f" % (name, len(values), percentile(values, 50),
+                                                      percentile(values, 95), percentile(values, 99), max(values)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("broker", help="broker host the node was pointed at")
+    parser.add_argument("--port", type=int, default=1883)
+    parser.add_argument("--node", required=True, help="RainMaker node id")
+    parser.add_argument("--zone", type=int, default=0)
+    parser.add_argument("--zones", type=int, default=1, help="ZONE_COUNT of the firmware, for the device names")
+    parser.add_argument("--commands", default="pump,read")
+    parser.add_argument("--count", type=int, default=30, help="commands per mode")
+    parser.add_argument("--interval", type=float, default=1.0, help="pause after a reading, pumps add their run time")
+    parser.add_argument("--pump-seconds", type=int, default=1)
+    parser.add_argument("--load", type=int, default=50, help="background reports per second in the loaded run, 0 skips it")
+    parser.add_argument("--timeout", type=float, default=10.0)
+    parser.add_argument("--slo", nargs="*", default=[], metavar="CMD=MS",
+                        help="fail when the p95 up to the command's last stage exceeds MS")
+    args = parser.parse_args()
+
+    try:
+        slo = {cmd: float(ms) for cmd, ms in (item.split("=") for item in args.slo)}
+    except ValueError:
+        sys.exit("error: --slo takes CMD=MS pairs")
+    commands = args.commands.split(",")
+    for cmd in commands + list(slo):
+        if cmd not in COMMANDS:
+            sys.exit("error: unknown command '%s'" % cmd)
+
+    bench = Bench(args)
+    failed = []
+    try:
+        if "pump" in commands:
+            bench.write("Manual Watering", "time irrigating (seconds)", args.pump_seconds).wait_for_publish()
+            time.sleep(1)
+
+        modes = [("idle", 0)] + ([("loaded", args.load)] if args.load > 0 else [])
+        for mode, load in modes:
+            bench.set_load(load)
+            for cmd in commands:
+                results, lost = [], 0
+                for _ in range(args.count):
+                    result = bench.run(cmd)
+                    if result is None:
+                        lost += 1
+                    else:
+                        results.append(result)
+                    time.sleep(args.interval + (args.pump_seconds if cmd == "pump" else 0))
+
+                report(mode, cmd, results, lost)
+
+                if cmd in slo:
+                    last = [stages[LAST_STAGE[cmd]] for stages, _ in results if LAST_STAGE[cmd] in stages]
+                    p95 = percentile(last, 95) if last else float("inf")
+                    if lost or p95 > slo[cmd]:
+                        failed.append("%s %s: p95 %.2f ms, %d lost, SLO %.0f ms" % (mode, cmd, p95, lost, slo[cmd]))
+    finally:
+        bench.set_load(0)
+        bench.close()
+
+    for line in failed:
+        print("SLO violated, " + line)
+    sys.exit(1 if failed else 0)
+
+
+if __name__ == "__main__":
+    main()